@@ -218,6 +218,19 @@ void Application::mp2Run() {
 		}
 	}
 
+	/**
+	 * Background maintenance of the DHT, bounded per time unit
+	 */
+	for ( i = 0; i <= par->EN_GPSZ-1; i++ ) {
+		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
+			mp2[i]->runExpiry();
+			mp2[i]->runCompaction();
+			mp2[i]->syncLog();
+			mp2[i]->runSnapshot();
+			mp2[i]->logStats();
+		}
+	}
+
 	/**
 	 * Insert a set of test key value pairs into the system
 	 */
@@ -324,6 +337,13 @@ void Application::mp2Run() {
 		} // End of update test
 
 	} // end of if ( par->getcurrtime == TEST_TIME)
+
+	/**
+	 * Send the messages each node batched up this time unit
+	 */
+	for ( i = 0; i <= par->EN_GPSZ-1; i++ ) {
+		mp2[i]->flushBatches();
+	}
 }
 
 /**
@@ -0,0 +1,324 @@
+/**********************************
+ * FILE NAME: Arena.cpp
+ *
+ * DESCRIPTION: Definition of the size classed slab allocator
+ **********************************/
+
+#include "Arena.h"
+
+/**
+ * Constructor
+ */
+Arena::Arena(): numSlabs(0), inUse(0), largeBytes(0), allSlabs(NULL), largeChunks(NULL) {
+	for ( int i = 0; i < ARENA_NUM_CLASSES; i++ ) {
+		partialSlabs[i] = NULL;
+	}
+}
+
+/**
+ * Destructor
+ */
+Arena::~Arena() {
+	clear();
+}
+
+/**
+ * FUNCTION NAME: sizeClassOf
+ *
+ * DESCRIPTION: Returns the smallest size class that fits size, -1 if none does
+ */
+int Arena::sizeClassOf(size_t size) {
+	int sizeClass = 0;
+	size_t chunk = ARENA_MIN_CHUNK;
+	while ( chunk < size ) {
+		chunk <<= 1;
+		sizeClass++;
+	}
+	return sizeClass < ARENA_NUM_CLASSES ? sizeClass : -1;
+}
+
+/**
+ * FUNCTION NAME: chunkSize
+ *
+ * DESCRIPTION: Returns the number of bytes in a chunk of the size class
+ */
+size_t Arena::chunkSize(int sizeClass) {
+	return (size_t)ARENA_MIN_CHUNK << sizeClass;
+}
+
+/**
+ * FUNCTION NAME: newSlab
+ *
+ * DESCRIPTION: Gets a fresh SLAB_SIZE aligned slab from the system
+ */
+Slab *Arena::newSlab(int sizeClass) {
+	void *mem = NULL;
+	if ( posix_memalign(&mem, SLAB_SIZE, SLAB_SIZE) != 0 ) {
+		return NULL;
+	}
+	Slab *slab = (Slab *)mem;
+	slab->prev = NULL;
+	slab->next = NULL;
+	slab->freeList = NULL;
+	// chunks start after the header, aligned to 16 bytes
+	slab->bump = (sizeof(Slab) + 15) & ~15u;
+	slab->live = 0;
+	slab->sizeClass = sizeClass;
+	slab->partial = false;
+	slab->allPrev = NULL;
+	slab->allNext = allSlabs;
+	if ( allSlabs ) {
+		allSlabs->allPrev = slab;
+	}
+	allSlabs = slab;
+	numSlabs++;
+	return slab;
+}
+
+/**
+ * FUNCTION NAME: freeSlab
+ *
+ * DESCRIPTION: Returns an empty slab to the system
+ */
+void Arena::freeSlab(Slab *slab) {
+	if ( slab->partial ) {
+		unlinkPartial(slab);
+	}
+	if ( slab->allPrev ) {
+		slab->allPrev->allNext = slab->allNext;
+	}
+	else {
+		allSlabs = slab->allNext;
+	}
+	if ( slab->allNext ) {
+		slab->allNext->allPrev = slab->allPrev;
+	}
+	numSlabs--;
+	free(slab);
+}
+
+/**
+ * FUNCTION NAME: linkPartial
+ *
+ * DESCRIPTION: Puts the slab at the head of the partial list of its class
+ */
+void Arena::linkPartial(Slab *slab) {
+	Slab **head = &partialSlabs[slab->sizeClass];
+	slab->prev = NULL;
+	slab->next = *head;
+	if ( *head ) {
+		(*head)->prev = slab;
+	}
+	*head = slab;
+	slab->partial = true;
+}
+
+/**
+ * FUNCTION NAME: unlinkPartial
+ *
+ * DESCRIPTION: Takes the slab off the partial list of its class
+ */
+void Arena::unlinkPartial(Slab *slab) {
+	if ( slab->prev ) {
+		slab->prev->next = slab->next;
+	}
+	else {
+		partialSlabs[slab->sizeClass] = slab->next;
+	}
+	if ( slab->next ) {
+		slab->next->prev = slab->prev;
+	}
+	slab->prev = NULL;
+	slab->next = NULL;
+	slab->partial = false;
+}
+
+/**
+ * FUNCTION NAME: allocate
+ *
+ * DESCRIPTION: Allocates size bytes owned by the arena
+ *
+ * RETURNS:
+ * pointer to the bytes, NULL if the system is out of memory
+ */
+char *Arena::allocate(size_t size) {
+	int sizeClass = sizeClassOf(size);
+	if ( sizeClass < 0 ) {
+		LargeChunk *chunk = (LargeChunk *)malloc(sizeof(LargeChunk) + size);
+		if ( chunk == NULL ) {
+			return NULL;
+		}
+		chunk->prev = NULL;
+		chunk->next = largeChunks;
+		if ( largeChunks ) {
+			largeChunks->prev = chunk;
+		}
+		largeChunks = chunk;
+		largeBytes += size;
+		inUse += size;
+		return (char *)(chunk + 1);
+	}
+
+	Slab *slab = partialSlabs[sizeClass];
+	if ( slab == NULL ) {
+		slab = newSlab(sizeClass);
+		if ( slab == NULL ) {
+			return NULL;
+		}
+		linkPartial(slab);
+	}
+
+	size_t chunk = chunkSize(sizeClass);
+	char *ptr;
+	if ( slab->freeList ) {
+		ptr = slab->freeList;
+		memcpy(&slab->freeList, ptr, sizeof(char *));
+	}
+	else {
+		ptr = (char *)slab + slab->bump;
+		slab->bump += chunk;
+	}
+	slab->live++;
+	inUse += chunk;
+
+	// A slab with neither free chunks nor bump room leaves the partial list
+	if ( slab->freeList == NULL && slab->bump + chunk > SLAB_SIZE ) {
+		unlinkPartial(slab);
+	}
+	return ptr;
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Gives back size bytes at ptr, previously returned by allocate(size)
+ */
+void Arena::release(char *ptr, size_t size) {
+	if ( ptr == NULL ) {
+		return;
+	}
+	int sizeClass = sizeClassOf(size);
+	if ( sizeClass < 0 ) {
+		LargeChunk *chunk = (LargeChunk *)ptr - 1;
+		if ( chunk->prev ) {
+			chunk->prev->next = chunk->next;
+		}
+		else {
+			largeChunks = chunk->next;
+		}
+		if ( chunk->next ) {
+			chunk->next->prev = chunk->prev;
+		}
+		largeBytes -= size;
+		inUse -= size;
+		free(chunk);
+		return;
+	}
+
+	// Slabs are SLAB_SIZE aligned so the header is found by masking the pointer
+	Slab *slab = (Slab *)((uintptr_t)ptr & ~((uintptr_t)SLAB_SIZE - 1));
+	memcpy(ptr, &slab->freeList, sizeof(char *));
+	slab->freeList = ptr;
+	slab->live--;
+	inUse -= chunkSize(sizeClass);
+
+	if ( slab->live == 0 && (partialSlabs[sizeClass] != slab || slab->next != NULL) ) {
+		// Keep at most one empty slab per class around for the next allocation
+		freeSlab(slab);
+	}
+	else if ( !slab->partial ) {
+		linkPartial(slab);
+	}
+}
+
+/**
+ * FUNCTION NAME: copy
+ *
+ * DESCRIPTION: Copies the bytes into the arena
+ *
+ * RETURNS:
+ * Slice over the arena copy
+ */
+Slice Arena::copy(const char *data, size_t size) {
+	if ( size == 0 ) {
+		return Slice();
+	}
+	char *ptr = allocate(size);
+	memcpy(ptr, data, size);
+	return Slice(ptr, size);
+}
+
+Slice Arena::copy(const Slice &slice) {
+	return copy(slice.data, slice.size);
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Gives back a Slice previously returned by copy
+ */
+void Arena::release(const Slice &slice) {
+	if ( slice.size > 0 ) {
+		release((char *)slice.data, slice.size);
+	}
+}
+
+/**
+ * FUNCTION NAME: replace
+ *
+ * DESCRIPTION: Swaps the bytes of old for a copy of data. The chunk of old is
+ * 				reused when the new size falls in the same size class.
+ *
+ * RETURNS:
+ * Slice over the new bytes
+ */
+Slice Arena::replace(const Slice &old, const char *data, size_t size) {
+	if ( old.size > 0 && size > 0 && sizeClassOf(old.size) >= 0 && sizeClassOf(old.size) == sizeClassOf(size) ) {
+		memcpy((char *)old.data, data, size);
+		return Slice(old.data, size);
+	}
+	release(old);
+	return copy(data, size);
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Returns every slab and large allocation to the system
+ */
+void Arena::clear() {
+	while ( allSlabs ) {
+		Slab *next = allSlabs->allNext;
+		free(allSlabs);
+		allSlabs = next;
+	}
+	while ( largeChunks ) {
+		LargeChunk *next = largeChunks->next;
+		free(largeChunks);
+		largeChunks = next;
+	}
+	for ( int i = 0; i < ARENA_NUM_CLASSES; i++ ) {
+		partialSlabs[i] = NULL;
+	}
+	numSlabs = 0;
+	inUse = 0;
+	largeBytes = 0;
+}
+
+/**
+ * FUNCTION NAME: bytesInUse
+ *
+ * DESCRIPTION: Returns the number of bytes handed out and not yet released
+ */
+unsigned long Arena::bytesInUse() {
+	return inUse;
+}
+
+/**
+ * FUNCTION NAME: bytesReserved
+ *
+ * DESCRIPTION: Returns the number of bytes the arena holds from the system
+ */
+unsigned long Arena::bytesReserved() {
+	return numSlabs * SLAB_SIZE + largeBytes;
+}
@@ -0,0 +1,95 @@
+/**********************************
+ * FILE NAME: Arena.h
+ *
+ * DESCRIPTION: Header file of the size classed slab allocator used by HashTable
+ **********************************/
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include "stdincludes.h"
+#include "Slice.h"
+
+/*
+ * Macros
+ */
+// every slab is SLAB_SIZE bytes and aligned to SLAB_SIZE
+#define SLAB_SIZE (64 * 1024)
+#define ARENA_MIN_CHUNK 16
+#define ARENA_NUM_CLASSES 9
+// allocations above this size bypass the slabs
+#define ARENA_MAX_CHUNK (ARENA_MIN_CHUNK << (ARENA_NUM_CLASSES - 1))
+
+/**
+ * STRUCT NAME: Slab
+ *
+ * DESCRIPTION: Header at the start of every slab. Chunks of one size class
+ * 				are carved from the rest of the slab.
+ */
+typedef struct Slab {
+	// links in the partial list of its size class
+	struct Slab *prev;
+	struct Slab *next;
+	// links in the list of every slab of the arena
+	struct Slab *allPrev;
+	struct Slab *allNext;
+	char *freeList;
+	uint32_t bump;
+	uint32_t live;
+	uint32_t sizeClass;
+	bool partial;
+} Slab;
+
+/**
+ * STRUCT NAME: LargeChunk
+ *
+ * DESCRIPTION: Header in front of an allocation too big for any size class
+ */
+typedef struct LargeChunk {
+	struct LargeChunk *prev;
+	struct LargeChunk *next;
+} LargeChunk;
+
+/**
+ * CLASS NAME: Arena
+ *
+ * DESCRIPTION: Owns the bytes of the keys and values of one table.
+ * 				Small allocations are rounded up to a power of two size class
+ * 				and served from 64KB slabs of that class. A slab whose last
+ * 				chunk is released goes back to the system unless it is the
+ * 				only slab of its class with free room, so deleting keys
+ * 				shrinks the footprint instead of leaving holes behind.
+ */
+class Arena {
+public:
+	Arena();
+	virtual ~Arena();
+	char *allocate(size_t size);
+	void release(char *ptr, size_t size);
+	Slice copy(const char *data, size_t size);
+	Slice copy(const Slice &slice);
+	void release(const Slice &slice);
+	Slice replace(const Slice &old, const char *data, size_t size);
+	void clear();
+	// bytes handed out to callers, rounded up to their size class
+	unsigned long bytesInUse();
+	// bytes held from the system, slabs and large allocations
+	unsigned long bytesReserved();
+private:
+	Slab *partialSlabs[ARENA_NUM_CLASSES];
+	unsigned long numSlabs;
+	unsigned long inUse;
+	unsigned long largeBytes;
+	Slab *allSlabs;
+	LargeChunk *largeChunks;
+	Arena(const Arena &anotherArena);
+	Arena& operator =(const Arena &anotherArena);
+	static int sizeClassOf(size_t size);
+	static size_t chunkSize(int sizeClass);
+	Slab *newSlab(int sizeClass);
+	void freeSlab(Slab *slab);
+	void linkPartial(Slab *slab);
+	void unlinkPartial(Slab *slab);
+};
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,398 @@
+/**********************************
+ * FILE NAME: BTreeIndex.cpp
+ *
+ * DESCRIPTION: Definition of the sorted index over the keys of a HashTable
+ **********************************/
+
+#include "BTreeIndex.h"
+
+/**
+ * Constructor
+ */
+BTreeIndex::BTreeIndex(): root(NULL), numKeys(0), numLeaves(0), numInner(0) {}
+
+/**
+ * Destructor
+ */
+BTreeIndex::~BTreeIndex() {
+	clear();
+}
+
+/**
+ * FUNCTION NAME: prefixOf
+ *
+ * DESCRIPTION: Returns the first 8 bytes of key as a big endian integer, zero
+ * 				padded, so integers order the same way as the bytes
+ */
+uint64_t BTreeIndex::prefixOf(const Slice &key) {
+	uint64_t prefix = 0;
+	for ( size_t i = 0; i < 8; i++ ) {
+		prefix = (prefix << 8) | (i < key.size ? (uint8_t)key.data[i] : 0);
+	}
+	return prefix;
+}
+
+/**
+ * FUNCTION NAME: compare
+ *
+ * DESCRIPTION: Compares two keys by prefix, then by bytes if the prefixes are equal
+ */
+int BTreeIndex::compare(uint64_t prefix, const Slice &key, uint64_t otherPrefix, const Slice &otherKey) {
+	if ( prefix != otherPrefix ) {
+		return prefix < otherPrefix ? -1 : 1;
+	}
+	return key.compare(otherKey);
+}
+
+/**
+ * FUNCTION NAME: lowerBound
+ *
+ * DESCRIPTION: Returns the position of the first key of the leaf not below key
+ */
+int BTreeIndex::lowerBound(const Leaf *leaf, uint64_t prefix, const Slice &key) {
+	int low = 0;
+	int high = leaf->count;
+	while ( low < high ) {
+		int mid = (low + high) / 2;
+		if ( compare(leaf->prefixes[mid], leaf->keys[mid], prefix, key) < 0 ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/**
+ * FUNCTION NAME: childOf
+ *
+ * DESCRIPTION: Returns the child of the inner node key falls under, the number
+ * 				of separators not above key
+ */
+int BTreeIndex::childOf(const Inner *inner, uint64_t prefix, const Slice &key) {
+	int low = 0;
+	int high = inner->count;
+	while ( low < high ) {
+		int mid = (low + high) / 2;
+		Slice separator(inner->keys[mid].data(), inner->keys[mid].size());
+		if ( compare(inner->prefixes[mid], separator, prefix, key) <= 0 ) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/**
+ * FUNCTION NAME: insert
+ *
+ * DESCRIPTION: Adds key to the index. The bytes are not copied, they must stay
+ * 				in place until the key is erased.
+ *
+ * RETURNS:
+ * true if the key was added
+ * false if it was there already
+ */
+bool BTreeIndex::insert(const Slice &key) {
+	uint64_t prefix = prefixOf(key);
+	Node *right = NULL;
+	string separator;
+
+	if ( root == NULL ) {
+		Leaf *leaf = new Leaf();
+		leaf->leaf = true;
+		leaf->count = 0;
+		leaf->prev = NULL;
+		leaf->next = NULL;
+		root = leaf;
+		numLeaves++;
+	}
+	if ( !insertInto(root, prefix, key, right, separator) ) {
+		return false;
+	}
+	numKeys++;
+	if ( right != NULL ) {
+		// The root split, grow the tree by one level
+		Inner *inner = new Inner();
+		inner->leaf = false;
+		inner->count = 1;
+		inner->keys[0] = separator;
+		inner->prefixes[0] = prefixOf(Slice(separator.data(), separator.size()));
+		inner->children[0] = root;
+		inner->children[1] = right;
+		root = inner;
+		numInner++;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: insertInto
+ *
+ * DESCRIPTION: Adds key under node. A node that overflows splits in two, the new
+ * 				right half and the smallest key under it are handed back to the
+ * 				parent in right and separator.
+ *
+ * RETURNS:
+ * false if the key was there already
+ */
+bool BTreeIndex::insertInto(Node *node, uint64_t prefix, const Slice &key, Node *&right, string &separator) {
+	right = NULL;
+	if ( node->leaf ) {
+		Leaf *leaf = (Leaf *)node;
+		int pos = lowerBound(leaf, prefix, key);
+		if ( pos < leaf->count && compare(leaf->prefixes[pos], leaf->keys[pos], prefix, key) == 0 ) {
+			return false;
+		}
+		for ( int i = leaf->count; i > pos; i-- ) {
+			leaf->prefixes[i] = leaf->prefixes[i - 1];
+			leaf->keys[i] = leaf->keys[i - 1];
+		}
+		leaf->prefixes[pos] = prefix;
+		leaf->keys[pos] = key;
+		if ( ++leaf->count <= BTREE_FANOUT ) {
+			return true;
+		}
+		Leaf *split = new Leaf();
+		int keep = leaf->count / 2;
+		split->leaf = true;
+		split->count = leaf->count - keep;
+		for ( int i = 0; i < split->count; i++ ) {
+			split->prefixes[i] = leaf->prefixes[keep + i];
+			split->keys[i] = leaf->keys[keep + i];
+		}
+		leaf->count = keep;
+		split->prev = leaf;
+		split->next = leaf->next;
+		if ( leaf->next != NULL ) {
+			leaf->next->prev = split;
+		}
+		leaf->next = split;
+		numLeaves++;
+		right = split;
+		separator.assign(split->keys[0].data, split->keys[0].size);
+		return true;
+	}
+
+	Inner *inner = (Inner *)node;
+	int child = childOf(inner, prefix, key);
+	Node *childRight;
+	string childSeparator;
+	if ( !insertInto(inner->children[child], prefix, key, childRight, childSeparator) ) {
+		return false;
+	}
+	if ( childRight == NULL ) {
+		return true;
+	}
+	for ( int i = inner->count; i > child; i-- ) {
+		inner->prefixes[i] = inner->prefixes[i - 1];
+		inner->keys[i].swap(inner->keys[i - 1]);
+		inner->children[i + 1] = inner->children[i];
+	}
+	inner->prefixes[child] = prefixOf(Slice(childSeparator.data(), childSeparator.size()));
+	inner->keys[child].swap(childSeparator);
+	inner->children[child + 1] = childRight;
+	if ( ++inner->count <= BTREE_FANOUT ) {
+		return true;
+	}
+	// The middle separator moves up, the halves keep the ones around it
+	Inner *split = new Inner();
+	int middle = inner->count / 2;
+	split->leaf = false;
+	split->count = inner->count - middle - 1;
+	for ( int i = 0; i < split->count; i++ ) {
+		split->prefixes[i] = inner->prefixes[middle + 1 + i];
+		split->keys[i].swap(inner->keys[middle + 1 + i]);
+		split->children[i] = inner->children[middle + 1 + i];
+	}
+	split->children[split->count] = inner->children[inner->count];
+	separator.swap(inner->keys[middle]);
+	inner->keys[middle].clear();
+	inner->count = middle;
+	numInner++;
+	right = split;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * DESCRIPTION: Removes key from the index
+ *
+ * RETURNS:
+ * true if the key was there
+ */
+bool BTreeIndex::erase(const Slice &key) {
+	bool emptied = false;
+
+	if ( root == NULL || !eraseFrom(root, prefixOf(key), key, emptied) ) {
+		return false;
+	}
+	numKeys--;
+	if ( emptied ) {
+		freeNode(root);
+		root = NULL;
+	}
+	// Drop inner roots left with a single child
+	while ( root != NULL && !root->leaf && root->count == 0 ) {
+		Inner *inner = (Inner *)root;
+		root = inner->children[0];
+		freeNode(inner);
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: eraseFrom
+ *
+ * DESCRIPTION: Removes key from under node. emptied is set when node is left
+ * 				without keys, or an inner node without children, so the parent
+ * 				frees it and drops the separator next to it.
+ *
+ * RETURNS:
+ * true if the key was there
+ */
+bool BTreeIndex::eraseFrom(Node *node, uint64_t prefix, const Slice &key, bool &emptied) {
+	emptied = false;
+	if ( node->leaf ) {
+		Leaf *leaf = (Leaf *)node;
+		int pos = lowerBound(leaf, prefix, key);
+		if ( pos >= leaf->count || compare(leaf->prefixes[pos], leaf->keys[pos], prefix, key) != 0 ) {
+			return false;
+		}
+		leaf->count--;
+		for ( int i = pos; i < leaf->count; i++ ) {
+			leaf->prefixes[i] = leaf->prefixes[i + 1];
+			leaf->keys[i] = leaf->keys[i + 1];
+		}
+		if ( leaf->count == 0 ) {
+			if ( leaf->prev != NULL ) {
+				leaf->prev->next = leaf->next;
+			}
+			if ( leaf->next != NULL ) {
+				leaf->next->prev = leaf->prev;
+			}
+			emptied = true;
+		}
+		return true;
+	}
+
+	Inner *inner = (Inner *)node;
+	int child = childOf(inner, prefix, key);
+	bool childEmptied;
+	if ( !eraseFrom(inner->children[child], prefix, key, childEmptied) ) {
+		return false;
+	}
+	if ( !childEmptied ) {
+		return true;
+	}
+	freeNode(inner->children[child]);
+	if ( inner->count == 0 ) {
+		emptied = true;
+		return true;
+	}
+	// Drop the separator on the left of the child, or on its right for the first one
+	int separator = child > 0 ? child - 1 : 0;
+	for ( int i = separator; i < inner->count - 1; i++ ) {
+		inner->prefixes[i] = inner->prefixes[i + 1];
+		inner->keys[i].swap(inner->keys[i + 1]);
+	}
+	inner->keys[inner->count - 1].clear();
+	for ( int i = child; i < inner->count; i++ ) {
+		inner->children[i] = inner->children[i + 1];
+	}
+	inner->count--;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: seek
+ *
+ * DESCRIPTION: Returns an iterator at the first key not below key
+ */
+BTreeIndex::Iterator BTreeIndex::seek(const Slice &key) const {
+	Iterator it;
+	uint64_t prefix = prefixOf(key);
+	const Node *node = root;
+
+	if ( node == NULL ) {
+		return it;
+	}
+	while ( !node->leaf ) {
+		const Inner *inner = (const Inner *)node;
+		node = inner->children[childOf(inner, prefix, key)];
+	}
+	it.leaf = (const Leaf *)node;
+	it.pos = lowerBound(it.leaf, prefix, key);
+	if ( it.pos >= it.leaf->count ) {
+		it.leaf = it.leaf->next;
+		it.pos = 0;
+	}
+	return it;
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Returns the number of keys in the index
+ */
+unsigned long BTreeIndex::size() const {
+	return numKeys;
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the bytes taken up by the nodes, separator copies longer
+ * 				than the inline buffer of a string excluded
+ */
+unsigned long BTreeIndex::memoryBytes() const {
+	return numLeaves * sizeof(Leaf) + numInner * sizeof(Inner);
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Removes every key
+ */
+void BTreeIndex::clear() {
+	if ( root != NULL ) {
+		destroy(root);
+		root = NULL;
+	}
+	numKeys = 0;
+}
+
+/**
+ * FUNCTION NAME: destroy
+ *
+ * DESCRIPTION: Frees node and every node under it
+ */
+void BTreeIndex::destroy(Node *node) {
+	if ( !node->leaf ) {
+		Inner *inner = (Inner *)node;
+		for ( int i = 0; i < inner->count + 1; i++ ) {
+			destroy(inner->children[i]);
+		}
+	}
+	freeNode(node);
+}
+
+/**
+ * FUNCTION NAME: freeNode
+ *
+ * DESCRIPTION: Frees node alone, its children are freed or moved already
+ */
+void BTreeIndex::freeNode(Node *node) {
+	if ( node->leaf ) {
+		delete (Leaf *)node;
+		numLeaves--;
+	}
+	else {
+		delete (Inner *)node;
+		numInner--;
+	}
+}
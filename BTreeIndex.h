@@ -0,0 +1,106 @@
+/**********************************
+ * FILE NAME: BTreeIndex.h
+ *
+ * DESCRIPTION: Header file of the sorted index over the keys of a HashTable
+ **********************************/
+
+#ifndef BTREEINDEX_H_
+#define BTREEINDEX_H_
+
+#include "stdincludes.h"
+#include "Slice.h"
+
+/*
+ * Macros
+ */
+// most keys in one node
+#define BTREE_FANOUT 32
+
+/**
+ * CLASS NAME: BTreeIndex
+ *
+ * DESCRIPTION: B+tree of keys in byte wise order, for range and prefix scans
+ * 				over a table that is hashed. Leaves hold the key Slices
+ * 				themselves, the bytes stay with the table, which removes a
+ * 				key from the index before freeing it. Inner nodes keep their
+ * 				own copy of each separator, as the key it came from may be
+ * 				erased while the separator is still needed.
+ *
+ * 				Every node also keeps the first 8 bytes of each key as a big
+ * 				endian integer, so a search compares integers in one array and
+ * 				only reads key bytes when two prefixes are equal. Leaves are
+ * 				chained in key order for scans. Erasing does not rebalance, a
+ * 				node is only freed once it has no key left.
+ */
+class BTreeIndex {
+private:
+	struct Node {
+		bool leaf;
+		int count;
+		// room for one key over the fanout, a node splits right after
+		uint64_t prefixes[BTREE_FANOUT + 1];
+	};
+	struct Leaf : Node {
+		Slice keys[BTREE_FANOUT + 1];
+		Leaf *prev;
+		Leaf *next;
+	};
+	struct Inner : Node {
+		// keys[i] is the smallest key under children[i + 1]
+		string keys[BTREE_FANOUT + 1];
+		Node *children[BTREE_FANOUT + 2];
+	};
+public:
+	/**
+	 * CLASS NAME: Iterator
+	 *
+	 * DESCRIPTION: Walks the keys of the index in order. Any insert or erase
+	 * 				invalidates it.
+	 */
+	class Iterator {
+	public:
+		Iterator(): leaf(NULL), pos(0) {}
+		bool valid() const {
+			return leaf != NULL;
+		}
+		const Slice &key() const {
+			return leaf->keys[pos];
+		}
+		void next() {
+			if ( ++pos >= leaf->count ) {
+				leaf = leaf->next;
+				pos = 0;
+			}
+		}
+	private:
+		friend class BTreeIndex;
+		const Leaf *leaf;
+		int pos;
+	};
+
+	BTreeIndex();
+	virtual ~BTreeIndex();
+	bool insert(const Slice &key);
+	bool erase(const Slice &key);
+	Iterator seek(const Slice &key) const;
+	unsigned long size() const;
+	unsigned long memoryBytes() const;
+	void clear();
+private:
+	Node *root;
+	unsigned long numKeys;
+	unsigned long numLeaves;
+	unsigned long numInner;
+	BTreeIndex(const BTreeIndex &anotherIndex);
+	BTreeIndex& operator =(const BTreeIndex &anotherIndex);
+	static uint64_t prefixOf(const Slice &key);
+	static int compare(uint64_t prefix, const Slice &key, uint64_t otherPrefix, const Slice &otherKey);
+	static int lowerBound(const Leaf *leaf, uint64_t prefix, const Slice &key);
+	static int childOf(const Inner *inner, uint64_t prefix, const Slice &key);
+	bool insertInto(Node *node, uint64_t prefix, const Slice &key, Node *&right, string &separator);
+	bool eraseFrom(Node *node, uint64_t prefix, const Slice &key, bool &emptied);
+	void destroy(Node *node);
+	void freeNode(Node *node);
+};
+
+#endif /* BTREEINDEX_H_ */
@@ -0,0 +1,203 @@
+/**********************************
+ * FILE NAME: BloomFilter.cpp
+ *
+ * DESCRIPTION: Definition of the blocked Bloom filter
+ **********************************/
+
+#include "BloomFilter.h"
+#include <sys/mman.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Odd multipliers, one per word of a block
+static const uint32_t bloomSalt[BLOOM_BLOCK_WORDS] __attribute__((aligned(BLOOM_BLOCK_BYTES))) = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+	0x9e3779b9U, 0x85ebca6bU, 0xc2b2ae35U, 0x27d4eb2fU,
+	0x165667b1U, 0xd3a2646dU, 0xfd7046c5U, 0xb55a4f09U
+};
+
+/**
+ * FUNCTION NAME: makeMask
+ *
+ * DESCRIPTION: Sets mask to the one bit per word a key of this hash owns in its block
+ */
+static inline void makeMask(uint32_t hash, uint32_t *mask) {
+	for ( int i = 0; i < BLOOM_BLOCK_WORDS; i++ ) {
+		mask[i] = 1u << ((hash * bloomSalt[i]) >> 27);
+	}
+}
+
+/**
+ * Constructor
+ */
+BloomFilter::BloomFilter(): words(NULL), owned(NULL), numBlocks(0), mappedBytes(0) {}
+
+/**
+ * Destructor
+ */
+BloomFilter::~BloomFilter() {
+	release();
+}
+
+void BloomFilter::release() {
+	if ( mappedBytes > 0 ) {
+		munmap(owned, mappedBytes);
+	}
+	else {
+		free(owned);
+	}
+	owned = NULL;
+	mappedBytes = 0;
+	words = NULL;
+	numBlocks = 0;
+}
+
+/**
+ * FUNCTION NAME: reset
+ *
+ * DESCRIPTION: Drops every key and sizes the filter for expectedKeys keys
+ */
+void BloomFilter::reset(unsigned long expectedKeys, int bitsPerKey) {
+	void *mem = NULL;
+	uint64_t bits = max((uint64_t)expectedKeys * bitsPerKey, (uint64_t)BLOOM_BLOCK_BYTES * 8);
+	uint64_t blocks = (bits + BLOOM_BLOCK_BYTES * 8 - 1) / (BLOOM_BLOCK_BYTES * 8);
+	release();
+	if ( blocks * BLOOM_BLOCK_BYTES >= BLOOM_MAP_BYTES ) {
+		// Fresh pages read as zero, the kernel clears each on its first write
+		mem = mmap(NULL, blocks * BLOOM_BLOCK_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if ( mem == MAP_FAILED ) {
+			throw bad_alloc();
+		}
+		mappedBytes = blocks * BLOOM_BLOCK_BYTES;
+	}
+	else {
+		if ( posix_memalign(&mem, BLOOM_BLOCK_BYTES, blocks * BLOOM_BLOCK_BYTES) != 0 ) {
+			throw bad_alloc();
+		}
+		memset(mem, 0, blocks * BLOOM_BLOCK_BYTES);
+	}
+	owned = (uint32_t *)mem;
+	words = owned;
+	numBlocks = blocks;
+}
+
+/**
+ * FUNCTION NAME: attach
+ *
+ * DESCRIPTION: Reads the blocks of a filter written out from data(). The bytes
+ * 				must outlive the filter, which cannot be added to.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the bytes are not a whole number of blocks
+ */
+bool BloomFilter::attach(const Slice &blocks) {
+	release();
+	if ( blocks.size == 0 || blocks.size % BLOOM_BLOCK_BYTES != 0 ) {
+		return false;
+	}
+	words = (const uint32_t *)blocks.data;
+	numBlocks = blocks.size / BLOOM_BLOCK_BYTES;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Adds the key of this hash
+ */
+void BloomFilter::add(uint64_t hash) {
+	uint32_t mask[BLOOM_BLOCK_WORDS];
+	if ( owned == NULL ) {
+		return;
+	}
+	uint32_t *block = owned + (blockOf(hash) - words);
+	makeMask((uint32_t)hash, mask);
+	for ( int i = 0; i < BLOOM_BLOCK_WORDS; i++ ) {
+		block[i] |= mask[i];
+	}
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: Tests the block of the key. An empty filter contains nothing.
+ *
+ * RETURNS:
+ * false if the key was never added
+ * true if it may have been
+ */
+bool BloomFilter::mayContain(uint64_t hash) const {
+	if ( numBlocks == 0 ) {
+		return false;
+	}
+	const uint32_t *block = blockOf(hash);
+#if defined(__AVX2__)
+	const __m256i ones = _mm256_set1_epi32(1);
+	const __m256i h = _mm256_set1_epi32((int)(uint32_t)hash);
+	for ( int half = 0; half < BLOOM_BLOCK_WORDS; half += 8 ) {
+		__m256i salt = _mm256_load_si256((const __m256i *)(bloomSalt + half));
+		__m256i shift = _mm256_srli_epi32(_mm256_mullo_epi32(h, salt), 27);
+		__m256i mask = _mm256_sllv_epi32(ones, shift);
+		__m256i bits = _mm256_loadu_si256((const __m256i *)(block + half));
+		if ( !_mm256_testc_si256(bits, mask) ) {
+			return false;
+		}
+	}
+	return true;
+#elif defined(__SSE2__)
+	uint32_t maskWords[BLOOM_BLOCK_WORDS] __attribute__((aligned(16)));
+	makeMask((uint32_t)hash, maskWords);
+	__m128i all = _mm_set1_epi32(-1);
+	for ( int quarter = 0; quarter < BLOOM_BLOCK_WORDS; quarter += 4 ) {
+		__m128i mask = _mm_load_si128((const __m128i *)(maskWords + quarter));
+		__m128i bits = _mm_loadu_si128((const __m128i *)(block + quarter));
+		all = _mm_and_si128(all, _mm_cmpeq_epi32(_mm_and_si128(bits, mask), mask));
+	}
+	return _mm_movemask_epi8(all) == 0xFFFF;
+#else
+	uint32_t mask[BLOOM_BLOCK_WORDS];
+	makeMask((uint32_t)hash, mask);
+	for ( int i = 0; i < BLOOM_BLOCK_WORDS; i++ ) {
+		if ( (block[i] & mask[i]) != mask[i] ) {
+			return false;
+		}
+	}
+	return true;
+#endif
+}
+
+/**
+ * FUNCTION NAME: isEmpty
+ *
+ * DESCRIPTION: Returns if the filter has no blocks yet
+ */
+bool BloomFilter::isEmpty() const {
+	return numBlocks == 0;
+}
+
+/**
+ * FUNCTION NAME: data
+ *
+ * DESCRIPTION: Returns the blocks, to be stored and attached later
+ */
+Slice BloomFilter::data() const {
+	return Slice((const char *)words, numBlocks * BLOOM_BLOCK_BYTES);
+}
+
+/**
+ * FUNCTION NAME: swap
+ *
+ * DESCRIPTION: Exchanges the blocks of the two filters
+ */
+void BloomFilter::swap(BloomFilter &anotherFilter) {
+	std::swap(words, anotherFilter.words);
+	std::swap(owned, anotherFilter.owned);
+	std::swap(numBlocks, anotherFilter.numBlocks);
+	std::swap(mappedBytes, anotherFilter.mappedBytes);
+}
@@ -0,0 +1,85 @@
+/**********************************
+ * FILE NAME: BloomFilter.h
+ *
+ * DESCRIPTION: Header file of the blocked Bloom filter kept next to every table
+ **********************************/
+
+#ifndef BLOOMFILTER_H_
+#define BLOOMFILTER_H_
+
+#include "stdincludes.h"
+#include "Slice.h"
+
+/*
+ * Macros
+ */
+// one block is one cache line of 16 32 bit words
+#define BLOOM_BLOCK_BYTES 64
+#define BLOOM_BLOCK_WORDS 16
+// a key sets one bit in every word of its block, 16 bits per key keep the
+// false positive rate around 0.1%
+#define BLOOM_BITS_PER_KEY 16
+// filters of this many bytes or more are mapped, zeroed lazily by the kernel
+// instead of cleared all at once by reset
+#define BLOOM_MAP_BYTES (1024 * 1024)
+
+/**
+ * STRUCT NAME: BloomStats
+ *
+ * DESCRIPTION: Outcome of the filter checks made ahead of real lookups.
+ * 				A negative skipped the lookup, a false positive did a lookup
+ * 				that found nothing.
+ */
+typedef struct BloomStats {
+	unsigned long negatives;
+	unsigned long falsePositives;
+	BloomStats(): negatives(0), falsePositives(0) {}
+	double falsePositiveRate() const {
+		unsigned long absent = negatives + falsePositives;
+		return absent == 0 ? 0.0 : (double)falsePositives / absent;
+	}
+} BloomStats;
+
+/**
+ * CLASS NAME: BloomFilter
+ *
+ * DESCRIPTION: Split block Bloom filter. The high half of the key hash picks
+ * 				one 64 byte block, the low half is multiplied by 16 salts to
+ * 				pick one bit in each word of that block. A lookup touches a
+ * 				single cache line and tests the whole block at once, with AVX2
+ * 				or SSE2 when they are available.
+ * 				A filter either owns its blocks (reset) or reads blocks
+ * 				stored elsewhere, e.g. in a mapped SSTable (attach).
+ */
+class BloomFilter {
+public:
+	BloomFilter();
+	virtual ~BloomFilter();
+	void reset(unsigned long expectedKeys, int bitsPerKey = BLOOM_BITS_PER_KEY);
+	bool attach(const Slice &blocks);
+	void add(uint64_t hash);
+	void add(const Slice &key) {
+		add(hashBytes(key));
+	}
+	bool mayContain(uint64_t hash) const;
+	bool mayContain(const Slice &key) const {
+		return mayContain(hashBytes(key));
+	}
+	bool isEmpty() const;
+	Slice data() const;
+	void swap(BloomFilter &anotherFilter);
+private:
+	const uint32_t *words;
+	uint32_t *owned;
+	uint64_t numBlocks;
+	// bytes mapped for owned, 0 if it was allocated
+	size_t mappedBytes;
+	BloomFilter(const BloomFilter &anotherFilter);
+	BloomFilter& operator =(const BloomFilter &anotherFilter);
+	void release();
+	const uint32_t *blockOf(uint64_t hash) const {
+		return words + (((hash >> 32) * numBlocks) >> 32) * BLOOM_BLOCK_WORDS;
+	}
+};
+
+#endif /* BLOOMFILTER_H_ */
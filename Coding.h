@@ -0,0 +1,129 @@
+/**********************************
+ * FILE NAME: Coding.h
+ *
+ * DESCRIPTION: Little endian fixed width and varint encoding helpers
+ * 				shared by the on disk and wire formats
+ **********************************/
+
+#ifndef CODING_H_
+#define CODING_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// most bytes a varint of 64 bits takes
+#define MAX_VARINT_SIZE 10
+
+inline void putFixed32(string &dst, uint32_t value) {
+	char buf[4];
+	memcpy(buf, &value, sizeof(buf));
+	dst.append(buf, sizeof(buf));
+}
+
+inline void putFixed64(string &dst, uint64_t value) {
+	char buf[8];
+	memcpy(buf, &value, sizeof(buf));
+	dst.append(buf, sizeof(buf));
+}
+
+inline char *encodeFixed32(char *ptr, uint32_t value) {
+	memcpy(ptr, &value, sizeof(value));
+	return ptr + sizeof(value);
+}
+
+inline char *encodeFixed64(char *ptr, uint64_t value) {
+	memcpy(ptr, &value, sizeof(value));
+	return ptr + sizeof(value);
+}
+
+inline uint32_t decodeFixed32(const char *ptr) {
+	uint32_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+inline uint64_t decodeFixed64(const char *ptr) {
+	uint64_t value;
+	memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+/**
+ * FUNCTION NAME: putVarint
+ *
+ * DESCRIPTION: Appends value 7 bits at a time, low bits first, with the
+ * 				high bit of every byte but the last set
+ */
+inline void putVarint(string &dst, uint64_t value) {
+	while ( value >= 0x80 ) {
+		dst.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	dst.push_back((char)value);
+}
+
+/**
+ * FUNCTION NAME: encodeVarint
+ *
+ * DESCRIPTION: Writes value as putVarint does, at ptr, which has room for
+ * 				MAX_VARINT_SIZE bytes
+ *
+ * RETURNS:
+ * pointer past the varint
+ */
+inline char *encodeVarint(char *ptr, uint64_t value) {
+	while ( value >= 0x80 ) {
+		*ptr++ = (char)(value | 0x80);
+		value >>= 7;
+	}
+	*ptr++ = (char)value;
+	return ptr;
+}
+
+/**
+ * FUNCTION NAME: varintLength
+ *
+ * DESCRIPTION: Returns the number of bytes value takes as a varint
+ */
+inline size_t varintLength(uint64_t value) {
+	size_t length = 1;
+	while ( value >= 0x80 ) {
+		value >>= 7;
+		length++;
+	}
+	return length;
+}
+
+/**
+ * FUNCTION NAME: getVarint
+ *
+ * DESCRIPTION: Decodes a varint from [ptr, limit)
+ *
+ * RETURNS:
+ * pointer past the varint, NULL if it is truncated or too long
+ */
+inline const char *getVarint(const char *ptr, const char *limit, uint64_t &value) {
+	value = 0;
+	for ( int shift = 0; shift <= 63 && ptr < limit; shift += 7 ) {
+		uint8_t byte = (uint8_t)*ptr++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if ( !(byte & 0x80) ) {
+			return ptr;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * FUNCTION NAME: putLengthPrefixed
+ *
+ * DESCRIPTION: Appends the size of the bytes as a varint, then the bytes
+ */
+inline void putLengthPrefixed(string &dst, const char *data, size_t size) {
+	putVarint(dst, size);
+	dst.append(data, size);
+}
+
+#endif /* CODING_H_ */
@@ -0,0 +1,199 @@
+/**********************************
+ * FILE NAME: Compression.cpp
+ *
+ * DESCRIPTION: Definition of the LZ77 block codec used for large values
+ **********************************/
+
+#include "Compression.h"
+#include "Coding.h"
+
+static inline uint32_t load32(const char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t hashOf(uint32_t sequence) {
+	return (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * FUNCTION NAME: putLength
+ *
+ * DESCRIPTION: Writes what a nibble of 15 left out of a length
+ */
+static void putLength(string &dst, size_t rest) {
+	while ( rest >= 255 ) {
+		dst.push_back((char)255);
+		rest -= 255;
+	}
+	dst.push_back((char)rest);
+}
+
+/**
+ * FUNCTION NAME: putSequence
+ *
+ * DESCRIPTION: Appends one sequence, matchLength 0 for the last one
+ */
+static void putSequence(string &dst, const char *literals, size_t numLiterals, size_t offset, size_t matchLength) {
+	size_t matchCode = matchLength == 0 ? 0 : matchLength - LZ_MIN_MATCH;
+	dst.push_back((char)((min(numLiterals, (size_t)15) << 4) | min(matchCode, (size_t)15)));
+	if ( numLiterals >= 15 ) {
+		putLength(dst, numLiterals - 15);
+	}
+	dst.append(literals, numLiterals);
+	if ( matchLength == 0 ) {
+		return;
+	}
+	dst.push_back((char)(offset & 0xff));
+	dst.push_back((char)(offset >> 8));
+	if ( matchCode >= 15 ) {
+		putLength(dst, matchCode - 15);
+	}
+}
+
+/**
+ * FUNCTION NAME: compressBlock
+ *
+ * DESCRIPTION: Appends src compressed to dst. Matches are found through a
+ * 				table of the last position of every hashed 4 byte sequence,
+ * 				a miss skips ahead faster the longer no match turns up.
+ */
+void compressBlock(const char *src, size_t size, string &dst) {
+	const char *end = src + size;
+	const char *anchor = src;
+	const char *ip = src;
+	// positions are kept as offsets from src, 0 doubles as empty
+	uint32_t table[1 << LZ_HASH_BITS];
+
+	putVarint(dst, size);
+	memset(table, 0, sizeof(table));
+	if ( size >= LZ_MIN_MATCH + LZ_LAST_LITERALS ) {
+		const char *matchLimit = end - LZ_LAST_LITERALS;
+		const char *searchLimit = matchLimit - LZ_MIN_MATCH;
+		unsigned int misses = 0;
+		while ( ip <= searchLimit ) {
+			uint32_t sequence = load32(ip);
+			uint32_t h = hashOf(sequence);
+			const char *candidate = src + table[h];
+			table[h] = (uint32_t)(ip - src);
+			if ( candidate >= ip || ip - candidate > LZ_MAX_OFFSET || load32(candidate) != sequence ) {
+				ip += 1 + (misses++ >> 5);
+				continue;
+			}
+			misses = 0;
+			// Extend backwards over literals, then forwards up to the limit
+			while ( ip > anchor && candidate > src && ip[-1] == candidate[-1] ) {
+				ip--;
+				candidate--;
+			}
+			const char *matchEnd = ip + LZ_MIN_MATCH;
+			const char *from = candidate + LZ_MIN_MATCH;
+			while ( matchEnd < matchLimit && *matchEnd == *from ) {
+				matchEnd++;
+				from++;
+			}
+			putSequence(dst, anchor, ip - anchor, ip - candidate, matchEnd - ip);
+			ip = anchor = matchEnd;
+			if ( ip - 2 >= src && ip <= searchLimit ) {
+				table[hashOf(load32(ip - 2))] = (uint32_t)(ip - 2 - src);
+			}
+		}
+	}
+	putSequence(dst, anchor, end - anchor, 0, 0);
+}
+
+/**
+ * FUNCTION NAME: getLength
+ *
+ * DESCRIPTION: Reads what a nibble of 15 left out of a length
+ */
+static bool getLength(const char *&ip, const char *end, size_t &length) {
+	uint8_t b;
+	do {
+		if ( ip >= end ) {
+			return false;
+		}
+		b = (uint8_t)*ip++;
+		length += b;
+	} while ( b == 255 );
+	return true;
+}
+
+/**
+ * FUNCTION NAME: decompressBlock
+ *
+ * DESCRIPTION: Replaces dst with the bytes of a block written by compressBlock.
+ * 				Every length and offset is checked, so a damaged block fails
+ * 				instead of reading or writing out of bounds.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the block is malformed
+ */
+bool decompressBlock(const char *src, size_t size, string &dst) {
+	const char *end = src + size;
+	uint64_t rawSize;
+	const char *ip = getVarint(src, end, rawSize);
+
+	if ( ip == NULL || rawSize > (size - (ip - src)) * 255 + 16 ) {
+		return false;
+	}
+	dst.resize(rawSize);
+	char *out = &dst[0];
+	size_t op = 0;
+	while ( ip < end ) {
+		uint8_t token = (uint8_t)*ip++;
+		size_t numLiterals = token >> 4;
+		if ( numLiterals == 15 && !getLength(ip, end, numLiterals) ) {
+			return false;
+		}
+		if ( numLiterals > (size_t)(end - ip) || numLiterals > rawSize - op ) {
+			return false;
+		}
+		memcpy(out + op, ip, numLiterals);
+		ip += numLiterals;
+		op += numLiterals;
+		if ( ip == end ) {
+			break;
+		}
+		if ( end - ip < 2 ) {
+			return false;
+		}
+		size_t offset = (uint8_t)ip[0] | ((size_t)(uint8_t)ip[1] << 8);
+		ip += 2;
+		size_t matchLength = token & 0x0f;
+		if ( matchLength == 15 && !getLength(ip, end, matchLength) ) {
+			return false;
+		}
+		matchLength += LZ_MIN_MATCH;
+		if ( offset == 0 || offset > op || matchLength > rawSize - op ) {
+			return false;
+		}
+		// Byte by byte, a match may overlap the bytes it produces
+		const char *from = out + op - offset;
+		for ( size_t i = 0; i < matchLength; i++ ) {
+			out[op + i] = from[i];
+		}
+		op += matchLength;
+	}
+	return op == rawSize;
+}
+
+/**
+ * FUNCTION NAME: compressValue
+ *
+ * DESCRIPTION: Compresses a value of at least COMPRESSION_THRESHOLD bytes
+ *
+ * RETURNS:
+ * true with compressed set if the value shrank by an eighth or more
+ * false if the value is better stored as it is
+ */
+bool compressValue(const Slice &value, string &compressed) {
+	if ( value.size < COMPRESSION_THRESHOLD ) {
+		return false;
+	}
+	compressed.clear();
+	compressBlock(value.data, value.size, compressed);
+	return compressed.size() <= value.size - value.size / 8;
+}
@@ -0,0 +1,38 @@
+/**********************************
+ * FILE NAME: Compression.h
+ *
+ * DESCRIPTION: Header file of the LZ77 block codec used for large values
+ **********************************/
+
+#ifndef COMPRESSION_H_
+#define COMPRESSION_H_
+
+#include "stdincludes.h"
+#include "Slice.h"
+
+/*
+ * Macros
+ */
+// values shorter than this are never compressed
+#define COMPRESSION_THRESHOLD 256
+#define LZ_MIN_MATCH 4
+// a block always ends in this many literals, so the decoder never reads a match past its end
+#define LZ_LAST_LITERALS 5
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+/*
+ * Block format, LZ4 style: the varint size of the raw bytes, then a run of
+ * sequences. A sequence is a token byte whose high nibble is the literal
+ * count and low nibble the match length minus LZ_MIN_MATCH, a nibble of 15
+ * being followed by bytes adding up to the rest (255 means more follow),
+ * then the literals, a 2 byte little endian match offset and the rest of
+ * the match length. The last sequence has literals only.
+ */
+void compressBlock(const char *src, size_t size, string &dst);
+bool decompressBlock(const char *src, size_t size, string &dst);
+
+// the value compressed if it is big enough and shrinks by an eighth at least
+bool compressValue(const Slice &value, string &compressed);
+
+#endif /* COMPRESSION_H_ */
@@ -0,0 +1,36 @@
+/**********************************
+ * FILE NAME: Crc32.cpp
+ *
+ * DESCRIPTION: CRC-32 checksum definition
+ **********************************/
+
+#include "Crc32.h"
+
+/**
+ * CLASS NAME: Crc32Table
+ *
+ * DESCRIPTION: Byte at a time lookup table, built once
+ */
+class Crc32Table {
+public:
+	uint32_t entries[256];
+	Crc32Table() {
+		for ( uint32_t i = 0; i < 256; i++ ) {
+			uint32_t c = i;
+			for ( int k = 0; k < 8; k++ ) {
+				c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+			}
+			entries[i] = c;
+		}
+	}
+};
+
+static const Crc32Table crcTable;
+
+uint32_t crc32(const char *data, size_t size, uint32_t crc) {
+	crc = ~crc;
+	for ( size_t i = 0; i < size; i++ ) {
+		crc = crcTable.entries[(crc ^ (uint8_t)data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
@@ -0,0 +1,20 @@
+/**********************************
+ * FILE NAME: Crc32.h
+ *
+ * DESCRIPTION: CRC-32 checksum of on disk records
+ **********************************/
+
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include "stdincludes.h"
+
+/**
+ * FUNCTION NAME: crc32
+ *
+ * DESCRIPTION: CRC-32 (IEEE 802.3 polynomial) of size bytes at data.
+ * 				Pass the result of a previous call as crc to continue it.
+ */
+uint32_t crc32(const char *data, size_t size, uint32_t crc = 0);
+
+#endif /* CRC32_H_ */
@@ -1,48 +1,147 @@
 /**********************************
- * FILE NAME: Application.h
+ * FILE NAME: Entry.cpp
  *
  * DESCRIPTION: Entry class definition
  **********************************/
 #include "Entry.h"
+#include "Coding.h"
+#include "Compression.h"
 
 /**
  * constructor
  */
-Entry::Entry(string _value, int _timestamp, ReplicaType _replica){
-	this->delimiter = ":";
+Entry::Entry(): version(0), replica(PRIMARY), flags(0) {}
+
+/**
+ * constructor
+ */
+Entry::Entry(string _value, uint64_t _version, ReplicaType _replica){
 	value = _value;
-	timestamp = _timestamp;
+	version = _version;
 	replica = _replica;
+	flags = 0;
 }
 
 /**
- * constructor
+ * FUNCTION NAME: makeVersion
  *
- * DESCRIPTION: Convert string to get an Entry object
- */
-Entry::Entry(string entry){
-	vector<string> tuple;
-	this->delimiter = ":";
-	size_t pos = entry.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = entry.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + delimiter.size();
-		pos = entry.find(delimiter, start);
+ * DESCRIPTION: Builds the version of a write from the time the coordinator
+ * 				issued it, with the transaction id breaking ties inside one
+ * 				time unit
+ */
+uint64_t Entry::makeVersion(int time, int transID) {
+	return ((uint64_t)(uint32_t)time << 32) | (uint32_t)transID;
+}
+
+/**
+ * FUNCTION NAME: isNewerThan
+ *
+ * DESCRIPTION: Last writer wins compare against another version
+ */
+bool Entry::isNewerThan(uint64_t anotherVersion) {
+	return version > anotherVersion;
+}
+
+/**
+ * FUNCTION NAME: isTombstone
+ *
+ * DESCRIPTION: Returns if the entry marks a deleted key
+ */
+bool Entry::isTombstone() {
+	return (flags & ENTRY_FLAG_TOMBSTONE) != 0;
+}
+
+/**
+ * FUNCTION NAME: encodeRecord
+ *
+ * DESCRIPTION: Appends key and record to dst as
+ * 				[varint key size][key][version 8][replica 1][flags 1]
+ * 				[delete time 4][varint value size][value].
+ * 				Used by the log, snapshots and SSTables alike.
+ */
+void encodeRecord(string &dst, const Slice &key, const EntryRecord &record) {
+	putLengthPrefixed(dst, key.data, key.size);
+	putFixed64(dst, record.version);
+	dst.push_back((char)record.replica);
+	dst.push_back((char)record.flags);
+	putFixed32(dst, (uint32_t)record.deleteTime);
+	putLengthPrefixed(dst, record.value.data, record.value.size);
+}
+
+/**
+ * FUNCTION NAME: decodeRecord
+ *
+ * DESCRIPTION: Decodes a record written by encodeRecord from the bytes at ptr.
+ * 				key and the value of record point into those bytes.
+ *
+ * RETURNS:
+ * pointer past the record, NULL if it runs past limit
+ */
+const char *decodeRecord(const char *ptr, const char *limit, Slice &key, EntryRecord &record) {
+	uint64_t size;
+	const char *p = getVarint(ptr, limit, size);
+	if ( p == NULL || (uint64_t)(limit - p) < size + 14 ) {
+		return NULL;
+	}
+	key = Slice(p, size);
+	p += size;
+	record.version = decodeFixed64(p);
+	record.replica = (uint8_t)p[8];
+	record.flags = (uint8_t)p[9];
+	record.deleteTime = (int32_t)decodeFixed32(p + 10);
+	p = getVarint(p + 14, limit, size);
+	if ( p == NULL || (uint64_t)(limit - p) < size ) {
+		return NULL;
+	}
+	record.value = Slice(p, size);
+	return p + size;
+}
+
+/**
+ * FUNCTION NAME: packValue
+ *
+ * DESCRIPTION: Returns the bytes to store for value, compressed into scratch
+ * 				when that pays off, and sets or clears ENTRY_FLAG_COMPRESSED
+ * 				in flags to match
+ */
+Slice packValue(const string &value, string &scratch, uint8_t &flags) {
+	if ( compressValue(Slice(value), scratch) ) {
+		flags |= ENTRY_FLAG_COMPRESSED;
+		return Slice(scratch);
 	}
-	tuple.push_back(entry.substr(start));
+	flags &= ~ENTRY_FLAG_COMPRESSED;
+	return Slice(value);
+}
 
-	value = tuple.at(0);
-	timestamp = stoi(tuple.at(1));
-	replica = static_cast<ReplicaType>(stoi(tuple.at(2)));
+/**
+ * FUNCTION NAME: unpackValue
+ *
+ * DESCRIPTION: Sets value to the value of record as it was written
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if a compressed value is damaged, value is then empty
+ */
+bool unpackValue(const EntryRecord &record, string &value) {
+	if ( (record.flags & ENTRY_FLAG_COMPRESSED) == 0 ) {
+		value.assign(record.value.data, record.value.size);
+		return true;
+	}
+	if ( !decompressBlock(record.value.data, record.value.size, value) ) {
+		value.clear();
+		return false;
+	}
+	return true;
 }
 
 /**
- * FUNCTION NAME: converToString
+ * FUNCTION NAME: unpackEntry
  *
- * DESCRIPTION: Convert the object to a string representation
+ * DESCRIPTION: Sets entry to the record as it was written, see unpackValue
  */
-string Entry::convertToString() {
-	return value + delimiter + to_string(timestamp) + delimiter + to_string(replica);
+bool unpackEntry(const EntryRecord &record, Entry &entry) {
+	entry.version = record.version;
+	entry.replica = (ReplicaType)record.replica;
+	entry.flags = record.flags & ~ENTRY_FLAG_COMPRESSED;
+	return unpackValue(record, entry.value);
 }
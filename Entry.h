@@ -1,25 +1,73 @@
 /**********************************
- * FILE NAME: Application.h
+ * FILE NAME: Entry.h
  *
  * DESCRIPTION: Header file Entry class
  **********************************/
 
+#ifndef ENTRY_H_
+#define ENTRY_H_
+
 #include "stdincludes.h"
 #include "Message.h"
+#include "Slice.h"
+
+/*
+ * Macros
+ */
+// Entry flags
+#define ENTRY_FLAG_TOMBSTONE 0x01
+// the stored value bytes are a compressed block, see Compression.h
+#define ENTRY_FLAG_COMPRESSED 0x02
 
 /**
  * CLASS NAME: Entry
  *
- * DESCRIPTION: This class describes the entry for each key in the DHT
+ * DESCRIPTION: This class describes the entry for each key in the DHT.
+ * 				The version orders writes of the same key, the write with
+ * 				the highest version wins.
  */
 class Entry{
 public:
 	string value;
-	int timestamp;
+	uint64_t version;
 	ReplicaType replica;
-	string delimiter;
+	uint8_t flags;
 
-	Entry(string entry);
-	Entry(string _value, int _timestamp, ReplicaType _replica);
-	string convertToString();
+	Entry();
+	Entry(string _value, uint64_t _version, ReplicaType _replica);
+	static uint64_t makeVersion(int time, int transID);
+	bool isNewerThan(uint64_t anotherVersion);
+	bool isTombstone();
 };
+
+/**
+ * STRUCT NAME: EntryRecord
+ *
+ * DESCRIPTION: The form an Entry is stored in inside HashTable.
+ * 				The value bytes are owned by the arena of the table.
+ * 				A deleted key keeps its record as a tombstone, with the time
+ * 				of the delete, until compaction drops it.
+ * 				Large values are kept compressed, packValue and unpackValue
+ * 				convert between them and the values of an Entry.
+ */
+typedef struct EntryRecord {
+	Slice value;
+	uint64_t version;
+	uint8_t replica;
+	uint8_t flags;
+	// kept by the eviction policy of the table, never stored on disk
+	uint16_t accessInfo;
+	int32_t deleteTime;
+	EntryRecord(): version(0), replica(PRIMARY), flags(0), accessInfo(0), deleteTime(0) {}
+	bool isTombstone() const {
+		return (flags & ENTRY_FLAG_TOMBSTONE) != 0;
+	}
+} EntryRecord;
+
+void encodeRecord(string &dst, const Slice &key, const EntryRecord &record);
+const char *decodeRecord(const char *ptr, const char *limit, Slice &key, EntryRecord &record);
+Slice packValue(const string &value, string &scratch, uint8_t &flags);
+bool unpackValue(const EntryRecord &record, string &value);
+bool unpackEntry(const EntryRecord &record, Entry &entry);
+
+#endif /* ENTRY_H_ */
@@ -0,0 +1,192 @@
+/**********************************
+ * FILE NAME: Eviction.cpp
+ *
+ * DESCRIPTION: Definition of the policies that pick the keys a full table evicts
+ **********************************/
+
+#include "Eviction.h"
+
+/**
+ * Constructor
+ */
+SampledPolicy::SampledPolicy(): rnd(0x9E3779B97F4A7C15ULL) {}
+
+uint64_t SampledPolicy::nextRandom() {
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 7;
+	rnd ^= rnd << 17;
+	return rnd;
+}
+
+/**
+ * FUNCTION NAME: victim
+ *
+ * DESCRIPTION: Samples live records by jumping to a random slot and taking
+ * 				the next live record from there, and returns the slot of the
+ * 				one with the lowest score. Tombstones are never evicted,
+ * 				compaction takes care of them.
+ */
+long SampledPolicy::victim(FlatTable<EntryRecord> &table, int now) {
+	size_t slots = table.slotCount();
+	long best = -1;
+	long bestScore = 0;
+
+	if ( slots == 0 ) {
+		return -1;
+	}
+	for ( int sample = 0; sample < EVICTION_SAMPLES; sample++ ) {
+		size_t index = nextRandom() % slots;
+		size_t probes = 0;
+		while ( probes < slots && (!table.isFull(index) || table.slotAt(index).value.isTombstone()) ) {
+			index = index + 1 == slots ? 0 : index + 1;
+			probes++;
+		}
+		if ( probes == slots ) {
+			// Nothing but tombstones
+			return -1;
+		}
+		long s = score(table.slotAt(index).value, now);
+		if ( best < 0 || s < bestScore ) {
+			best = (long)index;
+			bestScore = s;
+		}
+	}
+	return best;
+}
+
+/**
+ * Constructor
+ */
+LruPolicy::LruPolicy(): accesses(0) {}
+
+uint16_t LruPolicy::stamp() {
+	return (uint16_t)(__atomic_load_n(&accesses, __ATOMIC_RELAXED) >> LRU_CLOCK_SHIFT);
+}
+
+/**
+ * FUNCTION NAME: touch
+ *
+ * DESCRIPTION: Advances the clock and stamps the record with it
+ */
+void LruPolicy::touch(EntryRecord &record, int now) {
+	__atomic_fetch_add(&accesses, 1, __ATOMIC_RELAXED);
+	storeInfo(record, stamp());
+}
+
+/**
+ * FUNCTION NAME: score
+ *
+ * DESCRIPTION: Minus the accesses since the last use. The stamp wraps, records
+ * 				idle for over a million accesses may look recent again.
+ */
+long LruPolicy::score(const EntryRecord &record, int now) {
+	return -(long)(uint16_t)(stamp() - loadInfo(record));
+}
+
+/**
+ * FUNCTION NAME: decayedCount
+ *
+ * DESCRIPTION: Returns the counter in info minus the steps it lost since the last access
+ */
+int LfuPolicy::decayedCount(uint16_t info, int now) {
+	int count = info & 0xff;
+	int idle = (uint8_t)((uint8_t)now - (info >> 8));
+	return max(count - idle / LFU_DECAY_TIME, 0);
+}
+
+/**
+ * FUNCTION NAME: touch
+ *
+ * DESCRIPTION: Decays the counter, then bumps it with a chance that falls as
+ * 				it grows, so 8 bits cover millions of accesses.
+ * 				Readers may run in parallel, each draws from its own generator.
+ */
+void LfuPolicy::touch(EntryRecord &record, int now) {
+	static thread_local uint32_t rnd = 0x5eed1e55;
+	uint16_t info = loadInfo(record);
+	int count = info == 0 ? LFU_INIT_COUNT : decayedCount(info, now);
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	if ( count < 255 ) {
+		double chance = 1.0 / ((count - min(count, LFU_INIT_COUNT)) * 10 + 1);
+		if ( (rnd & 0xffffff) < chance * 0x1000000 ) {
+			count++;
+		}
+	}
+	storeInfo(record, (uint16_t)(((now & 0xff) << 8) | count));
+}
+
+/**
+ * FUNCTION NAME: score
+ *
+ * DESCRIPTION: The decayed counter
+ */
+long LfuPolicy::score(const EntryRecord &record, int now) {
+	return decayedCount(loadInfo(record), now);
+}
+
+/**
+ * Constructor
+ */
+ClockPolicy::ClockPolicy(): hand(0) {}
+
+/**
+ * FUNCTION NAME: touch
+ *
+ * DESCRIPTION: Sets the reference bit
+ */
+void ClockPolicy::touch(EntryRecord &record, int now) {
+	if ( loadInfo(record) == 0 ) {
+		storeInfo(record, 1);
+	}
+}
+
+/**
+ * FUNCTION NAME: victim
+ *
+ * DESCRIPTION: Moves the hand on until it finds a live record with its
+ * 				reference bit clear, clearing the bits it passes. Two turns
+ * 				always find one, unless there are only tombstones.
+ */
+long ClockPolicy::victim(FlatTable<EntryRecord> &table, int now) {
+	size_t slots = table.slotCount();
+
+	for ( size_t step = 0; step < 2 * slots; step++ ) {
+		if ( hand >= slots ) {
+			hand = 0;
+		}
+		size_t index = hand++;
+		if ( !table.isFull(index) || table.slotAt(index).value.isTombstone() ) {
+			continue;
+		}
+		EntryRecord &record = table.mutableSlotAt(index).value;
+		if ( loadInfo(record) == 0 ) {
+			return (long)index;
+		}
+		storeInfo(record, 0);
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: newEvictionPolicy
+ *
+ * DESCRIPTION: Returns the policy called name: LRU, CLOCK or LFU
+ *
+ * RETURNS:
+ * the policy, owned by the caller
+ * NULL for NONE or an unknown name, the table then rejects new keys once full
+ */
+EvictionPolicy *newEvictionPolicy(const string &name) {
+	if ( name == "LRU" ) {
+		return new LruPolicy();
+	}
+	if ( name == "CLOCK" ) {
+		return new ClockPolicy();
+	}
+	if ( name == "LFU" ) {
+		return new LfuPolicy();
+	}
+	return NULL;
+}
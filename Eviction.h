@@ -0,0 +1,125 @@
+/**********************************
+ * FILE NAME: Eviction.h
+ *
+ * DESCRIPTION: Header file of the policies that pick the keys a full table evicts
+ **********************************/
+
+#ifndef EVICTION_H_
+#define EVICTION_H_
+
+#include "stdincludes.h"
+#include "Entry.h"
+#include "FlatTable.h"
+
+/*
+ * Macros
+ */
+// records looked at by a sampled policy to pick one victim
+#define EVICTION_SAMPLES 8
+// time units after which an LFU counter loses one step
+#define LFU_DECAY_TIME 4
+// initial LFU counter, so a new key is not the first to go
+#define LFU_INIT_COUNT 5
+// accesses per step of the LRU clock, the 16 bit stamp wraps after 1M accesses
+#define LRU_CLOCK_SHIFT 4
+
+/**
+ * CLASS NAME: EvictionPolicy
+ *
+ * DESCRIPTION: Picks the records a table over its memory limit drops.
+ * 				A policy keeps its state in the accessInfo field of every
+ * 				record, stamped on each access, and finds victims among
+ * 				the live records of the table itself, so no list or map
+ * 				of keys is kept next to the table.
+ * 				touch() may run under a read lock, concurrently with other
+ * 				readers, so accessInfo is only read and written atomically.
+ * 				A lost update costs a little precision, nothing more.
+ */
+class EvictionPolicy {
+public:
+	virtual ~EvictionPolicy() {}
+	// records an access to record at time now
+	virtual void touch(EntryRecord &record, int now) = 0;
+	// returns the slot of the live record to evict, -1 if there is none
+	virtual long victim(FlatTable<EntryRecord> &table, int now) = 0;
+protected:
+	static uint16_t loadInfo(const EntryRecord &record) {
+		return __atomic_load_n(&record.accessInfo, __ATOMIC_RELAXED);
+	}
+	static void storeInfo(EntryRecord &record, uint16_t info) {
+		__atomic_store_n(&record.accessInfo, info, __ATOMIC_RELAXED);
+	}
+};
+
+/**
+ * CLASS NAME: SampledPolicy
+ *
+ * DESCRIPTION: Evicts the record with the lowest score out of
+ * 				EVICTION_SAMPLES live records picked at random
+ */
+class SampledPolicy : public EvictionPolicy {
+public:
+	SampledPolicy();
+	long victim(FlatTable<EntryRecord> &table, int now);
+protected:
+	virtual long score(const EntryRecord &record, int now) = 0;
+private:
+	uint64_t rnd;
+	uint64_t nextRandom();
+};
+
+/**
+ * CLASS NAME: LruPolicy
+ *
+ * DESCRIPTION: Approximate LRU. A clock counts the accesses to the table,
+ * 				a record is stamped with 16 bits of it when used and the
+ * 				oldest sampled record goes. Time units are too coarse for
+ * 				this, a whole burst of accesses shares one.
+ */
+class LruPolicy : public SampledPolicy {
+public:
+	LruPolicy();
+	void touch(EntryRecord &record, int now);
+protected:
+	long score(const EntryRecord &record, int now);
+private:
+	unsigned long accesses;
+	uint16_t stamp();
+};
+
+/**
+ * CLASS NAME: LfuPolicy
+ *
+ * DESCRIPTION: Approximate LFU. The high byte of accessInfo holds the
+ * 				time of the last access, the low byte a logarithmic use
+ * 				counter that loses a step every LFU_DECAY_TIME time units
+ * 				without use, so keys that were hot long ago can go.
+ */
+class LfuPolicy : public SampledPolicy {
+public:
+	void touch(EntryRecord &record, int now);
+protected:
+	long score(const EntryRecord &record, int now);
+private:
+	static int decayedCount(uint16_t info, int now);
+};
+
+/**
+ * CLASS NAME: ClockPolicy
+ *
+ * DESCRIPTION: CLOCK, second chance LRU. A hand sweeps the slots of the
+ * 				table, clearing the reference bit of used records and
+ * 				evicting the first one found unused since the last sweep.
+ */
+class ClockPolicy : public EvictionPolicy {
+public:
+	ClockPolicy();
+	void touch(EntryRecord &record, int now);
+	long victim(FlatTable<EntryRecord> &table, int now);
+private:
+	size_t hand;
+};
+
+EvictionPolicy *newEvictionPolicy(const string &name);
+
+#endif /* EVICTION_H_ */
@@ -0,0 +1,616 @@
+/**********************************
+ * FILE NAME: FlatTable.h
+ *
+ * DESCRIPTION: Open addressing hash table used as the storage
+ * 				index behind HashTable
+ **********************************/
+
+#ifndef FLATTABLE_H_
+#define FLATTABLE_H_
+
+#include "stdincludes.h"
+#include "Slice.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Macros
+ */
+// number of control bytes probed together
+#define FLAT_GROUP_WIDTH 16
+// control byte values, a full slot holds the low 7 bits of its hash
+#define FLAT_CTRL_EMPTY ((int8_t)-128)
+#define FLAT_CTRL_DELETED ((int8_t)-2)
+// most slots in one copy on write page, a power of two and a whole number of groups
+#define FLAT_PAGE_SLOTS 256
+// slots of the draining level an insert or erase moves over while resizing
+#define FLAT_MIGRATE_SLOTS 32
+// pages of a drained level an insert or erase frees
+#define FLAT_RETIRE_PAGES 4
+
+/**
+ * CLASS NAME: FlatGroup
+ *
+ * DESCRIPTION: A group of FLAT_GROUP_WIDTH control bytes. Matching is done
+ * 				on the whole group at once, with SSE2 when it is available.
+ * 				Every match returns a bit mask with one bit per slot.
+ */
+class FlatGroup {
+public:
+	const int8_t *ctrl;
+	FlatGroup(const int8_t *ctrl): ctrl(ctrl) {}
+#ifdef __SSE2__
+	uint32_t match(int8_t h2) const {
+		__m128i bytes = _mm_loadu_si128((const __m128i *)ctrl);
+		return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(h2)));
+	}
+	uint32_t matchEmpty() const {
+		return match(FLAT_CTRL_EMPTY);
+	}
+	uint32_t matchFree() const {
+		// EMPTY and DELETED are the only negative values below -1
+		__m128i bytes = _mm_loadu_si128((const __m128i *)ctrl);
+		return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), bytes));
+	}
+#else
+	uint32_t match(int8_t h2) const {
+		uint32_t mask = 0;
+		for ( int i = 0; i < FLAT_GROUP_WIDTH; i++ ) {
+			if ( ctrl[i] == h2 ) {
+				mask |= (1u << i);
+			}
+		}
+		return mask;
+	}
+	uint32_t matchEmpty() const {
+		return match(FLAT_CTRL_EMPTY);
+	}
+	uint32_t matchFree() const {
+		uint32_t mask = 0;
+		for ( int i = 0; i < FLAT_GROUP_WIDTH; i++ ) {
+			if ( ctrl[i] < -1 ) {
+				mask |= (1u << i);
+			}
+		}
+		return mask;
+	}
+#endif
+	static int lowestBit(uint32_t mask) {
+		return __builtin_ctz(mask);
+	}
+};
+
+/**
+ * CLASS NAME: FlatTable
+ *
+ * DESCRIPTION: Open addressing hash table keyed by Slice.
+ * 				The table never owns key or value bytes, the caller points
+ * 				the key of a new slot at its own copy after insert.
+ * 				Slots are kept in pages of up to FLAT_PAGE_SLOTS, next to
+ * 				the control bytes of the page. A lookup hashes the key once,
+ * 				uses the high bits to pick a group and the low 7 bits as a
+ * 				tag, so the key itself is only compared for slots whose tag
+ * 				matches. Groups are probed quadratically and never wrap into
+ * 				each other, so an empty byte in a group ends the probe.
+ *
+ * 				Resizing is incremental. The full table becomes the draining
+ * 				level and new keys go to a fresh current level, then every
+ * 				insert and erase moves the next FLAT_MIGRATE_SLOTS slots of
+ * 				the draining level over. Lookups try the current level, then
+ * 				the draining one, so no single write pays for moving the
+ * 				whole table. Slot indexes run over the current level, then
+ * 				the draining one. The pages of a drained level are freed
+ * 				FLAT_RETIRE_PAGES per insert or erase too, freeing a large
+ * 				level at once stalls the write that finishes the move.
+ *
+ * 				Copying a table only copies the page pointers: pages are
+ * 				reference counted and shared until a write reaches them,
+ * 				then the writing table takes a private copy of that one
+ * 				page. A copy is a point in time snapshot that costs one
+ * 				pointer per page, later writes to either table only ever
+ * 				copy the pages they touch. The reference counts are not
+ * 				atomic, a table and its copies are used under one lock.
+ * 				find(), insert(), erase(), mutableSlotAt() and eraseAt()
+ * 				write, peek(), count() and slotAt() only read.
+ */
+template <typename V>
+class FlatTable {
+public:
+	struct Slot {
+		Slice key;
+		V value;
+	};
+
+	FlatTable(): migrateCursor(0) {}
+
+	FlatTable(const FlatTable &anotherTable): migrateCursor(0) {
+		share(anotherTable);
+	}
+
+	FlatTable& operator =(const FlatTable &anotherTable) {
+		if ( this != &anotherTable ) {
+			clear();
+			share(anotherTable);
+		}
+		return *this;
+	}
+
+	~FlatTable() {
+		clear();
+	}
+
+	/**
+	 * FUNCTION NAME: find
+	 *
+	 * DESCRIPTION: Returns a pointer to the value of key, NULL if key is not present.
+	 * 				The value may be written through, its page is made private first.
+	 */
+	V *find(const Slice &key) {
+		return find(key, hashBytes(key));
+	}
+
+	// Same, for a caller that already hashed the key with hashBytes
+	V *find(const Slice &key, size_t hash) {
+		long index = locate(key, hash);
+		return index < 0 ? NULL : &mutableSlotAt(index).value;
+	}
+
+	/**
+	 * FUNCTION NAME: peek
+	 *
+	 * DESCRIPTION: Returns a pointer to the value of key, NULL if key is not present,
+	 * 				without copying a shared page
+	 */
+	const V *peek(const Slice &key, size_t hash) const {
+		long index = locate(key, hash);
+		return index < 0 ? NULL : &slotAt(index).value;
+	}
+
+	/**
+	 * FUNCTION NAME: insert
+	 *
+	 * DESCRIPTION: Finds the slot of key, creating it if needed.
+	 * 				inserted is set to true when a new slot was created,
+	 * 				its key then still points at the bytes passed in.
+	 *
+	 * RETURNS:
+	 * pointer to the slot
+	 */
+	Slot *insert(const Slice &key, bool &inserted) {
+		return insert(key, hashBytes(key), inserted);
+	}
+
+	// Same, for a caller that already hashed the key with hashBytes
+	Slot *insert(const Slice &key, size_t hash, bool &inserted) {
+		return insert(key, hash, inserted, true);
+	}
+
+	// Same, without resizing when mayResize is not set and hasRoom() is true.
+	// The new key then takes a free slot of the current level, deleted or not.
+	Slot *insert(const Slice &key, size_t hash, bool &inserted, bool mayResize) {
+		long index = locate(key, hash);
+		inserted = false;
+		if ( index >= 0 ) {
+			return &mutableSlotAt(index);
+		}
+		migrate(FLAT_MIGRATE_SLOTS);
+		size_t newSlots = resizeSlots();
+		if ( newSlots > 0 && (mayResize || !hasRoom()) ) {
+			startResize(newSlots);
+		}
+		index = findFree(current, hash);
+		Page *page = writablePage(current, index);
+		size_t offset = index & (current.pageSlots - 1);
+		if ( page->ctrl[offset] == FLAT_CTRL_DELETED ) {
+			current.numDeleted--;
+		}
+		page->ctrl[offset] = h2(hash);
+		page->slots[offset].key = key;
+		page->slots[offset].value = V();
+		current.numFull++;
+		inserted = true;
+		return &page->slots[offset];
+	}
+
+	/**
+	 * FUNCTION NAME: erase
+	 *
+	 * DESCRIPTION: Removes key from the table, the removed slot is copied
+	 * 				to removed so the caller can free its bytes
+	 *
+	 * RETURNS:
+	 * true if the key was present
+	 */
+	bool erase(const Slice &key, Slot &removed) {
+		migrate(FLAT_MIGRATE_SLOTS);
+		long index = locate(key, hashBytes(key));
+		if ( index < 0 ) {
+			return false;
+		}
+		removed = slotAt(index);
+		eraseAt(index);
+		return true;
+	}
+
+	unsigned long size() const {
+		return current.numFull + draining.numFull;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	unsigned long count(const Slice &key) const {
+		return locate(key, hashBytes(key)) < 0 ? 0 : 1;
+	}
+
+	/**
+	 * FUNCTION NAME: clear
+	 *
+	 * DESCRIPTION: Empties the table. Pages still shared with a copy stay with the copy.
+	 */
+	void clear() {
+		release(current);
+		release(draining);
+		freeRetired(retired.size());
+		migrateCursor = 0;
+	}
+
+	/**
+	 * FUNCTION NAME: slotCount
+	 *
+	 * DESCRIPTION: Returns the number of slots, full or not, of both levels.
+	 * 				Slot indexes are only stable until the next insert or erase.
+	 */
+	size_t slotCount() const {
+		return current.capacity() + draining.capacity();
+	}
+
+	bool isFull(size_t index) const {
+		if ( index < current.capacity() ) {
+			return ctrlAt(current, index)[0] >= 0;
+		}
+		index -= current.capacity();
+		// Slots below the cursor have moved to the current level
+		return index >= migrateCursor && ctrlAt(draining, index)[0] >= 0;
+	}
+
+	const Slot &slotAt(size_t index) const {
+		const Level &level = levelOf(index);
+		return level.pages[index >> level.pageShift]->slots[index & (level.pageSlots - 1)];
+	}
+
+	Slot &mutableSlotAt(size_t index) {
+		Level &level = levelOf(index);
+		return writablePage(level, index)->slots[index & (level.pageSlots - 1)];
+	}
+
+	/**
+	 * FUNCTION NAME: eraseAt
+	 *
+	 * DESCRIPTION: Removes the full slot at index
+	 */
+	void eraseAt(size_t index) {
+		Level &level = levelOf(index);
+		Page *page = writablePage(level, index);
+		size_t offset = index & (level.pageSlots - 1);
+		// A group that still has an empty byte never made a probe move on,
+		// so the slot can go straight back to empty
+		if ( FlatGroup(&page->ctrl[offset - offset % FLAT_GROUP_WIDTH]).matchEmpty() ) {
+			page->ctrl[offset] = FLAT_CTRL_EMPTY;
+		}
+		else {
+			page->ctrl[offset] = FLAT_CTRL_DELETED;
+			level.numDeleted++;
+		}
+		page->slots[offset].key = Slice();
+		page->slots[offset].value = V();
+		level.numFull--;
+	}
+
+	/**
+	 * FUNCTION NAME: forEach
+	 *
+	 * DESCRIPTION: Calls fn(key, value) for every full slot
+	 */
+	template <typename F>
+	void forEach(F fn) const {
+		for ( size_t i = 0; i < slotCount(); i++ ) {
+			if ( isFull(i) ) {
+				fn(slotAt(i).key, slotAt(i).value);
+			}
+		}
+	}
+
+	/**
+	 * FUNCTION NAME: stepResize
+	 *
+	 * DESCRIPTION: Moves the next FLAT_MIGRATE_SLOTS slots of the draining level
+	 * 				over, as an insert or erase does
+	 */
+	void stepResize() {
+		migrate(FLAT_MIGRATE_SLOTS);
+	}
+
+	/**
+	 * FUNCTION NAME: resizeSlots
+	 *
+	 * DESCRIPTION: Returns the number of slots of the level the next insert of
+	 * 				a new key resizes the table to, 0 if it does not resize.
+	 * 				When deleted slots take up most of the room, as under
+	 * 				eviction, they are cleared out at the same size instead of
+	 * 				growing.
+	 */
+	size_t resizeSlots() const {
+		if ( (current.numFull + current.numDeleted + 1) * 8 <= current.capacity() * 7 ) {
+			return 0;
+		}
+		return levelSlots(current.numFull * 32 <= current.capacity() * 25 ? current.capacity() * 7 / 8 : current.numFull * 2 + 1);
+	}
+
+	/**
+	 * FUNCTION NAME: hasRoom
+	 *
+	 * DESCRIPTION: Returns if one more key leaves an eighth of the current level
+	 * 				free, deleted slots counted as free
+	 */
+	bool hasRoom() const {
+		return (current.numFull + 1) * 8 <= current.capacity() * 7;
+	}
+
+	/**
+	 * FUNCTION NAME: isResizing
+	 *
+	 * DESCRIPTION: Returns if slots are still being moved to the current level
+	 */
+	bool isResizing() const {
+		return draining.numGroups > 0;
+	}
+
+private:
+	struct Page {
+		int refs;
+		vector<int8_t> ctrl;
+		vector<Slot> slots;
+		Page(size_t numSlots): refs(1), ctrl(numSlots, FLAT_CTRL_EMPTY), slots(numSlots) {}
+	};
+
+	// One array of slots, the table has two of them while it resizes
+	struct Level {
+		vector<Page *> pages;
+		// slots per page, a power of two and a whole number of groups
+		size_t pageSlots;
+		size_t pageShift;
+		size_t numGroups;
+		unsigned long numFull;
+		unsigned long numDeleted;
+		Level(): pageSlots(0), pageShift(0), numGroups(0), numFull(0), numDeleted(0) {}
+		size_t capacity() const {
+			return numGroups * FLAT_GROUP_WIDTH;
+		}
+	};
+
+	Level current;
+	// slots not moved to the current level yet, empty when not resizing
+	Level draining;
+	// next slot of the draining level to move
+	size_t migrateCursor;
+	// pages of drained levels not freed yet, never shared with a copy of the table
+	vector<Page *> retired;
+
+	static int8_t h2(size_t hash) {
+		return (int8_t)(hash & 0x7f);
+	}
+
+	static size_t firstGroup(const Level &level, size_t hash) {
+		return (hash >> 7) & (level.numGroups - 1);
+	}
+
+	// Pages are allocated by their first write, until then they read as empty
+	static const int8_t *ctrlAt(const Level &level, size_t index) {
+		static const int8_t emptyGroup[FLAT_GROUP_WIDTH] = {
+			FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY,
+			FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY,
+			FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY,
+			FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY, FLAT_CTRL_EMPTY
+		};
+		const Page *page = level.pages[index >> level.pageShift];
+		if ( page == NULL ) {
+			return emptyGroup + index % FLAT_GROUP_WIDTH;
+		}
+		return &page->ctrl[index & (level.pageSlots - 1)];
+	}
+
+	// Turns a slot index into its level and the index within it
+	const Level &levelOf(size_t &index) const {
+		if ( index < current.capacity() ) {
+			return current;
+		}
+		index -= current.capacity();
+		return draining;
+	}
+
+	Level &levelOf(size_t &index) {
+		if ( index < current.capacity() ) {
+			return current;
+		}
+		index -= current.capacity();
+		return draining;
+	}
+
+	void share(const FlatTable &anotherTable) {
+		current = anotherTable.current;
+		draining = anotherTable.draining;
+		migrateCursor = anotherTable.migrateCursor;
+		for ( size_t i = 0; i < current.pages.size(); i++ ) {
+			if ( current.pages[i] != NULL ) {
+				current.pages[i]->refs++;
+			}
+		}
+		for ( size_t i = 0; i < draining.pages.size(); i++ ) {
+			if ( draining.pages[i] != NULL ) {
+				draining.pages[i]->refs++;
+			}
+		}
+	}
+
+	static void release(Level &level) {
+		for ( size_t i = 0; i < level.pages.size(); i++ ) {
+			if ( level.pages[i] != NULL && --level.pages[i]->refs == 0 ) {
+				delete level.pages[i];
+			}
+		}
+		level = Level();
+	}
+
+	// Drops level, leaving its pages for freeRetired()
+	void retire(Level &level) {
+		for ( size_t i = 0; i < level.pages.size(); i++ ) {
+			if ( level.pages[i] != NULL ) {
+				retired.push_back(level.pages[i]);
+			}
+		}
+		level = Level();
+	}
+
+	// Frees up to budget retired pages, a page a copy still shares stays with it
+	void freeRetired(size_t budget) {
+		for ( size_t i = 0; i < budget && !retired.empty(); i++ ) {
+			if ( --retired.back()->refs == 0 ) {
+				delete retired.back();
+			}
+			retired.pop_back();
+		}
+	}
+
+	// Returns the page of index, allocated or copied first if another table shares it
+	static Page *writablePage(Level &level, size_t index) {
+		Page *&page = level.pages[index >> level.pageShift];
+		if ( page == NULL ) {
+			page = new Page(level.pageSlots);
+		}
+		else if ( page->refs > 1 ) {
+			Page *copy = new Page(*page);
+			copy->refs = 1;
+			page->refs--;
+			page = copy;
+		}
+		return page;
+	}
+
+	// Returns the slot index of key over both levels, -1 if it is not present
+	long locate(const Slice &key, size_t hash) const {
+		long index = findIndex(current, key, hash);
+		if ( index >= 0 || draining.numGroups == 0 ) {
+			return index;
+		}
+		index = findIndex(draining, key, hash);
+		// A key below the cursor was moved and has been erased since
+		if ( index < 0 || (size_t)index < migrateCursor ) {
+			return -1;
+		}
+		return (long)current.capacity() + index;
+	}
+
+	static long findIndex(const Level &level, const Slice &key, size_t hash) {
+		if ( level.numGroups == 0 ) {
+			return -1;
+		}
+		size_t group = firstGroup(level, hash);
+		for ( size_t step = 1; step <= level.numGroups; step++ ) {
+			size_t base = group * FLAT_GROUP_WIDTH;
+			const Page *page = level.pages[base >> level.pageShift];
+			if ( page == NULL ) {
+				return -1;
+			}
+			size_t offset = base & (level.pageSlots - 1);
+			FlatGroup g(&page->ctrl[offset]);
+			uint32_t mask = g.match(h2(hash));
+			while ( mask ) {
+				int bit = FlatGroup::lowestBit(mask);
+				if ( page->slots[offset + bit].key == key ) {
+					return (long)(base + bit);
+				}
+				mask &= mask - 1;
+			}
+			if ( g.matchEmpty() ) {
+				return -1;
+			}
+			group = (group + step) & (level.numGroups - 1);
+		}
+		return -1;
+	}
+
+	static long findFree(const Level &level, size_t hash) {
+		size_t group = firstGroup(level, hash);
+		for ( size_t step = 1; step <= level.numGroups; step++ ) {
+			size_t base = group * FLAT_GROUP_WIDTH;
+			uint32_t mask = FlatGroup(ctrlAt(level, base)).matchFree();
+			if ( mask ) {
+				return (long)(base + FlatGroup::lowestBit(mask));
+			}
+			group = (group + step) & (level.numGroups - 1);
+		}
+		return -1;
+	}
+
+	// Returns the slots of the smallest level that holds minSlots keys
+	static size_t levelSlots(unsigned long minSlots) {
+		size_t groups = 1;
+		while ( groups * FLAT_GROUP_WIDTH * 7 < minSlots * 8 ) {
+			groups <<= 1;
+		}
+		return groups * FLAT_GROUP_WIDTH;
+	}
+
+	// Makes the current level the draining one and starts a fresh one of slots slots
+	void startResize(size_t slots) {
+		// Only happens if writes outran the migration, which the sizing of levels rules out
+		migrate((size_t)-1);
+		draining = current;
+		migrateCursor = 0;
+		current = Level();
+		current.numGroups = slots / FLAT_GROUP_WIDTH;
+		current.pageSlots = min(current.capacity(), (size_t)FLAT_PAGE_SLOTS);
+		current.pageShift = __builtin_ctzl(current.pageSlots);
+		current.pages.assign(current.capacity() / current.pageSlots, NULL);
+		if ( draining.numFull == 0 ) {
+			release(draining);
+		}
+	}
+
+	// Moves up to budget slots of the draining level over, then retires it once it is done
+	void migrate(size_t budget) {
+		freeRetired(FLAT_RETIRE_PAGES);
+		if ( draining.numGroups == 0 ) {
+			return;
+		}
+		for ( size_t i = 0; i < budget && migrateCursor < draining.capacity(); i++ ) {
+			size_t index = migrateCursor++;
+			if ( ctrlAt(draining, index)[0] < 0 ) {
+				continue;
+			}
+			// The draining slot is left as it is, the cursor tells it has moved
+			const Slot &slot = draining.pages[index >> draining.pageShift]->slots[index & (draining.pageSlots - 1)];
+			size_t hash = hashBytes(slot.key);
+			long target = findFree(current, hash);
+			Page *page = writablePage(current, target);
+			size_t offset = target & (current.pageSlots - 1);
+			if ( page->ctrl[offset] == FLAT_CTRL_DELETED ) {
+				current.numDeleted--;
+			}
+			page->ctrl[offset] = h2(hash);
+			page->slots[offset] = slot;
+			current.numFull++;
+			draining.numFull--;
+		}
+		if ( migrateCursor >= draining.capacity() ) {
+			retire(draining);
+			migrateCursor = 0;
+		}
+	}
+};
+
+#endif /* FLATTABLE_H_ */
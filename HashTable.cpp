@@ -6,9 +6,63 @@
 
 #include "HashTable.h"
 
-HashTable::HashTable() {}
+HashTable::HashTable(): numTombstones(0), keyBytes(0), valueBytes(0), lastTime(0), compactCursor(0),
+		wal(NULL), snapshot(NULL), warmCursor(0), pendingLive(0), pendingTombstones(0),
+		filterCapacity(0), filterStale(0), filterRebuilding(false), filterCursor(0),
+		filterSlots(0), nextFilterCapacity(0), filterNegatives(0), filterFalsePositives(0),
+		memoryLimit(0), memoryBudget(NULL), evictionPolicy(NULL), numEvictions(0), viewEpoch(0), orderedIndex(NULL) {
+	rebuildFilter();
+}
+
+HashTable::~HashTable() {
+	// Closing the log syncs the records of the last tick
+	delete wal;
+	delete snapshot;
+	delete evictionPolicy;
+	delete orderedIndex;
+}
+
+/**
+ * FUNCTION NAME: logRecord
+ *
+ * DESCRIPTION: Appends the state of the key to the log, if there is one
+ */
+void HashTable::logRecord(const Slice &key, const EntryRecord &record) {
+	if ( wal != NULL ) {
+		wal->appendPut(key, record);
+	}
+}
 
-HashTable::~HashTable() {}
+/**
+ * FUNCTION NAME: storeEntry
+ *
+ * DESCRIPTION: Copies the entry into the record, reusing the arena chunk of
+ * 				the old value when it fits
+ */
+void HashTable::storeEntry(EntryRecord &record, const Entry &entry) {
+	bool wasTombstone = record.isTombstone();
+	record.version = entry.version;
+	record.replica = (uint8_t)entry.replica;
+	record.flags = entry.flags;
+	if ( record.isTombstone() ) {
+		// A tombstone keeps no value bytes
+		retireValue(record.value);
+		record.value = Slice();
+		record.flags &= ~ENTRY_FLAG_COMPRESSED;
+		record.deleteTime = lastTime;
+	}
+	else {
+		string scratch;
+		Slice stored = packValue(entry.value, scratch, record.flags);
+		record.value = replaceBytes(record.value, stored.data, stored.size);
+	}
+	if ( wasTombstone && !record.isTombstone() ) {
+		numTombstones--;
+	}
+	else if ( !wasTombstone && record.isTombstone() ) {
+		numTombstones++;
+	}
+}
 
 /**
  * FUNCTION NAME: create
@@ -19,9 +73,54 @@ HashTable::~HashTable() {}
  * true on SUCCESS
  * false in FAILURE
  */
-bool HashTable::create(string key, string value) {
-	hashTable.emplace(key, value);
-	return true;
+bool HashTable::create(const Key &key, const string &value) {
+	return create(key, Entry(value, 0, PRIMARY));
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: This function inserts the (key,entry) pair into the local hash table.
+ * 				If the key is already present the write with the higher version wins.
+ *
+ * RETURNS:
+ * true if the entry is stored or the same version is already stored
+ * false if a newer version is already stored
+ */
+bool HashTable::create(const Key &key, const Entry &entry) {
+	bool inserted;
+	bool mayResize = true;
+	if ( faultIn(key.slice(), key.hash()) == NULL && !makeRoom(mayResize) ) {
+		// Over the memory limit and nothing may be evicted
+		return false;
+	}
+	FlatTable<EntryRecord>::Slot *slot = hashTable.insert(key.slice(), key.hash(), inserted, mayResize);
+	if ( inserted ) {
+		// The slot still points at the caller's key, move it into the arena
+		slot->key = arena.copy(key.data(), key.size());
+		addKey(slot->key, key.hash());
+		storeEntry(slot->value, entry);
+		touch(slot->value);
+		logRecord(slot->key, slot->value);
+		return true;
+	}
+	if ( slot->value.isTombstone() ) {
+		// Only a write at least as new as the delete brings the key back
+		if ( entry.version >= slot->value.version ) {
+			storeEntry(slot->value, entry);
+			touch(slot->value);
+			logRecord(slot->key, slot->value);
+			return true;
+		}
+		return false;
+	}
+	if ( entry.version > slot->value.version ) {
+		storeEntry(slot->value, entry);
+		touch(slot->value);
+		logRecord(slot->key, slot->value);
+		return true;
+	}
+	return entry.version == slot->value.version;
 }
 
 /**
@@ -33,13 +132,14 @@ bool HashTable::create(string key, string value) {
  * string value if found
  * else it returns a NULL
  */
-string HashTable::read(string key) {
-	map<string, string>::iterator search;
+string HashTable::read(const Key &key) {
+	EntryRecord search;
 
-	search = hashTable.find(key);
-	if ( search != hashTable.end() ) {
+	if ( findRecord(key.slice(), key.hash(), search) && !search.isTombstone() ) {
 		// Value found
-		return search->second;
+		string value;
+		unpackValue(search, value);
+		return value;
 	}
 	else {
 		// Value not found
@@ -47,51 +147,140 @@ string HashTable::read(string key) {
 	}
 }
 
+/**
+ * FUNCTION NAME: readEntry
+ *
+ * DESCRIPTION: This function searches for the key and fills in its entry.
+ * 				Tombstones are only returned when withTombstones is set.
+ *
+ * RETURNS:
+ * true if found
+ * false otherwise
+ */
+bool HashTable::readEntry(const Key &key, Entry &entry, bool withTombstones) {
+	EntryRecord search;
+
+	if ( !findRecord(key.slice(), key.hash(), search) || (search.isTombstone() && !withTombstones) ) {
+		return false;
+	}
+	unpackEntry(search, entry);
+	return true;
+}
+
 /**
  * FUNCTION NAME: update
  *
  * DESCRIPTION: This function updates the given key with the updated value passed in
- * 				if the key is found
+ * 				if the key is found. The version of the entry is left as it is.
  *
  * RETURNS:
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::update(string key, string newValue) {
-	map<string, string>::iterator update;
+bool HashTable::update(const Key &key, const string &newValue) {
+	EntryRecord *update = faultIn(key.slice(), key.hash());
 
-	if (read(key).empty()) {
+	if ( update == NULL || update->isTombstone() ) {
 		// Key not found
 		return false;
 	}
 	// Key found
-	//update = hashTable.at(key) = newValue;
-	hashTable.at(key) = newValue;
+	string scratch;
+	Slice stored = packValue(newValue, scratch, update->flags);
+	update->value = replaceBytes(update->value, stored.data, stored.size);
+	touch(*update);
+	logRecord(key.slice(), *update);
 	// Update successful
 	return true;
 }
 
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: This function updates the given key with the entry passed in if the key
+ * 				is found and the stored version is not newer than the entry
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool HashTable::update(const Key &key, const Entry &entry) {
+	EntryRecord *update = faultIn(key.slice(), key.hash());
+
+	if ( update == NULL || update->isTombstone() || update->version > entry.version ) {
+		// Key not found or a newer write already landed
+		return false;
+	}
+	storeEntry(*update, entry);
+	touch(*update);
+	logRecord(key.slice(), *update);
+	return true;
+}
+
 /**
  * FUNCTION NAME: deleteKey
  *
- * DESCRIPTION: This function deletes the given key and the corresponding value if the key is found
+ * DESCRIPTION: This function deletes the given key and the corresponding value if the key is found.
+ * 				The tombstone is stamped with the time of the last compaction pass.
  *
  * RETURNS:
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::deleteKey(string key) {
-	uint eraseCount = 0;
+bool HashTable::deleteKey(const Key &key) {
+	return deleteKey(key, 0, lastTime);
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: This function replaces the value of the key with a tombstone of the given
+ * 				version. A versioned delete of a key that is not here still leaves a
+ * 				tombstone, so a late create older than the delete is rejected.
+ *
+ * RETURNS:
+ * true if a live key was deleted
+ * false if the key was not found or a newer write is stored
+ */
+bool HashTable::deleteKey(const Key &key, uint64_t version, int time) {
+	EntryRecord *search = faultIn(key.slice(), key.hash());
 
-	if (read(key).empty()) {
+	if ( search == NULL ) {
+		if ( version > 0 ) {
+			bool inserted;
+			FlatTable<EntryRecord>::Slot *slot = hashTable.insert(key.slice(), key.hash(), inserted);
+			slot->key = arena.copy(key.data(), key.size());
+			addKey(slot->key, key.hash());
+			slot->value.version = version;
+			slot->value.flags = ENTRY_FLAG_TOMBSTONE;
+			slot->value.deleteTime = time;
+			numTombstones++;
+			logRecord(slot->key, slot->value);
+		}
 		// Key not found
 		return false;
 	}
-	eraseCount = hashTable.erase(key);
-	if ( eraseCount < 1 ) {
-		// Could not erase
+	if ( search->isTombstone() ) {
+		if ( version > search->version ) {
+			search->version = version;
+			search->deleteTime = time;
+			logRecord(key.slice(), *search);
+		}
+		// Key already deleted
+		return false;
+	}
+	if ( version > 0 && search->version > version ) {
+		// A newer write already landed
 		return false;
 	}
+	// Give the value bytes back to the arena and keep the key as a tombstone
+	retireValue(search->value);
+	search->value = Slice();
+	search->version = max(search->version, version);
+	search->flags = (search->flags | ENTRY_FLAG_TOMBSTONE) & ~ENTRY_FLAG_COMPRESSED;
+	search->deleteTime = time;
+	numTombstones++;
+	logRecord(key.slice(), *search);
 	// Delete was successful
 	return true;
 }
@@ -106,19 +295,28 @@ bool HashTable::deleteKey(string key) {
  * false otherwise
  */
 bool HashTable::isEmpty() {
-	return hashTable.empty();
+	return currentSize() == 0;
 }
 
 /**
  * FUNCTION NAME: currentSize
  *
- * DESCRIPTION: Returns the current size of the hash table
+ * DESCRIPTION: Returns the current size of the hash table, tombstones excluded
  *
  * RETURNS:
  * size of the table as unit
  */
 unsigned long HashTable::currentSize() {
-	return (unsigned  long)hashTable.size();
+	return (unsigned  long)hashTable.size() - numTombstones + pendingLive;
+}
+
+/**
+ * FUNCTION NAME: tombstoneCount
+ *
+ * DESCRIPTION: Returns the number of tombstones waiting for compaction
+ */
+unsigned long HashTable::tombstoneCount() {
+	return numTombstones + pendingTombstones;
 }
 
 /**
@@ -127,7 +325,14 @@ unsigned long HashTable::currentSize() {
  * DESCRIPTION: Clear all contents from the hash table
  */
 void HashTable::clear() {
-	hashTable.clear();
+	clearRecords();
+	numTombstones = 0;
+	compactCursor = 0;
+	closeSnapshot();
+	rebuildFilter();
+	if ( wal != NULL ) {
+		wal->appendClear();
+	}
 }
 
 /**
@@ -138,7 +343,953 @@ void HashTable::clear() {
  * RETURNS:
  * unsigned long count (Should be always 1)
  */
-unsigned long HashTable::count(string key) {
-	return (unsigned long) hashTable.count(key);
+unsigned long HashTable::count(const Key &key) {
+	EntryRecord search;
+	return (findRecord(key.slice(), key.hash(), search) && !search.isTombstone()) ? 1 : 0;
 }
 
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: Checks the filter of the table, without probing the table itself.
+ * 				A no is always right and is counted as a negative.
+ *
+ * RETURNS:
+ * false if the key is surely not in the table
+ * true if it may be
+ */
+bool HashTable::mayContain(const Key &key) {
+	if ( snapshot != NULL || filter.mayContain(key.hash()) ) {
+		return true;
+	}
+	filterNegatives.fetch_add(1, memory_order_relaxed);
+	return false;
+}
+
+/**
+ * FUNCTION NAME: liveVersion
+ *
+ * DESCRIPTION: Looks up the version of key in the slots, or in the snapshot
+ * 				during warm up, without reading the value or touching the key
+ *
+ * RETURNS:
+ * true if key is live, with its version in version
+ * false otherwise
+ */
+bool HashTable::liveVersion(const Key &key, uint64_t &version) {
+	EntryRecord record;
+	if ( snapshot == NULL && !filter.mayContain(key.hash()) ) {
+		return false;
+	}
+	const EntryRecord *search = hashTable.peek(key.slice(), key.hash());
+	if ( search == NULL ) {
+		if ( snapshot == NULL || !snapshot->find(key.slice(), record) ) {
+			return false;
+		}
+		search = &record;
+	}
+	if ( search->isTombstone() ) {
+		return false;
+	}
+	version = search->version;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: filterStats
+ *
+ * DESCRIPTION: Returns how the lookups of missing keys went
+ */
+BloomStats HashTable::filterStats() {
+	BloomStats stats;
+	stats.negatives = filterNegatives.load(memory_order_relaxed);
+	stats.falsePositives = filterFalsePositives.load(memory_order_relaxed);
+	return stats;
+}
+
+/**
+ * FUNCTION NAME: forEachRecord
+ *
+ * DESCRIPTION: Visits every record of the table, then the records of the
+ * 				snapshot that warm up has not loaded yet
+ */
+void HashTable::forEachRecord(RecordVisitFn visit, void *env) {
+	for ( size_t i = 0; i < hashTable.slotCount(); i++ ) {
+		if ( hashTable.isFull(i) ) {
+			visit(env, hashTable.slotAt(i).key, hashTable.slotAt(i).value);
+		}
+	}
+	if ( snapshot == NULL ) {
+		return;
+	}
+	for ( unsigned long i = warmCursor; i < snapshot->count(); i++ ) {
+		Slice key;
+		EntryRecord record;
+		if ( snapshot->recordAt(i, key, record) && !hashTable.count(key) ) {
+			visit(env, key, record);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: addKey
+ *
+ * DESCRIPTION: Adds a key just put in the table to the filter and to the ordered index
+ */
+void HashTable::addKey(const Slice &key, uint64_t hash) {
+	keyBytes += key.size;
+	addToFilter(key, hash);
+	if ( orderedIndex != NULL ) {
+		orderedIndex->insert(key);
+	}
+}
+
+/**
+ * FUNCTION NAME: dropKey
+ *
+ * DESCRIPTION: Takes a key about to leave the table out of the ordered index and
+ * 				gives its bytes back. The filter keeps it until its next rebuild.
+ */
+void HashTable::dropKey(const Slice &key) {
+	if ( orderedIndex != NULL ) {
+		orderedIndex->erase(key);
+	}
+	keyBytes -= key.size;
+	retire(key);
+}
+
+/**
+ * FUNCTION NAME: addToFilter
+ *
+ * DESCRIPTION: Adds a key just put in the table to the filter, and to the filter
+ * 				being rebuilt. Starts a rebuild if the table has outgrown the filter.
+ */
+void HashTable::addToFilter(const Slice &key, uint64_t hash) {
+	filter.add(hash);
+	if ( filterRebuilding ) {
+		nextFilter.add(hash);
+	}
+	else if ( hashTable.size() > filterCapacity ) {
+		startFilterRebuild();
+	}
+	stepFilterRebuild();
+}
+
+/**
+ * FUNCTION NAME: rebuildFilter
+ *
+ * DESCRIPTION: Sizes the filter for twice the keys in the table and adds them all
+ * 				at once. Only used on a table just emptied, others rebuild a few
+ * 				slots at a time.
+ */
+void HashTable::rebuildFilter() {
+	filterCapacity = max(hashTable.size() * 2, (unsigned long)HASHTABLE_MIN_FILTER_KEYS);
+	filterStale = 0;
+	filterRebuilding = false;
+	filter.reset(filterCapacity);
+	for ( size_t i = 0; i < hashTable.slotCount(); i++ ) {
+		if ( hashTable.isFull(i) ) {
+			filter.add(hashTable.slotAt(i).key);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: startFilterRebuild
+ *
+ * DESCRIPTION: Starts filling a filter sized for twice the keys in the table.
+ * 				The current filter answers lookups until every key is in the new one.
+ */
+void HashTable::startFilterRebuild() {
+	nextFilterCapacity = max(hashTable.size() * 2, (unsigned long)HASHTABLE_MIN_FILTER_KEYS);
+	nextFilter.reset(nextFilterCapacity);
+	filterRebuilding = true;
+	filterCursor = 0;
+	filterSlots = hashTable.slotCount();
+	// Keys dropped from here on may be in the new filter
+	filterStale = 0;
+}
+
+/**
+ * FUNCTION NAME: stepFilterRebuild
+ *
+ * DESCRIPTION: Adds the keys of the next HASHTABLE_FILTER_REBUILD_SLOTS slots to
+ * 				the filter being rebuilt, and puts it in place after the last slot.
+ * 				Slots move while the FlatTable resizes, so the rebuild waits for the
+ * 				resize to end and starts over if the slots have changed meanwhile.
+ */
+void HashTable::stepFilterRebuild() {
+	if ( !filterRebuilding || hashTable.isResizing() ) {
+		return;
+	}
+	if ( hashTable.slotCount() != filterSlots ) {
+		nextFilter.reset(nextFilterCapacity);
+		filterCursor = 0;
+		filterSlots = hashTable.slotCount();
+	}
+	for ( int i = 0; i < HASHTABLE_FILTER_REBUILD_SLOTS && filterCursor < filterSlots; i++, filterCursor++ ) {
+		if ( hashTable.isFull(filterCursor) ) {
+			nextFilter.add(hashTable.slotAt(filterCursor).key);
+		}
+	}
+	if ( filterCursor >= filterSlots ) {
+		filter.swap(nextFilter);
+		nextFilter.reset(0);
+		filterCapacity = nextFilterCapacity;
+		filterRebuilding = false;
+	}
+}
+
+/**
+ * FUNCTION NAME: memoryUsed
+ *
+ * DESCRIPTION: Bytes the memory limit is checked against: the arena chunks
+ * 				in use, the slot and control arrays and the filter
+ */
+unsigned long HashTable::memoryUsed() {
+	return arena.bytesInUse() + slotBytes(hashTable.slotCount()) + filter.data().size + nextFilter.data().size + indexBytes();
+}
+
+/**
+ * FUNCTION NAME: slotBytes
+ *
+ * DESCRIPTION: Returns the bytes of slots slots and their control bytes
+ */
+unsigned long HashTable::slotBytes(size_t slots) {
+	return slots * (sizeof(FlatTable<EntryRecord>::Slot) + 1);
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Returns the memory taken up by the table, from counts every
+ * 				write keeps up to date, without walking the slots
+ */
+MemoryUsage HashTable::memoryUsage() {
+	MemoryUsage usage;
+	usage.keyBytes = keyBytes;
+	usage.valueBytes = valueBytes;
+	usage.metadataBytes = slotBytes(hashTable.slotCount()) + filter.data().size + nextFilter.data().size + indexBytes();
+	usage.arenaBytes = arena.bytesReserved();
+	usage.limitBytes = memoryBudget == NULL ? memoryLimit : memoryBudget->limit;
+	usage.evictions = numEvictions;
+	return usage;
+}
+
+/**
+ * FUNCTION NAME: setMemoryLimit
+ *
+ * DESCRIPTION: Caps the table at bytes, 0 for no cap. Once over it, new keys
+ * 				evict the keys the named policy picks, LRU, CLOCK or LFU, or
+ * 				are rejected with NONE.
+ */
+void HashTable::setMemoryLimit(unsigned long bytes, const string &policy) {
+	setEvictionPolicy(policy);
+	memoryLimit = bytes;
+	memoryBudget = NULL;
+}
+
+/**
+ * FUNCTION NAME: setMemoryBudget
+ *
+ * DESCRIPTION: Caps the table at its own bytes plus what is left of a budget
+ * 				shared with other tables, NULL for no cap. Evicting from the
+ * 				others is up to the owner of the budget.
+ */
+void HashTable::setMemoryBudget(const MemoryBudget *budget, const string &policy) {
+	setEvictionPolicy(policy);
+	memoryLimit = 0;
+	memoryBudget = budget;
+}
+
+/**
+ * FUNCTION NAME: setEvictionPolicy
+ *
+ * DESCRIPTION: Replaces the eviction policy by the named one. The policy in
+ * 				place is kept when it has that name already, along with what
+ * 				it knows of the keys.
+ */
+void HashTable::setEvictionPolicy(const string &policy) {
+	if ( evictionPolicy != NULL && policy == policyName ) {
+		return;
+	}
+	delete evictionPolicy;
+	evictionPolicy = newEvictionPolicy(policy);
+	policyName = policy;
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the bytes counted against the memory limit
+ */
+unsigned long HashTable::memoryBytes() {
+	return memoryUsed();
+}
+
+/**
+ * FUNCTION NAME: growthBytes
+ *
+ * DESCRIPTION: Returns the bytes of the slots the next new key resizes the
+ * 				table to, 0 if it does not resize
+ */
+unsigned long HashTable::growthBytes() {
+	return slotBytes(hashTable.resizeSlots());
+}
+
+/**
+ * FUNCTION NAME: reclaim
+ *
+ * DESCRIPTION: Evicts up to count keys the policy picks, none during warm up
+ *
+ * RETURNS:
+ * number of keys evicted
+ */
+unsigned long HashTable::reclaim(unsigned long count) {
+	unsigned long evicted = 0;
+	if ( snapshot != NULL ) {
+		return 0;
+	}
+	while ( evicted < count && evictOne() ) {
+		evicted++;
+	}
+	if ( filterStale > filterCapacity / 2 && !filterRebuilding ) {
+		startFilterRebuild();
+	}
+	return evicted;
+}
+
+/**
+ * FUNCTION NAME: evictOne
+ *
+ * DESCRIPTION: Drops the live key the policy picks
+ *
+ * RETURNS:
+ * false if there is no policy or no live key
+ */
+bool HashTable::evictOne() {
+	long index = evictionPolicy == NULL ? -1 : evictionPolicy->victim(hashTable, lastTime);
+	if ( index < 0 ) {
+		return false;
+	}
+	const FlatTable<EntryRecord>::Slot &slot = hashTable.slotAt(index);
+	retireValue(slot.value.value);
+	dropKey(slot.key);
+	hashTable.eraseAt(index);
+	filterStale++;
+	numEvictions++;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: touch
+ *
+ * DESCRIPTION: Tells the eviction policy the record was used
+ */
+void HashTable::touch(EntryRecord &record) {
+	if ( evictionPolicy != NULL ) {
+		evictionPolicy->touch(record, lastTime);
+	}
+}
+
+/**
+ * FUNCTION NAME: makeRoom
+ *
+ * DESCRIPTION: Makes room for a new key under the memory limit. A resize of
+ * 				the slots that would take the table over the limit is refused,
+ * 				mayResize is cleared and a key is evicted instead, so the new
+ * 				key fits in the slots there are. Otherwise evicts up to
+ * 				HASHTABLE_EVICTION_BATCH live keys while the table is over the
+ * 				limit, and none once the slots and filters alone are over it,
+ * 				as evicting only frees key and value bytes. Evictions are not
+ * 				logged, a key replayed from the log is evicted again by later
+ * 				writes. Nothing is evicted during warm up, the snapshot would
+ * 				bring the key back.
+ *
+ * RETURNS:
+ * false if the new key does not fit and there is no key to evict
+ * true otherwise
+ */
+bool HashTable::makeRoom(bool &mayResize) {
+	mayResize = true;
+	if ( (memoryLimit == 0 && memoryBudget == NULL) || snapshot != NULL ) {
+		return true;
+	}
+	// The bytes of the table in a shared budget were counted before this write
+	unsigned long limit = memoryBudget == NULL ? memoryLimit : memoryUsed() + memoryBudget->left();
+	// The draining level counts against the limit until it is done, so a
+	// write that ends up turned away still moves the resize on
+	hashTable.stepResize();
+	size_t resizeSlots = hashTable.resizeSlots();
+	// The first slots are always let in, without them nothing is ever stored
+	if ( resizeSlots > 0 && hashTable.slotCount() > 0 && memoryUsed() + slotBytes(resizeSlots) > limit ) {
+		mayResize = false;
+	}
+	for ( int i = 0; i < HASHTABLE_EVICTION_BATCH; i++ ) {
+		bool needsSlot = !mayResize && !hashTable.hasRoom();
+		unsigned long used = memoryUsed();
+		if ( !needsSlot && (used <= limit || used - arena.bytesInUse() > limit) ) {
+			break;
+		}
+		if ( !evictOne() ) {
+			return false;
+		}
+	}
+	if ( filterStale > filterCapacity / 2 && !filterRebuilding ) {
+		startFilterRebuild();
+	}
+	return mayResize || hashTable.hasRoom();
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: Incremental compaction pass. Looks at no more than budget slots,
+ * 				starting where the previous pass stopped, and drops tombstones
+ * 				deleted at least gracePeriod time units ago.
+ *
+ * RETURNS:
+ * number of tombstones dropped
+ */
+unsigned long HashTable::compact(int time, int gracePeriod, unsigned long budget) {
+	unsigned long dropped = 0;
+	size_t slots = hashTable.slotCount();
+
+	lastTime = time;
+	// Dropping a tombstone before warm up is over would let the
+	// older record of the snapshot come back in its place
+	if ( numTombstones == 0 || slots == 0 || snapshot != NULL ) {
+		return 0;
+	}
+	for ( unsigned long i = 0; i < budget && i < slots; i++ ) {
+		if ( compactCursor >= slots ) {
+			compactCursor = 0;
+		}
+		size_t index = compactCursor++;
+		if ( !hashTable.isFull(index) ) {
+			continue;
+		}
+		const FlatTable<EntryRecord>::Slot &slot = hashTable.slotAt(index);
+		if ( slot.value.isTombstone() && slot.value.deleteTime + gracePeriod <= time ) {
+			dropKey(slot.key);
+			hashTable.eraseAt(index);
+			numTombstones--;
+			dropped++;
+		}
+	}
+	// Dropped keys still set bits in the filter, too many of them make it useless
+	filterStale += dropped;
+	if ( filterStale > filterCapacity / 2 && !filterRebuilding ) {
+		startFilterRebuild();
+	}
+	stepFilterRebuild();
+	return dropped;
+}
+
+/**
+ * FUNCTION NAME: restoreRecord
+ *
+ * DESCRIPTION: Puts the record in the table as it is, without any version check.
+ * 				Records come from the log in the order they were written.
+ */
+void HashTable::restoreRecord(const Slice &key, const EntryRecord &record) {
+	bool inserted;
+	uint64_t hash = hashBytes(key);
+	faultIn(key, hash);
+	FlatTable<EntryRecord>::Slot *slot = hashTable.insert(key, hash, inserted);
+	if ( inserted ) {
+		slot->key = arena.copy(key);
+		addKey(slot->key, hash);
+	}
+	else if ( slot->value.isTombstone() ) {
+		numTombstones--;
+	}
+	slot->value.value = replaceBytes(slot->value.value, record.value.data, record.value.size);
+	slot->value.version = record.version;
+	slot->value.replica = record.replica;
+	slot->value.flags = record.flags;
+	slot->value.deleteTime = record.deleteTime;
+	if ( record.isTombstone() ) {
+		numTombstones++;
+	}
+}
+
+/**
+ * FUNCTION NAME: replayRecord
+ *
+ * DESCRIPTION: Log replay callback
+ */
+void HashTable::replayRecord(void *env, WalOp op, const Slice &key, const EntryRecord &record) {
+	HashTable *table = (HashTable *)env;
+	if ( op == WAL_CLEAR ) {
+		table->clearRecords();
+		table->numTombstones = 0;
+		table->compactCursor = 0;
+		table->closeSnapshot();
+		table->rebuildFilter();
+	}
+	else {
+		table->restoreRecord(key, record);
+	}
+}
+
+/**
+ * FUNCTION NAME: openLog
+ *
+ * DESCRIPTION: Opens the write ahead log at path, rebuilds the table from the records
+ * 				already in it, then logs every further mutation there
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool HashTable::openLog(const string &path, int syncIntervalMs) {
+	WriteAheadLog *log = new WriteAheadLog();
+	if ( !log->open(path, syncIntervalMs) ) {
+		delete log;
+		return false;
+	}
+	delete wal;
+	wal = NULL;
+	log->replay(replayRecord, this);
+	wal = log;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: syncLog
+ *
+ * DESCRIPTION: Makes every mutation logged so far durable, one sync for all of them
+ */
+bool HashTable::syncLog() {
+	return wal != NULL && wal->sync();
+}
+
+/**
+ * FUNCTION NAME: findRecord
+ *
+ * DESCRIPTION: Looks the key up in the table, then in the snapshot being warmed up.
+ * 				The value of a record found in the snapshot points into the mapping.
+ *
+ * RETURNS:
+ * true if found, tombstones included
+ * false otherwise
+ */
+bool HashTable::findRecord(const Slice &key, uint64_t hash, EntryRecord &record) {
+	// Keys still in the snapshot are not in the filter
+	if ( snapshot == NULL && !filter.mayContain(hash) ) {
+		filterNegatives.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+	const EntryRecord *search = hashTable.peek(key, hash);
+	if ( search != NULL ) {
+		// Field by field, leaving out accessInfo, which other readers may be stamping
+		record.value = search->value;
+		record.version = search->version;
+		record.replica = search->replica;
+		record.flags = search->flags;
+		record.deleteTime = search->deleteTime;
+		if ( evictionPolicy != NULL ) {
+			// Readers share the stripe lock, so the access is stamped in place
+			// through the peeked slot. A writable slot could copy a page a view
+			// shares. Policies only write accessInfo, and only atomically.
+			touch(const_cast<EntryRecord &>(*search));
+		}
+		return true;
+	}
+	if ( snapshot == NULL ) {
+		filterFalsePositives.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+	return snapshot->find(key, record);
+}
+
+/**
+ * FUNCTION NAME: loadRecord
+ *
+ * DESCRIPTION: Copies a record of the snapshot into the table. The key must not be
+ * 				in the table yet.
+ *
+ * RETURNS:
+ * pointer to the record in the table
+ */
+EntryRecord *HashTable::loadRecord(const Slice &key, uint64_t hash, const EntryRecord &record) {
+	bool inserted;
+	FlatTable<EntryRecord>::Slot *slot = hashTable.insert(key, hash, inserted);
+	slot->key = arena.copy(key);
+	addKey(slot->key, hash);
+	slot->value = record;
+	slot->value.value = arena.copy(record.value);
+	valueBytes += record.value.size;
+	if ( record.isTombstone() ) {
+		numTombstones++;
+		if ( pendingTombstones > 0 ) {
+			pendingTombstones--;
+		}
+	}
+	else if ( pendingLive > 0 ) {
+		pendingLive--;
+	}
+	return &slot->value;
+}
+
+/**
+ * FUNCTION NAME: faultIn
+ *
+ * DESCRIPTION: Finds the record of key in the table, loading it from the snapshot
+ * 				first if warm up has not reached it yet
+ *
+ * RETURNS:
+ * pointer to the record in the table, NULL if the key is in neither
+ */
+EntryRecord *HashTable::faultIn(const Slice &key, uint64_t hash) {
+	EntryRecord *search = hashTable.find(key, hash);
+	EntryRecord record;
+
+	if ( search != NULL || snapshot == NULL || !snapshot->find(key, record) ) {
+		return search;
+	}
+	return loadRecord(key, hash, record);
+}
+
+/**
+ * FUNCTION NAME: closeSnapshot
+ *
+ * DESCRIPTION: Unmaps the snapshot being warmed up, if any
+ */
+void HashTable::closeSnapshot() {
+	delete snapshot;
+	snapshot = NULL;
+	warmCursor = 0;
+	pendingLive = 0;
+	pendingTombstones = 0;
+}
+
+/**
+ * FUNCTION NAME: dumpSnapshot
+ *
+ * DESCRIPTION: Writes every record, tombstones included, to a snapshot at path.
+ * 				The log is emptied once the snapshot is in place, as the snapshot
+ * 				now holds everything it did.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool HashTable::dumpSnapshot(const string &path) {
+	vector<SnapshotItem> items;
+
+	// The old snapshot may be the file about to be replaced
+	warmSnapshot((unsigned long)-1);
+	items.reserve(hashTable.size());
+	for ( size_t i = 0; i < hashTable.slotCount(); i++ ) {
+		if ( hashTable.isFull(i) ) {
+			const FlatTable<EntryRecord>::Slot &slot = hashTable.slotAt(i);
+			SnapshotItem item = {slot.key, &slot.value};
+			items.push_back(item);
+		}
+	}
+	if ( !SnapshotFile::write(path, items) ) {
+		return false;
+	}
+	if ( wal != NULL ) {
+		wal->truncate();
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: openSnapshot
+ *
+ * DESCRIPTION: Empties the table and maps the snapshot at path in its place.
+ * 				Nothing is loaded yet, reads are served from the mapping until
+ * 				warmSnapshot() gets to them. Meant to be called before openLog,
+ * 				whose records are newer than the snapshot.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if there is no valid snapshot at path
+ */
+bool HashTable::openSnapshot(const string &path) {
+	SnapshotFile *file = new SnapshotFile();
+	if ( !file->open(path) ) {
+		delete file;
+		return false;
+	}
+	clearRecords();
+	numTombstones = 0;
+	compactCursor = 0;
+	closeSnapshot();
+	rebuildFilter();
+	snapshot = file;
+	pendingLive = file->liveCount();
+	pendingTombstones = file->count() - file->liveCount();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: warmSnapshot
+ *
+ * DESCRIPTION: Loads up to budget more records of the snapshot into the table,
+ * 				skipping keys a write already loaded. The snapshot is unmapped
+ * 				after its last record.
+ *
+ * RETURNS:
+ * number of records loaded
+ */
+unsigned long HashTable::warmSnapshot(unsigned long budget) {
+	unsigned long loaded = 0;
+
+	if ( snapshot == NULL ) {
+		return 0;
+	}
+	for ( unsigned long i = 0; i < budget && warmCursor < snapshot->count(); i++ ) {
+		Slice key;
+		EntryRecord record;
+		if ( snapshot->recordAt(warmCursor++, key, record) && !hashTable.count(key) ) {
+			loadRecord(key, hashBytes(key), record);
+			loaded++;
+		}
+	}
+	if ( warmCursor >= snapshot->count() ) {
+		closeSnapshot();
+	}
+	return loaded;
+}
+
+/**
+ * FUNCTION NAME: isWarming
+ *
+ * DESCRIPTION: Returns if part of the table is still served from a snapshot
+ */
+bool HashTable::isWarming() {
+	return snapshot != NULL;
+}
+
+/**
+ * FUNCTION NAME: openView
+ *
+ * DESCRIPTION: Takes a point in time view of every record of the table. The
+ * 				view shares the slot pages of the table, writes copy a page
+ * 				before changing it, and the arena chunks the view points at
+ * 				are kept until it is closed. The snapshot being warmed up is
+ * 				loaded first, as a view does not follow it. Views are opened
+ * 				and closed under the lock of the table, and may be read from
+ * 				while others write the table.
+ *
+ * RETURNS:
+ * the view, to be passed to closeView() before the table is destroyed
+ */
+TableView *HashTable::openView() {
+	warmSnapshot((unsigned long)-1);
+	openViews[++viewEpoch]++;
+	return new TableView(hashTable, viewEpoch);
+}
+
+/**
+ * FUNCTION NAME: closeView
+ *
+ * DESCRIPTION: Drops a view and frees the arena chunks no open view points at anymore
+ */
+void HashTable::closeView(TableView *view) {
+	map<uint64_t, int>::iterator open = openViews.find(view->epoch);
+	if ( --open->second == 0 ) {
+		openViews.erase(open);
+	}
+	delete view;
+	// A chunk retired in epoch e is only seen by views of epoch e and older
+	size_t freed = 0;
+	while ( freed < retired.size() && (openViews.empty() || retired[freed].first < openViews.begin()->first) ) {
+		arena.release(retired[freed].second);
+		freed++;
+	}
+	retired.erase(retired.begin(), retired.begin() + freed);
+}
+
+/**
+ * FUNCTION NAME: retire
+ *
+ * DESCRIPTION: Gives a chunk back to the arena, or keeps it until the open views are closed
+ */
+void HashTable::retire(const Slice &chunk) {
+	if ( openViews.empty() ) {
+		arena.release(chunk);
+	}
+	else if ( chunk.size > 0 ) {
+		retired.push_back(make_pair(viewEpoch, chunk));
+	}
+}
+
+/**
+ * FUNCTION NAME: retireValue
+ *
+ * DESCRIPTION: Retires the bytes of a value leaving the table
+ */
+void HashTable::retireValue(const Slice &value) {
+	valueBytes -= value.size;
+	retire(value);
+}
+
+/**
+ * FUNCTION NAME: replaceBytes
+ *
+ * DESCRIPTION: Same as Arena::replace, but never writes over a chunk an open view
+ * 				may read. Only values are replaced, their bytes are counted here.
+ */
+Slice HashTable::replaceBytes(const Slice &old, const char *data, size_t size) {
+	valueBytes = valueBytes - old.size + size;
+	if ( openViews.empty() ) {
+		return arena.replace(old, data, size);
+	}
+	Slice copy = arena.copy(data, size);
+	retire(old);
+	return copy;
+}
+
+/**
+ * FUNCTION NAME: clearRecords
+ *
+ * DESCRIPTION: Empties the slots and the arena, retiring chunks one by one while views are open
+ */
+void HashTable::clearRecords() {
+	keyBytes = 0;
+	valueBytes = 0;
+	if ( orderedIndex != NULL ) {
+		orderedIndex->clear();
+	}
+	if ( !openViews.empty() ) {
+		for ( size_t i = 0; i < hashTable.slotCount(); i++ ) {
+			if ( hashTable.isFull(i) ) {
+				retire(hashTable.slotAt(i).key);
+				retire(hashTable.slotAt(i).value.value);
+			}
+		}
+		hashTable.clear();
+		return;
+	}
+	hashTable.clear();
+	arena.clear();
+	retired.clear();
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Looks the key up in the view
+ *
+ * RETURNS:
+ * true if found, tombstones included
+ * false otherwise
+ */
+bool TableView::find(const Key &key, EntryRecord &record) const {
+	const EntryRecord *search = records.peek(key.slice(), key.hash());
+	if ( search == NULL ) {
+		return false;
+	}
+	record = *search;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Returns the number of records in the view, tombstones included
+ */
+unsigned long TableView::size() const {
+	return records.size();
+}
+
+/**
+ * FUNCTION NAME: forEachRecord
+ *
+ * DESCRIPTION: Visits every record of the view. The visitor may write to the table.
+ */
+void TableView::forEachRecord(RecordVisitFn visit, void *env) const {
+	for ( size_t i = 0; i < records.slotCount(); i++ ) {
+		if ( records.isFull(i) ) {
+			visit(env, records.slotAt(i).key, records.slotAt(i).value);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: setOrderedIndex
+ *
+ * DESCRIPTION: Keeps a BTreeIndex of the keys next to the table, or drops it.
+ * 				Every key in the table is added when it is turned on.
+ */
+void HashTable::setOrderedIndex(bool enabled) {
+	if ( !enabled ) {
+		delete orderedIndex;
+		orderedIndex = NULL;
+		return;
+	}
+	if ( orderedIndex != NULL ) {
+		return;
+	}
+	orderedIndex = new BTreeIndex();
+	for ( size_t i = 0; i < hashTable.slotCount(); i++ ) {
+		if ( hashTable.isFull(i) ) {
+			orderedIndex->insert(hashTable.slotAt(i).key);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: indexBytes
+ *
+ * DESCRIPTION: Returns the bytes taken up by the ordered index, 0 without one
+ */
+unsigned long HashTable::indexBytes() {
+	return orderedIndex == NULL ? 0 : orderedIndex->memoryBytes();
+}
+
+/**
+ * FUNCTION NAME: scan
+ *
+ * DESCRIPTION: Appends the live keys from startKey up to, not including, endKey,
+ * 				at most limit of them, in key order. The ordered index is walked
+ * 				from startKey on, without it every slot is looked at and the keys
+ * 				in range are sorted. Keys still in the snapshot are loaded first.
+ */
+void HashTable::scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries) {
+	warmSnapshot((unsigned long)-1);
+	if ( orderedIndex == NULL ) {
+		scanSlots(startKey, endKey, limit, entries);
+		return;
+	}
+	unsigned long found = 0;
+	for ( BTreeIndex::Iterator it = orderedIndex->seek(startKey); it.valid() && found < limit; it.next() ) {
+		if ( endKey.size > 0 && it.key().compare(endKey) >= 0 ) {
+			break;
+		}
+		const EntryRecord *record = hashTable.peek(it.key(), hashBytes(it.key()));
+		if ( record->isTombstone() ) {
+			continue;
+		}
+		entries.push_back(make_pair(Key(it.key()), Entry()));
+		unpackEntry(*record, entries.back().second);
+		found++;
+	}
+}
+
+/**
+ * FUNCTION NAME: scanSlots
+ *
+ * DESCRIPTION: scan() of a table without an ordered index
+ */
+void HashTable::scanSlots(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries) {
+	size_t from = entries.size();
+	for ( size_t i = 0; i < hashTable.slotCount(); i++ ) {
+		if ( !hashTable.isFull(i) ) {
+			continue;
+		}
+		const FlatTable<EntryRecord>::Slot &slot = hashTable.slotAt(i);
+		if ( slot.value.isTombstone() || slot.key.compare(startKey) < 0 || (endKey.size > 0 && slot.key.compare(endKey) >= 0) ) {
+			continue;
+		}
+		entries.push_back(make_pair(Key(slot.key), Entry()));
+		unpackEntry(slot.value, entries.back().second);
+	}
+	mergeScanEntries(entries, from, limit);
+}
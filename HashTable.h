@@ -12,28 +12,207 @@
  */
 #include "stdincludes.h"
 #include "common.h"
+#include "StorageEngine.h"
 #include "Entry.h"
+#include "FlatTable.h"
+#include "Arena.h"
+#include "WriteAheadLog.h"
+#include "SnapshotFile.h"
+#include "BloomFilter.h"
+#include "Eviction.h"
+#include "BTreeIndex.h"
+#include <atomic>
+
+/*
+ * Macros
+ */
+// smallest number of keys the filter of a table is sized for
+#define HASHTABLE_MIN_FILTER_KEYS 1024
+// most keys one write may evict to get under the memory limit
+#define HASHTABLE_EVICTION_BATCH 16
+// slots a write adds to the filter being rebuilt
+#define HASHTABLE_FILTER_REBUILD_SLOTS 64
+
+/**
+ * CLASS NAME: TableView
+ *
+ * DESCRIPTION: Point in time view of the records of a HashTable, opened by
+ * 				HashTable::openView(). It sees none of the writes made to the
+ * 				table after it was opened, so a long scan, transfer or backup
+ * 				reads a stable set of records without holding writers back.
+ * 				Values are as stored, compressed when ENTRY_FLAG_COMPRESSED is set.
+ */
+class TableView {
+public:
+	bool find(const Key &key, EntryRecord &record) const;
+	unsigned long size() const;
+	void forEachRecord(RecordVisitFn visit, void *env) const;
+private:
+	friend class HashTable;
+	FlatTable<EntryRecord> records;
+	uint64_t epoch;
+	TableView(const FlatTable<EntryRecord> &records, uint64_t epoch): records(records), epoch(epoch) {}
+	TableView(const TableView &anotherView);
+	TableView& operator =(const TableView &anotherView);
+};
 
 /**
  * CLASS NAME: HashTable
  *
- * DESCRIPTION: This class is a wrapper to the map provided by C++ STL.
+ * DESCRIPTION: This class is a wrapper to the open addressing FlatTable.
+ * 				Lookups probe groups of control bytes instead of walking a tree.
+ * 				Every key maps to a typed EntryRecord, key and value bytes
+ * 				live in the Arena of the table.
+ * 				Deletes leave a versioned tombstone behind so a late write
+ * 				older than the delete cannot bring the key back. compact()
+ * 				drops tombstones past their grace period a few slots at a time.
+ * 				With a log opened, the state every mutation leaves a key in is
+ * 				appended to the WriteAheadLog and replayed on the next open.
+ * 				dumpSnapshot() writes every record to a sorted SnapshotFile and
+ * 				empties the log. openSnapshot() maps such a file and serves the
+ * 				keys not loaded yet straight from it, warmSnapshot() moves them
+ * 				into the table a few at a time. A key is loaded ahead of the
+ * 				warm up when a write touches it, so versions keep comparing
+ * 				against the stored record.
+ * 				A BloomFilter over every key in the table answers lookups of
+ * 				missing keys without probing. It is rebuilt at twice the size
+ * 				when the table outgrows it, or once compaction has left too
+ * 				many dropped keys behind in it. Like the FlatTable resize, the
+ * 				rebuild is spread over the writes that follow, the old filter
+ * 				answers lookups until the new one has every key.
+ * 				With a memory limit set, a new key that does not fit first
+ * 				makes the EvictionPolicy of the table drop live keys, or is
+ * 				rejected when there is no policy. The slots only grow while
+ * 				the grown table fits under the limit, past that point new
+ * 				keys take the slots of evicted ones. setMemoryBudget() caps
+ * 				the table at what a budget shared with other tables has left.
+ * 				setOrderedIndex() keeps a BTreeIndex of the keys next to the
+ * 				slots, updated with every key added or dropped, so scan()
+ * 				walks keys in order instead of sorting the whole table.
+ * 				openView() takes a TableView of the table at a point in time.
+ * 				It shares the copy on write slot pages of the FlatTable, and
+ * 				arena chunks the table stops using while views are open are
+ * 				retired with the epoch of the newest view instead of freed,
+ * 				then freed once every view that may see them is closed.
  *
  */
-class HashTable {
+class HashTable : public StorageEngine {
 public:
-	map<string, string> hashTable;
+	FlatTable<EntryRecord> hashTable;
+	Arena arena;
 //public:
 	HashTable();
-	bool create(string key, string value);
-	string read(string key);
-	bool update(string key, string newValue);
-	bool deleteKey(string key);
+	bool create(const Key &key, const string &value);
+	bool create(const Key &key, const Entry &entry);
+	string read(const Key &key);
+	bool readEntry(const Key &key, Entry &entry, bool withTombstones = false);
+	bool update(const Key &key, const string &newValue);
+	bool update(const Key &key, const Entry &entry);
+	bool deleteKey(const Key &key);
+	bool deleteKey(const Key &key, uint64_t version, int time);
 	bool isEmpty();
 	unsigned long currentSize();
+	unsigned long tombstoneCount();
 	void clear();
-	unsigned long count(string key);
+	unsigned long count(const Key &key);
+	bool mayContain(const Key &key);
+	bool liveVersion(const Key &key, uint64_t &version);
+	BloomStats filterStats();
+	void forEachRecord(RecordVisitFn visit, void *env);
+	void scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries);
+	void setOrderedIndex(bool enabled);
+	MemoryUsage memoryUsage();
+	void setMemoryLimit(unsigned long bytes, const string &policy);
+	void setMemoryBudget(const MemoryBudget *budget, const string &policy);
+	unsigned long memoryBytes();
+	unsigned long growthBytes();
+	unsigned long reclaim(unsigned long count);
+	unsigned long compact(int time, int gracePeriod, unsigned long budget);
+	bool openLog(const string &path, int syncIntervalMs);
+	bool syncLog();
+	bool dumpSnapshot(const string &path);
+	bool openSnapshot(const string &path);
+	unsigned long warmSnapshot(unsigned long budget);
+	bool isWarming();
+	TableView *openView();
+	void closeView(TableView *view);
 	virtual ~HashTable();
+private:
+	// number of records that are tombstones
+	unsigned long numTombstones;
+	// bytes of the keys and values in the slots, kept up to date by every write
+	unsigned long keyBytes;
+	unsigned long valueBytes;
+	// time of the last compaction pass, used by deletes that carry no time
+	int lastTime;
+	// slot the next compaction pass starts at
+	size_t compactCursor;
+	// log of mutations, NULL when the table is not persistent
+	WriteAheadLog *wal;
+	// snapshot being warmed up, NULL once every record is loaded
+	SnapshotFile *snapshot;
+	// index of the next snapshot record to load
+	unsigned long warmCursor;
+	// snapshot records, live and tombstones, not loaded into the table yet
+	unsigned long pendingLive;
+	unsigned long pendingTombstones;
+	BloomFilter filter;
+	// keys the filter was sized for, and keys dropped since it was built
+	unsigned long filterCapacity;
+	unsigned long filterStale;
+	// filter being rebuilt over the writes that follow, the next slot to add
+	// and the slot count it started with
+	BloomFilter nextFilter;
+	bool filterRebuilding;
+	size_t filterCursor;
+	size_t filterSlots;
+	unsigned long nextFilterCapacity;
+	// counted by readers, which may run in parallel in a ShardedHashTable
+	atomic<unsigned long> filterNegatives;
+	atomic<unsigned long> filterFalsePositives;
+	// bytes the table may take up, 0 for no limit
+	unsigned long memoryLimit;
+	// budget shared with other tables in place of memoryLimit, NULL for none
+	const MemoryBudget *memoryBudget;
+	// picks the keys to evict, NULL to reject new keys instead
+	EvictionPolicy *evictionPolicy;
+	string policyName;
+	unsigned long numEvictions;
+	// epoch of the newest view, open views counted by epoch
+	uint64_t viewEpoch;
+	map<uint64_t, int> openViews;
+	// arena chunks dropped while views were open, with the epoch they were dropped in
+	vector<pair<uint64_t, Slice> > retired;
+	// keys of the table in order, NULL unless turned on by setOrderedIndex
+	BTreeIndex *orderedIndex;
+	HashTable(const HashTable &anotherHashTable);
+	HashTable& operator =(const HashTable &anotherHashTable);
+	void storeEntry(EntryRecord &record, const Entry &entry);
+	void logRecord(const Slice &key, const EntryRecord &record);
+	void restoreRecord(const Slice &key, const EntryRecord &record);
+	EntryRecord *loadRecord(const Slice &key, uint64_t hash, const EntryRecord &record);
+	EntryRecord *faultIn(const Slice &key, uint64_t hash);
+	bool findRecord(const Slice &key, uint64_t hash, EntryRecord &record);
+	void closeSnapshot();
+	void addKey(const Slice &key, uint64_t hash);
+	void dropKey(const Slice &key);
+	void addToFilter(const Slice &key, uint64_t hash);
+	void rebuildFilter();
+	void startFilterRebuild();
+	void stepFilterRebuild();
+	unsigned long memoryUsed();
+	static unsigned long slotBytes(size_t slots);
+	unsigned long indexBytes();
+	void scanSlots(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries);
+	bool makeRoom(bool &mayResize);
+	bool evictOne();
+	void setEvictionPolicy(const string &policy);
+	void touch(EntryRecord &record);
+	void retire(const Slice &chunk);
+	void retireValue(const Slice &value);
+	Slice replaceBytes(const Slice &old, const char *data, size_t size);
+	void clearRecords();
+	static void replayRecord(void *env, WalOp op, const Slice &key, const EntryRecord &record);
 };
 
 #endif /* HASHTABLE_H_ */
@@ -0,0 +1,76 @@
+/**********************************
+ * FILE NAME: HashTableBench.cpp
+ *
+ * DESCRIPTION: Latency benchmark of HashTable creates across the growth
+ * 				boundaries of the table, built and run by "make bench"
+ **********************************/
+
+#include "HashTable.h"
+#include <chrono>
+
+/*
+ * Macros
+ */
+#define BENCH_DEFAULT_CREATES 4000000
+// creates after the slot count changes that count as near a growth boundary
+#define BENCH_BOUNDARY_WINDOW 4096
+#define BENCH_VALUE_SIZE 32
+
+/**
+ * FUNCTION NAME: printPercentiles
+ *
+ * DESCRIPTION: Prints the p50, p99, p99.9 and largest of the latencies, in microseconds
+ */
+static void printPercentiles(const char *label, vector<double> &latencies) {
+	if ( latencies.empty() ) {
+		printf("%-22s no creates\n", label);
+		return;
+	}
+	sort(latencies.begin(), latencies.end());
+	size_t n = latencies.size();
+	printf("%-22s creates=%zu p50=%.2f p99=%.2f p99.9=%.2f max=%.1f us\n", label, n,
+			latencies[n / 2], latencies[n * 99 / 100], latencies[n * 999 / 1000], latencies[n - 1]);
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: Times every create of new keys into one HashTable, the number of
+ * 				creates given as the only argument. A create within
+ * 				BENCH_BOUNDARY_WINDOW creates of a change of the slot count,
+ * 				when a resize starts or its draining level is done, is near a
+ * 				growth boundary. With an incremental resize its percentiles
+ * 				stay close to those of all creates.
+ */
+int main(int argc, char *argv[]) {
+	long creates = argc > 1 ? atol(argv[1]) : BENCH_DEFAULT_CREATES;
+	HashTable table;
+	string value(BENCH_VALUE_SIZE, 'v');
+	vector<double> all;
+	vector<double> nearGrowth;
+	size_t slots = table.hashTable.slotCount();
+	long lastGrowth = -BENCH_BOUNDARY_WINDOW;
+	unsigned long growthSteps = 0;
+
+	all.reserve(creates);
+	for ( long i = 0; i < creates; i++ ) {
+		Key key("bench" + to_string(i));
+		Entry entry(value, 1, PRIMARY);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		table.create(key, entry);
+		double latency = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+		all.push_back(latency);
+		if ( table.hashTable.slotCount() != slots ) {
+			slots = table.hashTable.slotCount();
+			lastGrowth = i;
+			growthSteps++;
+		}
+		if ( i - lastGrowth < BENCH_BOUNDARY_WINDOW ) {
+			nearGrowth.push_back(latency);
+		}
+	}
+	printf("keys=%lu slots=%zu growth steps=%lu\n", table.currentSize(), slots, growthSteps);
+	printPercentiles("all creates", all);
+	printPercentiles("near growth boundary", nearGrowth);
+	return 0;
+}
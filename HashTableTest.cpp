@@ -0,0 +1,111 @@
+/**********************************
+ * FILE NAME: HashTableTest.cpp
+ *
+ * DESCRIPTION: Checks of HashTable under a memory limit, built and run by
+ * 				"make check"
+ **********************************/
+
+#include "HashTable.h"
+
+/*
+ * Macros
+ */
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define TEST_VALUE_SIZE 32
+
+static int failures = 0;
+
+/**
+ * FUNCTION NAME: check
+ *
+ * DESCRIPTION: Reports a condition that does not hold
+ */
+static void check(bool condition, const char *text, const char *file, int line) {
+	if ( !condition ) {
+		printf("%s:%d: check failed: %s\n", file, line, text);
+		failures++;
+	}
+}
+
+/**
+ * FUNCTION NAME: testCappedTableKeepsAcceptingWrites
+ *
+ * DESCRIPTION: Fills a table capped at 100 KB with many times that much. The
+ * 				slots stop growing before they alone take up the limit, so the
+ * 				table keeps about the limit in use, most of it live keys, and
+ * 				every create is taken in by evicting an older key.
+ */
+static void testCappedTableKeepsAcceptingWrites() {
+	const unsigned long limit = 100 * 1024;
+	HashTable table;
+	string value(TEST_VALUE_SIZE, 'v');
+	unsigned long rejected = 0;
+
+	table.setMemoryLimit(limit, "LRU");
+	for ( int i = 0; i < 50000; i++ ) {
+		if ( !table.create(Key("key" + to_string(i)), Entry(value, 1, PRIMARY)) ) {
+			rejected++;
+		}
+	}
+	MemoryUsage usage = table.memoryUsage();
+	unsigned long used = usage.keyBytes + usage.valueBytes + usage.metadataBytes;
+	CHECK(rejected == 0);
+	CHECK(used <= limit);
+	CHECK(used >= limit / 2);
+	CHECK(usage.keyBytes + usage.valueBytes >= limit / 4);
+	CHECK(table.currentSize() > 500);
+	CHECK(table.read(Key("key49999")) == value);
+	CHECK(table.create(Key("one more"), Entry(value, 1, PRIMARY)));
+}
+
+/**
+ * FUNCTION NAME: testCappedTableGrowsUnderLoad
+ *
+ * DESCRIPTION: Creates keys in a table capped at 300 KB while it resizes. The
+ * 				draining level of a resize counts against the limit, every
+ * 				create has to move the resize on and none may be turned away.
+ */
+static void testCappedTableGrowsUnderLoad() {
+	const unsigned long limit = 300 * 1024;
+	HashTable table;
+	string value(TEST_VALUE_SIZE, 'v');
+	unsigned long rejected = 0;
+	unsigned long overLimit = 0;
+
+	table.setMemoryLimit(limit, "LRU");
+	for ( int i = 0; i < 300000; i++ ) {
+		if ( !table.create(Key("key" + to_string(i)), Entry(value, 1, PRIMARY)) ) {
+			rejected++;
+		}
+		if ( i % 1000 == 0 ) {
+			MemoryUsage usage = table.memoryUsage();
+			if ( usage.keyBytes + usage.valueBytes + usage.metadataBytes > limit ) {
+				overLimit++;
+			}
+		}
+	}
+	CHECK(rejected == 0);
+	CHECK(overLimit == 0);
+	CHECK(table.hashTable.slotCount() >= 4096);
+	CHECK(!table.hashTable.isResizing());
+	CHECK(table.read(Key("key299999")) == value);
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: Runs every check
+ *
+ * RETURNS:
+ * 0 if they all hold, 1 otherwise
+ */
+int main() {
+	testCappedTableKeepsAcceptingWrites();
+	testCappedTableGrowsUnderLoad();
+	if ( failures > 0 ) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,118 @@
+/**********************************
+ * FILE NAME: Key.cpp
+ *
+ * DESCRIPTION: Definition of the compact key type
+ **********************************/
+
+#include "Key.h"
+
+/**
+ * Constructor
+ */
+Key::Key() {
+	assign(NULL, 0);
+}
+
+/**
+ * Constructor
+ */
+Key::Key(const char *data, size_t size) {
+	assign(data, size);
+}
+
+/**
+ * Constructor
+ */
+Key::Key(const char *str) {
+	assign(str, strlen(str));
+}
+
+/**
+ * Constructor
+ */
+Key::Key(const string &str) {
+	assign(str.data(), str.size());
+}
+
+/**
+ * Constructor
+ */
+Key::Key(const Slice &slice) {
+	assign(slice.data, slice.size);
+}
+
+/**
+ * Copy constructor
+ *
+ * DESCRIPTION: Copies the inline bytes, or takes another reference to the heap block
+ */
+Key::Key(const Key &anotherKey): keyHash(anotherKey.keyHash), length(anotherKey.length) {
+	if ( length <= KEY_INLINE_SIZE ) {
+		memcpy(bytes, anotherKey.bytes, sizeof(bytes));
+	}
+	else {
+		shared = anotherKey.shared;
+		__atomic_fetch_add(&shared->refs, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * Assignment operator overloading
+ */
+Key& Key::operator =(const Key &anotherKey) {
+	if ( this != &anotherKey ) {
+		Key copy(anotherKey);
+		release();
+		keyHash = copy.keyHash;
+		length = copy.length;
+		if ( length <= KEY_INLINE_SIZE ) {
+			memcpy(bytes, copy.bytes, sizeof(bytes));
+		}
+		else {
+			shared = copy.shared;
+			__atomic_fetch_add(&shared->refs, 1, __ATOMIC_RELAXED);
+		}
+	}
+	return *this;
+}
+
+/**
+ * Destructor
+ */
+Key::~Key() {
+	release();
+}
+
+/**
+ * FUNCTION NAME: assign
+ *
+ * DESCRIPTION: Stores the bytes inline or in a new heap block, and hashes them
+ */
+void Key::assign(const char *data, size_t size) {
+	length = (uint32_t)size;
+	keyHash = hashBytes(data, size);
+	if ( size <= KEY_INLINE_SIZE ) {
+		if ( size > 0 ) {
+			memcpy(bytes, data, size);
+		}
+		bytes[size] = '\0';
+		return;
+	}
+	shared = (SharedBytes *)malloc(offsetof(SharedBytes, bytes) + size);
+	if ( shared == NULL ) {
+		throw bad_alloc();
+	}
+	shared->refs = 1;
+	memcpy(shared->bytes, data, size);
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Drops the reference to the heap block, freeing it with the last one
+ */
+void Key::release() {
+	if ( length > KEY_INLINE_SIZE && __atomic_sub_fetch(&shared->refs, 1, __ATOMIC_ACQ_REL) == 0 ) {
+		free(shared);
+	}
+}
@@ -0,0 +1,95 @@
+/**********************************
+ * FILE NAME: Key.h
+ *
+ * DESCRIPTION: Header file of the compact key type used across MP2Node,
+ * 				Message and the storage engines
+ **********************************/
+
+#ifndef KEY_H_
+#define KEY_H_
+
+#include "stdincludes.h"
+#include "Slice.h"
+
+/*
+ * Macros
+ */
+// longest key kept inside the Key itself
+#define KEY_INLINE_SIZE 23
+
+/**
+ * CLASS NAME: Key
+ *
+ * DESCRIPTION: A key and its hashBytes hash, computed once when the key is
+ * 				built and carried along with every copy, so the ring, the
+ * 				stripes, the filters and the table probe all reuse it.
+ * 				Keys of up to KEY_INLINE_SIZE bytes are stored inline and
+ * 				never touch the heap. Longer keys live in one reference
+ * 				counted heap block that every copy shares, so copying a
+ * 				Key never copies its bytes.
+ */
+class Key {
+public:
+	Key();
+	Key(const char *data, size_t size);
+	Key(const char *str);
+	Key(const string &str);
+	Key(const Slice &slice);
+	Key(const Key &anotherKey);
+	Key& operator =(const Key &anotherKey);
+	~Key();
+	const char *data() const {
+		return length <= KEY_INLINE_SIZE ? bytes : shared->bytes;
+	}
+	size_t size() const {
+		return length;
+	}
+	bool empty() const {
+		return length == 0;
+	}
+	uint64_t hash() const {
+		return keyHash;
+	}
+	Slice slice() const {
+		return Slice(data(), length);
+	}
+	string toString() const {
+		return string(data(), length);
+	}
+	bool operator ==(const Key &another) const {
+		return keyHash == another.keyHash && slice() == another.slice();
+	}
+	bool operator !=(const Key &another) const {
+		return !(*this == another);
+	}
+	bool operator <(const Key &another) const {
+		return slice().compare(another.slice()) < 0;
+	}
+private:
+	// heap block of a long key
+	struct SharedBytes {
+		int refs;
+		char bytes[1];
+	};
+	uint64_t keyHash;
+	uint32_t length;
+	union {
+		char bytes[KEY_INLINE_SIZE + 1];
+		SharedBytes *shared;
+	};
+	void assign(const char *data, size_t size);
+	void release();
+};
+
+/**
+ * STRUCT NAME: KeyHasher
+ *
+ * DESCRIPTION: Hasher for unordered containers of Keys, returns the carried hash
+ */
+struct KeyHasher {
+	size_t operator()(const Key &key) const {
+		return (size_t)key.hash();
+	}
+};
+
+#endif /* KEY_H_ */
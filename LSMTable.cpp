@@ -0,0 +1,1066 @@
+/**********************************
+ * FILE NAME: LSMTable.cpp
+ *
+ * DESCRIPTION: Definition of the log structured merge tree storage engine
+ **********************************/
+
+#include "LSMTable.h"
+#include <sys/stat.h>
+#include <errno.h>
+
+/**
+ * CLASS NAME: MemtableIterator
+ *
+ * DESCRIPTION: Walks the memtable in key order
+ */
+class MemtableIterator : public RecordIterator {
+public:
+	MemtableIterator(const SkipList<EntryRecord> *list): list(list), node(list->first()) {}
+	virtual bool valid() {
+		return node != NULL;
+	}
+	virtual void next() {
+		node = node->next[0];
+	}
+	virtual const Slice &key() {
+		return node->key;
+	}
+	virtual const EntryRecord &record() {
+		return node->value;
+	}
+	virtual void seek(const Slice &target) {
+		node = list->seek(target);
+	}
+private:
+	const SkipList<EntryRecord> *list;
+	SkipList<EntryRecord>::Node *node;
+};
+
+static bool smallestKeyLess(SSTable *a, SSTable *b) {
+	return a->smallestKey().compare(b->smallestKey()) < 0;
+}
+
+/**
+ * Constructor
+ */
+LSMTable::LSMTable(size_t memtableBytes): memtable(&memArena), memtableBytes(memtableBytes),
+		flushBytes(memtableBytes), memoryLimit(0), nextNumber(1), compaction(NULL), wal(NULL),
+		liveRecords(0), tombstoneRecords(0) {}
+
+/**
+ * Destructor
+ */
+LSMTable::~LSMTable() {
+	abortCompaction();
+	for ( int level = 0; level < LSM_MAX_LEVELS; level++ ) {
+		for ( size_t i = 0; i < levels[level].size(); i++ ) {
+			delete levels[level][i];
+		}
+	}
+	// Closing the log syncs the records of the last tick
+	delete wal;
+}
+
+/**
+ * FUNCTION NAME: tablePath
+ *
+ * DESCRIPTION: Returns the file name of table number
+ */
+string LSMTable::tablePath(uint64_t number) {
+	return dir + "/" + to_string(number) + ".sst";
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Uses dir for the tables, creating it if needed, and opens the
+ * 				tables its MANIFEST lists. Their records are counted once here,
+ * 				writes keep the counts from then on.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool LSMTable::open(const string &dir) {
+	this->dir = dir;
+	if ( mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST ) {
+		return false;
+	}
+	if ( !loadManifest() ) {
+		return false;
+	}
+	countRecords(liveRecords, tombstoneRecords);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: writeManifest
+ *
+ * DESCRIPTION: Replaces the MANIFEST with the tables of every level, one
+ * 				"level number" line per table after a "next number" line
+ */
+bool LSMTable::writeManifest() {
+	string path = dir + "/MANIFEST";
+	FILE *fp = fopen((path + ".tmp").c_str(), "w");
+	if ( fp == NULL ) {
+		return false;
+	}
+	fprintf(fp, "next %llu\n", (unsigned long long)nextNumber);
+	for ( int level = 0; level < LSM_MAX_LEVELS; level++ ) {
+		for ( size_t i = 0; i < levels[level].size(); i++ ) {
+			fprintf(fp, "%d %llu\n", level, (unsigned long long)levels[level][i]->getNumber());
+		}
+	}
+	bool ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+	ok = (fclose(fp) == 0) && ok;
+	return ok && rename((path + ".tmp").c_str(), path.c_str()) == 0;
+}
+
+/**
+ * FUNCTION NAME: loadManifest
+ *
+ * DESCRIPTION: Opens the tables the MANIFEST lists. A missing MANIFEST is an empty table.
+ */
+bool LSMTable::loadManifest() {
+	FILE *fp = fopen((dir + "/MANIFEST").c_str(), "r");
+	if ( fp == NULL ) {
+		return true;
+	}
+	unsigned long long number;
+	int level;
+	bool ok = fscanf(fp, "next %llu", &number) == 1;
+	nextNumber = number;
+	while ( ok && fscanf(fp, "%d %llu", &level, &number) == 2 ) {
+		SSTable *table = new SSTable();
+		if ( level < 0 || level >= LSM_MAX_LEVELS || !table->open(tablePath(number), number) ) {
+			delete table;
+			ok = false;
+			break;
+		}
+		levels[level].push_back(table);
+	}
+	fclose(fp);
+	return ok;
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Finds the newest record of key: memtable, then level 0 newest
+ * 				first, then the one table of every deeper level that may hold it.
+ * 				The filter checks go into bloomStats when counted.
+ *
+ * RETURNS:
+ * true if found, tombstones included
+ * false otherwise
+ */
+bool LSMTable::lookup(const Slice &key, uint64_t hash, EntryRecord &record, bool counted) {
+	EntryRecord *search = memtable.find(key);
+	if ( search != NULL ) {
+		record = *search;
+		return true;
+	}
+	for ( size_t i = 0; i < levels[0].size(); i++ ) {
+		if ( levels[0][i]->overlaps(key, key) && probe(levels[0][i], key, hash, record, counted) ) {
+			return true;
+		}
+	}
+	for ( int level = 1; level < LSM_MAX_LEVELS; level++ ) {
+		SSTable *table = tableFor(level, key);
+		if ( table != NULL && probe(table, key, hash, record, counted) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: tableFor
+ *
+ * DESCRIPTION: Returns the one table of a level below 0 whose range holds key,
+ * 				NULL if there is none
+ */
+SSTable *LSMTable::tableFor(int level, const Slice &key) {
+	vector<SSTable *> &tables = levels[level];
+	// First table whose largest key is not below key
+	size_t lo = 0;
+	size_t hi = tables.size();
+	while ( lo < hi ) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ( tables[mid]->largestKey().compare(key) < 0 ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return (lo < tables.size() && tables[lo]->smallestKey().compare(key) <= 0) ? tables[lo] : NULL;
+}
+
+/**
+ * FUNCTION NAME: probe
+ *
+ * DESCRIPTION: Looks key up in one table, skipping the block read when the
+ * 				filter of the table rules the key out
+ */
+bool LSMTable::probe(SSTable *table, const Slice &key, uint64_t hash, EntryRecord &record, bool counted) {
+	if ( !table->mayContain(hash) ) {
+		if ( counted ) {
+			bloomStats.negatives++;
+		}
+		return false;
+	}
+	if ( table->get(key, record) ) {
+		return true;
+	}
+	if ( counted ) {
+		bloomStats.falsePositives++;
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: Checks the memtable and the filters of the tables that may hold
+ * 				key, without reading any block
+ *
+ * RETURNS:
+ * false if the key is surely not stored
+ * true if it may be
+ */
+bool LSMTable::mayContain(const Key &key) {
+	Slice k = key.slice();
+	unsigned long checked = 0;
+	if ( memtable.find(k) != NULL ) {
+		return true;
+	}
+	uint64_t hash = key.hash();
+	for ( size_t i = 0; i < levels[0].size(); i++ ) {
+		if ( levels[0][i]->overlaps(k, k) ) {
+			if ( levels[0][i]->mayContain(hash) ) {
+				return true;
+			}
+			checked++;
+		}
+	}
+	for ( int level = 1; level < LSM_MAX_LEVELS; level++ ) {
+		SSTable *table = tableFor(level, k);
+		if ( table != NULL ) {
+			if ( table->mayContain(hash) ) {
+				return true;
+			}
+			checked++;
+		}
+	}
+	// Only a no is counted here, a lookup follows a yes and counts it
+	bloomStats.negatives += checked;
+	return false;
+}
+
+/**
+ * FUNCTION NAME: liveVersion
+ *
+ * DESCRIPTION: Looks up the version of key without unpacking its value or
+ * 				counting the filter checks. A key in a table still costs the
+ * 				read of its block.
+ *
+ * RETURNS:
+ * true if key is live, with its version in version
+ * false otherwise
+ */
+bool LSMTable::liveVersion(const Key &key, uint64_t &version) {
+	EntryRecord search;
+	if ( !lookup(key.slice(), key.hash(), search, false) || search.isTombstone() ) {
+		return false;
+	}
+	version = search.version;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: filterStats
+ *
+ * DESCRIPTION: Returns how the table filters did, one count per table probed
+ */
+BloomStats LSMTable::filterStats() {
+	return bloomStats;
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Returns the memory taken up by the memtable and the block
+ * 				indexes of the tables. Table data stays on disk.
+ */
+MemoryUsage LSMTable::memoryUsage() {
+	MemoryUsage usage;
+	for ( SkipList<EntryRecord>::Node *node = memtable.first(); node != NULL; node = node->next[0] ) {
+		usage.keyBytes += node->key.size;
+		usage.valueBytes += node->value.value.size;
+	}
+	for ( int level = 0; level < LSM_MAX_LEVELS; level++ ) {
+		for ( size_t i = 0; i < levels[level].size(); i++ ) {
+			usage.metadataBytes += levels[level][i]->indexBytes();
+		}
+	}
+	usage.arenaBytes = memArena.bytesReserved();
+	usage.limitBytes = memoryLimit;
+	return usage;
+}
+
+/**
+ * FUNCTION NAME: setMemoryLimit
+ *
+ * DESCRIPTION: Keys never need to be evicted, the table stays under the limit
+ * 				by flushing the memtable once it takes half of it. The policy
+ * 				is not used.
+ */
+void LSMTable::setMemoryLimit(unsigned long bytes, const string &policy) {
+	memoryLimit = bytes;
+	flushBytes = bytes == 0 ? memtableBytes : min(memtableBytes, max((size_t)(bytes / 2), (size_t)SLAB_SIZE));
+}
+
+/**
+ * FUNCTION NAME: setMemoryBudget
+ *
+ * DESCRIPTION: Flushes the memtable at half the limit of the budget, as with
+ * 				setMemoryLimit. The owner of the budget has the tables that
+ * 				take up the most flush early through reclaim().
+ */
+void LSMTable::setMemoryBudget(const MemoryBudget *budget, const string &policy) {
+	setMemoryLimit(budget == NULL ? 0 : budget->limit, policy);
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the bytes in use in the memtable arena and of the block
+ * 				indexes, the arena counted as HashTable counts its own
+ */
+unsigned long LSMTable::memoryBytes() {
+	unsigned long bytes = memArena.bytesInUse();
+	for ( int level = 0; level < LSM_MAX_LEVELS; level++ ) {
+		for ( size_t i = 0; i < levels[level].size(); i++ ) {
+			bytes += levels[level][i]->indexBytes();
+		}
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: growthBytes
+ *
+ * DESCRIPTION: The memtable grows with its keys, a new key never resizes anything
+ */
+unsigned long LSMTable::growthBytes() {
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: reclaim
+ *
+ * DESCRIPTION: Writes the memtable out ahead of time, keys are never evicted
+ *
+ * RETURNS:
+ * number of keys written out, 0 if the memtable was empty or could not be written
+ */
+unsigned long LSMTable::reclaim(unsigned long count) {
+	unsigned long keys = memtable.size();
+	flushMemtable();
+	return memtable.size() == 0 ? keys : 0;
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Stores the record in the memtable and logs it, flushing the
+ * 				memtable once it is full
+ */
+void LSMTable::put(const Slice &key, const EntryRecord &record) {
+	bool inserted;
+	SkipList<EntryRecord>::Node *node = memtable.insert(key, inserted);
+	if ( inserted ) {
+		// The node still points at the caller's key, move it into the arena
+		node->key = memArena.copy(key);
+	}
+	Slice value = memArena.replace(node->value.value, record.value.data, record.value.size);
+	node->value = record;
+	node->value.value = value;
+	if ( wal != NULL ) {
+		wal->appendPut(node->key, node->value);
+	}
+	if ( memArena.bytesInUse() >= flushBytes ) {
+		flushMemtable();
+	}
+}
+
+/**
+ * FUNCTION NAME: putEntry
+ *
+ * DESCRIPTION: Stores the entry as the newest record of key
+ */
+void LSMTable::putEntry(const Slice &key, const Entry &entry) {
+	EntryRecord record;
+	string scratch;
+	record.version = entry.version;
+	record.replica = (uint8_t)entry.replica;
+	record.flags = entry.flags;
+	record.value = packValue(entry.value, scratch, record.flags);
+	put(key, record);
+}
+
+/**
+ * FUNCTION NAME: flushMemtable
+ *
+ * DESCRIPTION: Writes the memtable out as a new level 0 table. The log only
+ * 				holds what the memtable does, so it starts over.
+ * 				On failure the memtable is kept and the flush retried on the
+ * 				next write.
+ */
+void LSMTable::flushMemtable() {
+	if ( memtable.size() == 0 ) {
+		return;
+	}
+	uint64_t number = nextNumber++;
+	SSTableBuilder builder;
+	if ( !builder.open(tablePath(number)) ) {
+		return;
+	}
+	for ( SkipList<EntryRecord>::Node *node = memtable.first(); node != NULL; node = node->next[0] ) {
+		builder.add(node->key, node->value);
+	}
+	SSTable *table = new SSTable();
+	if ( !builder.finish() || !table->open(tablePath(number), number) ) {
+		delete table;
+		return;
+	}
+	levels[0].insert(levels[0].begin(), table);
+	writeManifest();
+	if ( wal != NULL ) {
+		wal->truncate();
+	}
+	memArena.clear();
+	memtable.clear();
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: This function inserts the (key,entry) pair, the write with the
+ * 				higher version wins as in HashTable::create
+ *
+ * RETURNS:
+ * true if the entry is stored or the same version is already stored
+ * false if a newer version is already stored
+ */
+bool LSMTable::create(const Key &key, const Entry &entry) {
+	EntryRecord current;
+	bool found = lookup(key.slice(), key.hash(), current);
+	if ( found ) {
+		if ( current.isTombstone() ? entry.version < current.version : entry.version <= current.version ) {
+			return !current.isTombstone() && entry.version == current.version;
+		}
+	}
+	putEntry(key.slice(), entry);
+	countWrite(found, current, (entry.flags & ENTRY_FLAG_TOMBSTONE) != 0);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: read
+ *
+ * DESCRIPTION: This function searches for the key
+ *
+ * RETURNS:
+ * string value if found
+ * else it returns a NULL
+ */
+string LSMTable::read(const Key &key) {
+	EntryRecord search;
+	if ( lookup(key.slice(), key.hash(), search) && !search.isTombstone() ) {
+		string value;
+		unpackValue(search, value);
+		return value;
+	}
+	return "";
+}
+
+/**
+ * FUNCTION NAME: readEntry
+ *
+ * DESCRIPTION: This function searches for the key and fills in its entry.
+ * 				Tombstones are only returned when withTombstones is set.
+ *
+ * RETURNS:
+ * true if found
+ * false otherwise
+ */
+bool LSMTable::readEntry(const Key &key, Entry &entry, bool withTombstones) {
+	EntryRecord search;
+	if ( !lookup(key.slice(), key.hash(), search) || (search.isTombstone() && !withTombstones) ) {
+		return false;
+	}
+	unpackEntry(search, entry);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: This function updates the key with the entry if the key is found
+ * 				and the stored version is not newer than the entry
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool LSMTable::update(const Key &key, const Entry &entry) {
+	EntryRecord current;
+	if ( !lookup(key.slice(), key.hash(), current) || current.isTombstone() || current.version > entry.version ) {
+		return false;
+	}
+	putEntry(key.slice(), entry);
+	countWrite(true, current, (entry.flags & ENTRY_FLAG_TOMBSTONE) != 0);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: Writes a tombstone of the given version for key, following the
+ * 				rules of HashTable::deleteKey
+ *
+ * RETURNS:
+ * true if a live key was deleted
+ * false if the key was not found or a newer write is stored
+ */
+bool LSMTable::deleteKey(const Key &key, uint64_t version, int time) {
+	EntryRecord current;
+	bool found = lookup(key.slice(), key.hash(), current);
+	EntryRecord tombstone;
+	tombstone.flags = ENTRY_FLAG_TOMBSTONE;
+	tombstone.deleteTime = time;
+	tombstone.version = version;
+
+	if ( !found || current.isTombstone() ) {
+		// A versioned delete still leaves a tombstone so older writes stay out
+		if ( version > 0 && (!found || version > current.version) ) {
+			put(key.slice(), tombstone);
+			countWrite(found, current, true);
+		}
+		return false;
+	}
+	if ( version > 0 && current.version > version ) {
+		// A newer write already landed
+		return false;
+	}
+	tombstone.version = max(current.version, version);
+	tombstone.replica = current.replica;
+	put(key.slice(), tombstone);
+	countWrite(found, current, true);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: countRecords
+ *
+ * DESCRIPTION: Merges the memtable and every table to count the newest record of
+ * 				every key. Touches the whole data set, only done when the table
+ * 				is opened.
+ */
+void LSMTable::countRecords(unsigned long &live, unsigned long &tombstones) {
+	vector<RecordIterator *> inputs;
+	newInputs(inputs);
+	live = 0;
+	tombstones = 0;
+	for ( MergingIterator it(inputs); it.valid(); it.next() ) {
+		if ( it.record().isTombstone() ) {
+			tombstones++;
+		}
+		else {
+			live++;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: countWrite
+ *
+ * DESCRIPTION: Moves the key of a write from the count of its record before,
+ * 				current if found, to the count of the record written
+ */
+void LSMTable::countWrite(bool found, const EntryRecord &current, bool tombstone) {
+	if ( found ) {
+		if ( current.isTombstone() ) {
+			tombstoneRecords--;
+		}
+		else {
+			liveRecords--;
+		}
+	}
+	if ( tombstone ) {
+		tombstoneRecords++;
+	}
+	else {
+		liveRecords++;
+	}
+}
+
+/**
+ * FUNCTION NAME: forEachRecord
+ *
+ * DESCRIPTION: Merges the memtable and every table to visit the newest record
+ * 				of every key, in key order
+ */
+void LSMTable::forEachRecord(RecordVisitFn visit, void *env) {
+	vector<RecordIterator *> inputs;
+	newInputs(inputs);
+	for ( MergingIterator it(inputs); it.valid(); it.next() ) {
+		visit(env, it.key(), it.record());
+	}
+}
+
+/**
+ * FUNCTION NAME: newInputs
+ *
+ * DESCRIPTION: Adds an iterator over the memtable and over every table to inputs,
+ * 				newest first, for a MergingIterator to own
+ */
+void LSMTable::newInputs(vector<RecordIterator *> &inputs) {
+	inputs.push_back(new MemtableIterator(&memtable));
+	for ( int level = 0; level < LSM_MAX_LEVELS; level++ ) {
+		for ( size_t i = 0; i < levels[level].size(); i++ ) {
+			inputs.push_back(levels[level][i]->newIterator());
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: scan
+ *
+ * DESCRIPTION: Appends the live keys from startKey up to, not including, endKey,
+ * 				at most limit of them, in key order. Every input seeks to startKey
+ * 				and the merge stops at endKey.
+ */
+void LSMTable::scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries) {
+	vector<RecordIterator *> inputs;
+	unsigned long found = 0;
+	newInputs(inputs);
+	MergingIterator it(inputs);
+	for ( it.seek(startKey); it.valid() && found < limit; it.next() ) {
+		if ( endKey.size > 0 && it.key().compare(endKey) >= 0 ) {
+			break;
+		}
+		if ( it.record().isTombstone() ) {
+			continue;
+		}
+		entries.push_back(make_pair(Key(it.key()), Entry()));
+		unpackEntry(it.record(), entries.back().second);
+		found++;
+	}
+}
+
+/**
+ * FUNCTION NAME: setOrderedIndex
+ *
+ * DESCRIPTION: Nothing to do, the memtable and the tables are sorted already
+ */
+void LSMTable::setOrderedIndex(bool enabled) {
+}
+
+/**
+ * FUNCTION NAME: currentSize
+ *
+ * DESCRIPTION: Returns the number of live keys, without reading any table
+ */
+unsigned long LSMTable::currentSize() {
+	return liveRecords;
+}
+
+/**
+ * FUNCTION NAME: tombstoneCount
+ *
+ * DESCRIPTION: Returns the number of tombstones, without reading any table
+ */
+unsigned long LSMTable::tombstoneCount() {
+	return tombstoneRecords;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Drops the memtable and deletes every table
+ */
+void LSMTable::clear() {
+	abortCompaction();
+	for ( int level = 0; level < LSM_MAX_LEVELS; level++ ) {
+		for ( size_t i = 0; i < levels[level].size(); i++ ) {
+			unlink(levels[level][i]->getPath().c_str());
+			delete levels[level][i];
+		}
+		levels[level].clear();
+		compactPointer[level].clear();
+	}
+	writeManifest();
+	memArena.clear();
+	memtable.clear();
+	liveRecords = 0;
+	tombstoneRecords = 0;
+	if ( wal != NULL ) {
+		wal->truncate();
+	}
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: Returns the count of the number of values for the passed in key
+ */
+unsigned long LSMTable::count(const Key &key) {
+	EntryRecord search;
+	return (lookup(key.slice(), key.hash(), search) && !search.isTombstone()) ? 1 : 0;
+}
+
+/**
+ * FUNCTION NAME: levelBytes
+ *
+ * DESCRIPTION: Returns the size of the files of a level
+ */
+uint64_t LSMTable::levelBytes(int level) {
+	uint64_t bytes = 0;
+	for ( size_t i = 0; i < levels[level].size(); i++ ) {
+		bytes += levels[level][i]->fileSize();
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: pickCompaction
+ *
+ * DESCRIPTION: Picks the next merge: all of level 0 once it has too many tables,
+ * 				else one table of the first level over its size, taken round
+ * 				robin through the key space. The tables of the next level that
+ * 				overlap join the merge.
+ *
+ * RETURNS:
+ * the compaction, NULL if no level needs one
+ */
+LSMCompaction *LSMTable::pickCompaction() {
+	int level = -1;
+	uint64_t maxBytes = LSM_LEVEL1_BYTES;
+	if ( levels[0].size() >= LSM_L0_COMPACTION_TRIGGER ) {
+		level = 0;
+	}
+	for ( int i = 1; level < 0 && i < LSM_MAX_LEVELS - 1; i++ ) {
+		if ( levelBytes(i) > maxBytes ) {
+			level = i;
+		}
+		maxBytes *= LSM_LEVEL_MULTIPLIER;
+	}
+	if ( level < 0 ) {
+		return NULL;
+	}
+
+	vector<SSTable *> upper;
+	if ( level == 0 ) {
+		upper = levels[0];
+	}
+	else {
+		vector<SSTable *> &tables = levels[level];
+		SSTable *next = tables[0];
+		for ( size_t i = 0; i < tables.size(); i++ ) {
+			if ( tables[i]->smallestKey().compare(Slice(compactPointer[level])) > 0 ) {
+				next = tables[i];
+				break;
+			}
+		}
+		upper.push_back(next);
+		compactPointer[level] = next->largestKey().toString();
+	}
+	Slice smallest = upper[0]->smallestKey();
+	Slice largest = upper[0]->largestKey();
+	for ( size_t i = 1; i < upper.size(); i++ ) {
+		if ( upper[i]->smallestKey().compare(smallest) < 0 ) {
+			smallest = upper[i]->smallestKey();
+		}
+		if ( upper[i]->largestKey().compare(largest) > 0 ) {
+			largest = upper[i]->largestKey();
+		}
+	}
+
+	LSMCompaction *c = new LSMCompaction();
+	c->level = level;
+	c->inputs = upper;
+	for ( size_t i = 0; i < levels[level + 1].size(); i++ ) {
+		if ( levels[level + 1][i]->overlaps(smallest, largest) ) {
+			c->inputs.push_back(levels[level + 1][i]);
+		}
+	}
+	// Inputs go newest first, level 0 already is and the next level is older
+	vector<RecordIterator *> iterators;
+	for ( size_t i = 0; i < c->inputs.size(); i++ ) {
+		iterators.push_back(c->inputs[i]->newIterator());
+	}
+	c->merged = new MergingIterator(iterators);
+	c->building = false;
+	c->buildingNumber = 0;
+	c->dropTombstones = true;
+	for ( int i = level + 2; i < LSM_MAX_LEVELS; i++ ) {
+		if ( !levels[i].empty() ) {
+			c->dropTombstones = false;
+		}
+	}
+	return c;
+}
+
+/**
+ * FUNCTION NAME: finishOutput
+ *
+ * DESCRIPTION: Finishes the output table the compaction is writing
+ */
+bool LSMTable::finishOutput() {
+	compaction->building = false;
+	if ( compaction->builder.count() == 0 ) {
+		compaction->builder.abandon();
+		return true;
+	}
+	if ( !compaction->builder.finish() ) {
+		return false;
+	}
+	compaction->outputs.push_back(compaction->buildingNumber);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: Background merge step. Starts a compaction when a level needs one
+ * 				and moves no more than budget records of it along. A finished
+ * 				compaction replaces its inputs with its outputs.
+ *
+ * RETURNS:
+ * number of tombstones dropped
+ */
+unsigned long LSMTable::compact(int time, int gracePeriod, unsigned long budget) {
+	unsigned long dropped = 0;
+
+	if ( compaction == NULL ) {
+		compaction = pickCompaction();
+		if ( compaction == NULL ) {
+			return 0;
+		}
+	}
+	MergingIterator *merged = compaction->merged;
+	for ( unsigned long i = 0; i < budget && merged->valid(); i++ ) {
+		const EntryRecord &record = merged->record();
+		if ( compaction->dropTombstones && record.isTombstone() && record.deleteTime + gracePeriod <= time ) {
+			compaction->droppedTombstones.push_back(merged->key().toString());
+			dropped++;
+		}
+		else {
+			if ( !compaction->building ) {
+				compaction->buildingNumber = nextNumber++;
+				if ( !compaction->builder.open(tablePath(compaction->buildingNumber)) ) {
+					abortCompaction();
+					return dropped;
+				}
+				compaction->building = true;
+			}
+			compaction->builder.add(merged->key(), record);
+			if ( compaction->builder.fileSize() >= LSM_TARGET_FILE_SIZE && !finishOutput() ) {
+				abortCompaction();
+				return dropped;
+			}
+		}
+		merged->next();
+	}
+	if ( !merged->valid() ) {
+		finishCompaction();
+	}
+	return dropped;
+}
+
+/**
+ * FUNCTION NAME: shadowed
+ *
+ * DESCRIPTION: Returns whether a record newer than the inputs of the running
+ * 				compaction is stored for key, in the memtable or a table
+ * 				above them. Only asked for the tombstones the compaction
+ * 				dropped, before its inputs leave the levels.
+ */
+bool LSMTable::shadowed(const Slice &key) {
+	EntryRecord record;
+	if ( memtable.find(key) != NULL ) {
+		return true;
+	}
+	for ( int level = 0; level <= compaction->level; level++ ) {
+		for ( size_t i = 0; i < levels[level].size(); i++ ) {
+			SSTable *table = levels[level][i];
+			if ( find(compaction->inputs.begin(), compaction->inputs.end(), table) == compaction->inputs.end()
+					&& table->overlaps(key, key) && table->get(key, record) ) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: finishCompaction
+ *
+ * DESCRIPTION: Puts the outputs of the compaction in the next level, in place of
+ * 				its inputs, and deletes the input files
+ */
+void LSMTable::finishCompaction() {
+	if ( compaction->merged->corrupted() || (compaction->building && !finishOutput()) ) {
+		// Keep the inputs rather than lose what could not be read
+		abortCompaction();
+		return;
+	}
+	vector<SSTable *> outputs;
+	for ( size_t i = 0; i < compaction->outputs.size(); i++ ) {
+		uint64_t number = compaction->outputs[i];
+		SSTable *table = new SSTable();
+		if ( !table->open(tablePath(number), number) ) {
+			delete table;
+			for ( size_t j = 0; j < outputs.size(); j++ ) {
+				delete outputs[j];
+			}
+			abortCompaction();
+			return;
+		}
+		outputs.push_back(table);
+	}
+
+	// A dropped tombstone that was the newest record of its key takes the key with it
+	for ( size_t i = 0; i < compaction->droppedTombstones.size(); i++ ) {
+		if ( !shadowed(Slice(compaction->droppedTombstones[i])) ) {
+			tombstoneRecords--;
+		}
+	}
+
+	int level = compaction->level;
+	for ( int l = level; l <= level + 1; l++ ) {
+		vector<SSTable *> kept;
+		for ( size_t i = 0; i < levels[l].size(); i++ ) {
+			if ( find(compaction->inputs.begin(), compaction->inputs.end(), levels[l][i]) == compaction->inputs.end() ) {
+				kept.push_back(levels[l][i]);
+			}
+		}
+		levels[l].swap(kept);
+	}
+	levels[level + 1].insert(levels[level + 1].end(), outputs.begin(), outputs.end());
+	sort(levels[level + 1].begin(), levels[level + 1].end(), smallestKeyLess);
+	writeManifest();
+
+	// The merge reads the inputs, it goes before them
+	delete compaction->merged;
+	for ( size_t i = 0; i < compaction->inputs.size(); i++ ) {
+		unlink(compaction->inputs[i]->getPath().c_str());
+		delete compaction->inputs[i];
+	}
+	delete compaction;
+	compaction = NULL;
+}
+
+/**
+ * FUNCTION NAME: abortCompaction
+ *
+ * DESCRIPTION: Gives up the running compaction, if any, and deletes its outputs
+ */
+void LSMTable::abortCompaction() {
+	if ( compaction == NULL ) {
+		return;
+	}
+	compaction->builder.abandon();
+	for ( size_t i = 0; i < compaction->outputs.size(); i++ ) {
+		unlink(tablePath(compaction->outputs[i]).c_str());
+	}
+	delete compaction->merged;
+	delete compaction;
+	compaction = NULL;
+}
+
+/**
+ * FUNCTION NAME: replayRecord
+ *
+ * DESCRIPTION: Log replay callback
+ */
+void LSMTable::replayRecord(void *env, WalOp op, const Slice &key, const EntryRecord &record) {
+	LSMTable *table = (LSMTable *)env;
+	if ( op == WAL_CLEAR ) {
+		table->memArena.clear();
+		table->memtable.clear();
+	}
+	else {
+		table->put(key, record);
+	}
+}
+
+/**
+ * FUNCTION NAME: openLog
+ *
+ * DESCRIPTION: Opens the write ahead log of the memtable at path and rebuilds the
+ * 				memtable from it
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool LSMTable::openLog(const string &path, int syncIntervalMs) {
+	WriteAheadLog *log = new WriteAheadLog();
+	if ( !log->open(path, syncIntervalMs) ) {
+		delete log;
+		return false;
+	}
+	delete wal;
+	wal = NULL;
+	log->replay(replayRecord, this);
+	wal = log;
+	// The replayed records went in without a lookup, count them once here
+	countRecords(liveRecords, tombstoneRecords);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: syncLog
+ *
+ * DESCRIPTION: Makes every write logged so far durable, one sync for all of them
+ */
+bool LSMTable::syncLog() {
+	return wal != NULL && wal->sync();
+}
+
+/**
+ * FUNCTION NAME: dumpSnapshot
+ *
+ * DESCRIPTION: The tables already are a snapshot, only the memtable is flushed.
+ * 				path is not used.
+ */
+bool LSMTable::dumpSnapshot(const string &path) {
+	flushMemtable();
+	return memtable.size() == 0;
+}
+
+/**
+ * FUNCTION NAME: openSnapshot
+ *
+ * DESCRIPTION: Tables are opened by open(), there is no separate snapshot
+ */
+bool LSMTable::openSnapshot(const string &path) {
+	return false;
+}
+
+unsigned long LSMTable::warmSnapshot(unsigned long budget) {
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: tableCount
+ *
+ * DESCRIPTION: Returns the number of tables in a level
+ */
+unsigned long LSMTable::tableCount(int level) {
+	return levels[level].size();
+}
@@ -0,0 +1,144 @@
+/**********************************
+ * FILE NAME: LSMTable.h
+ *
+ * DESCRIPTION: Header file of the log structured merge tree storage engine
+ **********************************/
+
+#ifndef LSMTABLE_H_
+#define LSMTABLE_H_
+
+#include "stdincludes.h"
+#include "StorageEngine.h"
+#include "SkipList.h"
+#include "SSTable.h"
+#include "WriteAheadLog.h"
+
+/*
+ * Macros
+ */
+#define LSM_MAX_LEVELS 7
+// level 0 is merged into level 1 once it holds this many tables
+#define LSM_L0_COMPACTION_TRIGGER 4
+#define LSM_MEMTABLE_SIZE (4 * 1024 * 1024)
+#define LSM_LEVEL1_BYTES (10 * 1024 * 1024)
+// every level may hold this many times the bytes of the one above
+#define LSM_LEVEL_MULTIPLIER 10
+// compaction cuts its output into tables of about this size
+#define LSM_TARGET_FILE_SIZE (2 * 1024 * 1024)
+
+/**
+ * STRUCT NAME: LSMCompaction
+ *
+ * DESCRIPTION: A merge of tables of one level into the next one, carried
+ * 				out a few records per call to LSMTable::compact()
+ */
+typedef struct LSMCompaction {
+	// inputs come from level and level + 1
+	int level;
+	vector<SSTable *> inputs;
+	MergingIterator *merged;
+	SSTableBuilder builder;
+	bool building;
+	uint64_t buildingNumber;
+	vector<uint64_t> outputs;
+	// no level below the output holds data a tombstone could still hide
+	bool dropTombstones;
+	// keys of the tombstones left out of the outputs
+	vector<string> droppedTombstones;
+} LSMCompaction;
+
+/**
+ * CLASS NAME: LSMTable
+ *
+ * DESCRIPTION: Log structured merge tree for data sets larger than memory.
+ * 				Writes go to a skip list memtable, logged to the write ahead
+ * 				log when one is open. A full memtable is written out as an
+ * 				immutable SSTable in level 0 and the log starts over.
+ * 				Level 0 tables may overlap and are searched newest first,
+ * 				the tables of every deeper level cover disjoint key ranges.
+ * 				The BloomFilter of a table keeps lookups of keys it does not
+ * 				hold from reading any of its blocks.
+ * 				compact() merges a level into the next one once it grows past
+ * 				its size, budget records at a time, and drops tombstones past
+ * 				their grace period when nothing older lies below.
+ * 				The tables of every level are listed in a MANIFEST file in
+ * 				the directory of the table.
+ */
+class LSMTable : public StorageEngine {
+public:
+	LSMTable(size_t memtableBytes = LSM_MEMTABLE_SIZE);
+	virtual ~LSMTable();
+	bool open(const string &dir);
+	virtual bool create(const Key &key, const Entry &entry);
+	virtual string read(const Key &key);
+	virtual bool readEntry(const Key &key, Entry &entry, bool withTombstones = false);
+	virtual bool update(const Key &key, const Entry &entry);
+	virtual bool deleteKey(const Key &key, uint64_t version, int time);
+	virtual unsigned long currentSize();
+	virtual unsigned long tombstoneCount();
+	virtual void clear();
+	virtual unsigned long count(const Key &key);
+	virtual bool mayContain(const Key &key);
+	virtual bool liveVersion(const Key &key, uint64_t &version);
+	virtual BloomStats filterStats();
+	virtual void forEachRecord(RecordVisitFn visit, void *env);
+	virtual void scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries);
+	virtual void setOrderedIndex(bool enabled);
+	virtual MemoryUsage memoryUsage();
+	virtual void setMemoryLimit(unsigned long bytes, const string &policy);
+	virtual void setMemoryBudget(const MemoryBudget *budget, const string &policy);
+	virtual unsigned long memoryBytes();
+	virtual unsigned long growthBytes();
+	virtual unsigned long reclaim(unsigned long count);
+	virtual unsigned long compact(int time, int gracePeriod, unsigned long budget);
+	virtual bool openLog(const string &path, int syncIntervalMs);
+	virtual bool syncLog();
+	virtual bool dumpSnapshot(const string &path);
+	virtual bool openSnapshot(const string &path);
+	virtual unsigned long warmSnapshot(unsigned long budget);
+	unsigned long tableCount(int level);
+private:
+	string dir;
+	Arena memArena;
+	SkipList<EntryRecord> memtable;
+	size_t memtableBytes;
+	// memtable size a flush is started at, smaller than memtableBytes under a memory limit
+	size_t flushBytes;
+	unsigned long memoryLimit;
+	// level 0 newest first, deeper levels in key order
+	vector<SSTable *> levels[LSM_MAX_LEVELS];
+	uint64_t nextNumber;
+	// largest key of the last table each level gave to a compaction
+	string compactPointer[LSM_MAX_LEVELS];
+	LSMCompaction *compaction;
+	WriteAheadLog *wal;
+	// filter checks made ahead of table lookups
+	BloomStats bloomStats;
+	// keys whose newest record is live or a tombstone, kept up to date by
+	// every write so stats never merge the tables
+	unsigned long liveRecords;
+	unsigned long tombstoneRecords;
+	void newInputs(vector<RecordIterator *> &inputs);
+	LSMTable(const LSMTable &anotherTable);
+	LSMTable& operator =(const LSMTable &anotherTable);
+	bool lookup(const Slice &key, uint64_t hash, EntryRecord &record, bool counted = true);
+	SSTable *tableFor(int level, const Slice &key);
+	bool probe(SSTable *table, const Slice &key, uint64_t hash, EntryRecord &record, bool counted);
+	void put(const Slice &key, const EntryRecord &record);
+	void putEntry(const Slice &key, const Entry &entry);
+	void flushMemtable();
+	string tablePath(uint64_t number);
+	bool writeManifest();
+	bool loadManifest();
+	uint64_t levelBytes(int level);
+	LSMCompaction *pickCompaction();
+	bool finishOutput();
+	void finishCompaction();
+	void abortCompaction();
+	void countRecords(unsigned long &live, unsigned long &tombstones);
+	void countWrite(bool found, const EntryRecord &current, bool tombstone);
+	bool shadowed(const Slice &key);
+	static void replayRecord(void *env, WalOp op, const Slice &key, const EntryRecord &record);
+};
+
+#endif /* LSMTABLE_H_ */
@@ -141,18 +141,16 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
         memberNode->inGroup = true;
     }
     else {
-        mP1NodeMessage *message = (mP1NodeMessage *)malloc(sizeof(mP1NodeMessage));
-        message->msgHdr.msgType = JOINREQ;
-        memcpy(message->msgContent.joinReqContent.addr, &memberNode->addr.addr, sizeof(memberNode->addr.addr));
-        message->msgContent.joinReqContent.heartbeat = 0;
-        size_t msgsize = sizeof(mP1NodeMessage);
+        JoinReqMessage message;
+        message.msgType = JOINREQ;
+        message.addr = memberNode->addr;
+        message.heartbeat = 0;
 #ifdef DEBUGLOG
         sprintf(s, "Trying to join...");
         log->LOG(&memberNode->addr, s);
 #endif
         // send JOINREQ message to introducer member
-        emulNet->ENsend(&memberNode->addr, joinaddr, (char *)message, msgsize);
-        free(message);
+        sendMessage<JoinReqFields>(joinaddr, message);
     }
     // Nodes should always add reference to themselves so when they pass their list other nodes will also
     // get their information as well as having a reference to self as the fist element in their memberList.
@@ -225,6 +223,7 @@ void MP1Node::checkMessages() {
     	size = memberNode->mp1q.front().size;
     	memberNode->mp1q.pop();
     	recvCallBack((void *)memberNode, (char *)ptr, size);
+    	free(ptr);
     }
     return;
 }
@@ -237,21 +236,44 @@ void MP1Node::checkMessages() {
 bool MP1Node::recvCallBack(void *env, char *data, int size ) {
 
     Member *memberNode = (Member*)env;
-    mP1NodeMessage *msg = (mP1NodeMessage*)data;
+    enum MsgTypes msgType;
+    // Every message starts with its type, the rest is decoded by the field list of that type
+    WireReader header(data, size);
+    WireCodec<MsgTypes>::decode(header, msgType);
+    if(!header.ok())
+    {
+        return false;
+    }
 
-    if(msg->msgHdr.msgType == JOINREQ) 
+    if(msgType == JOINREQ) 
     {
-        receivedJoinReq(memberNode, &(msg->msgContent.joinReqContent));
+        JoinReqMessage msg;
+        if(!wireDecode<JoinReqFields>(data, size, msg))
+        {
+            return false;
+        }
+        receivedJoinReq(memberNode, &msg);
     } 
-    else if(msg->msgHdr.msgType == JOINREP) 
+    else if(msgType == JOINREP) 
     {        
+        MemberListMessage msg;
+        if(!wireDecode<MemberListFields>(data, size, msg))
+        {
+            return false;
+        }
         receivedJoinRep(memberNode);
-        // receivedJoinRep(memberNode, &(msg->msgContent.gossipContent));
+        // receivedJoinRep(memberNode, &msg);
     } 
-    else if(msg->msgHdr.msgType == GOSSIP) 
+    else if(msgType == GOSSIP) 
     {
-        receivedGossipMessage(memberNode, &(msg->msgContent.gossipContent));
+        MemberListMessage msg;
+        if(!wireDecode<MemberListFields>(data, size, msg))
+        {
+            return false;
+        }
+        receivedGossipMessage(memberNode, &msg);
     }
+    return true;
 }
 
 
@@ -262,13 +284,13 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
  *              with by inserting the message data as a new node.
  * 
  */
-void MP1Node::receivedJoinReq(Member *memberNode, JoinReqContent *mesg_data)
+void MP1Node::receivedJoinReq(Member *memberNode, JoinReqMessage *mesg_data)
 {
     #ifdef DEBUGLOG
         log->LOG(&memberNode->addr, "Hello World");
     #endif
     Address addr;
-    memcpy(&addr.addr, &mesg_data->addr, sizeof(addr.addr));
+    memcpy(&addr.addr, &mesg_data->addr.addr, sizeof(addr.addr));
 
     int id;
     short port;
@@ -304,7 +326,7 @@ void MP1Node::receivedJoinRep(Member *memberNode)
     memberNode->inGroup = true;
 }
 
-void MP1Node::receivedJoinRep(Member *memberNode, GossipContent *gossip_mesg)
+void MP1Node::receivedJoinRep(Member *memberNode, MemberListMessage *gossip_mesg)
 {
     memberNode->inGroup = true;
 
@@ -316,8 +338,8 @@ void MP1Node::receivedJoinRep(Member *memberNode, GossipContent *gossip_mesg)
     //     membersToRemoveList->erase(itr);
 
     // }
-    if(gossip_mesg->memberCount > 0) {
-        for(int i = 0; i < gossip_mesg->memberCount; i++)
+    if(!gossip_mesg->memberList.empty()) {
+        for(size_t i = 0; i < gossip_mesg->memberList.size(); i++)
         {
             MemberListEntry *new_entry = &gossip_mesg->memberList[i];
             new_entry->heartbeat = getMemberNode()->heartbeat;
@@ -339,9 +361,9 @@ void MP1Node::receivedJoinRep(Member *memberNode, GossipContent *gossip_mesg)
  *              with by inserting the message data as a new node.
  * 
  */
-void MP1Node::receivedGossipMessage(Member *memberNode, GossipContent *gossip_mesg)
+void MP1Node::receivedGossipMessage(Member *memberNode, MemberListMessage *gossip_mesg)
 {
-    for(int i = 0; i < gossip_mesg->memberCount; ++i)
+    for(size_t i = 0; i < gossip_mesg->memberList.size(); ++i)
     {
         MemberListEntry *new_entry = &gossip_mesg->memberList[i];
         MemberListEntry *old_entry = getMemberById(new_entry->id);
@@ -482,13 +504,11 @@ void MP1Node::printAddress(Address *addr)
  */
 void MP1Node::sendJoinRep(Address *addr)
 {
-    mP1NodeMessage *joinRepMessage = (mP1NodeMessage *)malloc(sizeof(mP1NodeMessage));
-    joinRepMessage->msgHdr.msgType = JOINREP;
-    size_t msgsize = sizeof(mP1NodeMessage);
+    MemberListMessage joinRepMessage;
+    joinRepMessage.msgType = JOINREP;
     
     // send JOINREP message to the address confirming that they have been added to the memberList.
-    emulNet->ENsend(&memberNode->addr, addr, (char *)joinRepMessage, msgsize);
-    free(joinRepMessage);
+    sendMessage<MemberListFields>(addr, joinRepMessage);
 }
 
 // void MP1Node::sendJoinRep(Address *addr) 
@@ -533,69 +553,74 @@ void MP1Node::sendJoinRep(Address *addr)
  */
 void MP1Node::sendGossipMessage(Address *addr)
 {
-
-    int totalMembers = getMemberNode()->memberList.size();
-    if(totalMembers <= 0)
+    if(getMemberNode()->memberList.empty())
     {
         return;
     }
-    size_t msgSize = sizeof(mP1NodeMessage) + (totalMembers - 1) * sizeof(MemberListEntry);
-    mP1NodeMessage *gossipMsg = (mP1NodeMessage *)malloc(msgSize);
-    gossipMsg->msgHdr.msgType = GOSSIP;
-
-    GossipContent *gossip = &gossipMsg->msgContent.gossipContent;
-    gossip->memberCount = totalMembers;
-
-    int i = 0;
-    // Iterate over the memberList, if a member exists in the membersToRemoveList then subtract 1 from
-    // the memberCount field so that when receiving a gossip message the totals are correct. 
-    for( auto &entry : getMemberNode()->memberList)
-    {
-        vector<int>::iterator itr = find (membersToRemoveList->begin(), membersToRemoveList->end(), entry.id);
-        if (itr != membersToRemoveList->end())
-        {
-            --gossip->memberCount;
-            continue;
-        }
-        memcpy(&(gossip->memberList[i]), &entry, sizeof(MemberListEntry));
-        i++;
-    }
+    MemberListMessage gossipMsg;
+    buildMemberListMessage(gossipMsg, GOSSIP);
     // send Gossip message
-    emulNet->ENsend(&memberNode->addr, addr, (char *)gossipMsg, msgSize);
-    free(gossipMsg);
+    sendMessage<MemberListFields>(addr, gossipMsg);
 }
 
 void MP1Node::sendMemberList(Address *addr) 
 {
-    int totalMembers = getMemberNode()->memberList.size();
-    if(totalMembers <= 0)
+    if(getMemberNode()->memberList.empty())
     {
         return;
     }
-    size_t msgSize = sizeof(mP1NodeMessage) + (totalMembers - 1) * sizeof(MemberListEntry);
-    mP1NodeMessage *gossipMsg = (mP1NodeMessage *)malloc(msgSize);
-    gossipMsg->msgHdr.msgType = JOINREP;
+    MemberListMessage gossipMsg;
+    buildMemberListMessage(gossipMsg, JOINREP);
+    // send JOINREP message with the accurate memberList
+    sendMessage<MemberListFields>(addr, gossipMsg);
+}
 
-    GossipContent *gossip = &gossipMsg->msgContent.gossipContent;
-    gossip->memberCount = totalMembers;
+/**
+ * FUNCTION NAME: compareMemberIds
+ *
+ * DESCRIPTION: Orders membership list entries by id
+ */
+static bool compareMemberIds(const MemberListEntry &a, const MemberListEntry &b)
+{
+    return a.id < b.id;
+}
 
-    int i = 0;
-    // Iterate over the memberList, if a member exists in the membersToRemoveList then subtract 1 from
-    // the memberCount field so that when receiving a gossip message the totals are correct. 
+/**
+ * FUNCTION NAME: buildMemberListMessage
+ *
+ * DESCRIPTION: Fills in a message of type msgType with the memberList, leaving out the members
+ *              in the membersToRemoveList
+ */
+void MP1Node::buildMemberListMessage(MemberListMessage &message, enum MsgTypes msgType)
+{
+    message.msgType = msgType;
+    message.memberList.reserve(getMemberNode()->memberList.size());
+    // Iterate over the memberList, if a member exists in the membersToRemoveList leave it out
+    // so that a node receiving the message does not add it back.
     for( auto &entry : getMemberNode()->memberList)
     {
         vector<int>::iterator itr = find (membersToRemoveList->begin(), membersToRemoveList->end(), entry.id);
         if (itr != membersToRemoveList->end())
         {
-            --gossip->memberCount;
             continue;
         }
-        memcpy(&(gossip->memberList[i]), &entry, sizeof(MemberListEntry));
-        i++;
+        message.memberList.push_back(entry);
     }
-    // send JOINREP message with the accurate memberList
-    emulNet->ENsend(&memberNode->addr, addr, (char *)gossipMsg, msgSize);
-    free(gossipMsg);
+    // Sorted by id the list is sent as small id deltas, see MemberListCodec
+    sort(message.memberList.begin(), message.memberList.end(), compareMemberIds);
+}
+
+/**
+ * FUNCTION NAME: sendMessage
+ *
+ * DESCRIPTION: Encodes message with the field list Fields and sends it to addr
+ */
+template <typename Fields, typename S>
+void MP1Node::sendMessage(Address *addr, const S &message)
+{
+    vector<char> buffer(Fields::size(message));
+    size_t size = wireEncode<Fields>(message, &buffer[0], buffer.size());
+    emulNet->ENsend(&memberNode->addr, addr, &buffer[0], (int)size);
 }
 
 /**
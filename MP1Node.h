@@ -14,6 +14,7 @@
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
+#include "Serializer.h"
 
 /**
  * Macros
@@ -35,44 +36,115 @@ enum MsgTypes{
     DUMMYLASTMSGTYPE = 3
 };
 
+template <>
+struct WireEnumLimit<MsgTypes> {
+	static const int value = GOSSIP;
+};
+
 /**
- * STRUCT NAME: MessageHdr
+ * STRUCT NAME: JoinReqMessage
  *
- * DESCRIPTION: Header and content of a message
+ * DESCRIPTION: A JOINREQ message (the node's address and heartbeat)
  */
-typedef struct MessageHdr {
+typedef struct JoinReqMessage {
 	enum MsgTypes msgType;
-}MessageHdr;
+	Address addr;
+	long heartbeat;
+}JoinReqMessage;
+
+typedef WireFields<
+	WIRE_FIELD(JoinReqMessage, msgType),
+	WIRE_FIELD(JoinReqMessage, addr),
+	WIRE_FIELD(JoinReqMessage, heartbeat)> JoinReqFields;
 
 /**
- * STRUCT NAME: JoinReqContent
+ * STRUCT NAME: MemberListMessage
  *
- * DESCRIPTION: The content of a JoinReq message (the node's address and heartbeat) 
+ * DESCRIPTION: A GOSSIP or JOINREP message (membership list, empty in a JOINREP
+ * 				that only confirms the join)
  */
-typedef struct JoinReqContent {
-    char addr[6];
-    long heartbeat;
-}JoinReqContent;
+typedef struct MemberListMessage {
+	enum MsgTypes msgType;
+	vector<MemberListEntry> memberList;
+}MemberListMessage;
 
 /**
- * STRUCT NAME: GossipContent
+ * STRUCT NAME: MemberListCodec
  *
- * DESCRIPTION: The content of a gossip message (membership list)
+ * DESCRIPTION: Compact codec of a membership list. After the count comes the
+ * 				smallest heartbeat as a base, then per member varints of
+ * 				its id minus the id before it, its port and its heartbeat
+ * 				minus the base. Timestamps are not sent, a receiver stamps
+ * 				members with its own time. A list sorted by id, as
+ * 				buildMemberListMessage makes it, takes a few bytes per member.
+ * 				Ids wrap around, so any order decodes back as it was sent.
  */
-typedef struct GossipContent {
-    long memberCount;
-    MemberListEntry memberList[1];
-}GossipContent;
-
-typedef union MessageContent {
-   JoinReqContent joinReqContent;
-   GossipContent gossipContent;
-}MessageContent;
+struct MemberListCodec {
+	static const size_t minSize = 2;
+	// id delta, port and heartbeat delta take a byte at least
+	static const size_t minEntrySize = 3;
+	static size_t size(const vector<MemberListEntry> &value) {
+		long base = baseHeartbeat(value);
+		uint32_t prevId = 0;
+		size_t total = varintLength(value.size()) + varintLength((uint64_t)base);
+		for ( size_t i = 0; i < value.size(); i++ ) {
+			total += varintLength((uint32_t)value[i].id - prevId);
+			total += varintLength((uint16_t)value[i].port);
+			total += varintLength((uint64_t)value[i].heartbeat - (uint64_t)base);
+			prevId = (uint32_t)value[i].id;
+		}
+		return total;
+	}
+	static void encode(WireWriter &out, const vector<MemberListEntry> &value) {
+		long base = baseHeartbeat(value);
+		uint32_t prevId = 0;
+		out.putVarint(value.size());
+		out.putVarint((uint64_t)base);
+		for ( size_t i = 0; i < value.size(); i++ ) {
+			out.putVarint((uint32_t)value[i].id - prevId);
+			out.putVarint((uint16_t)value[i].port);
+			out.putVarint((uint64_t)value[i].heartbeat - (uint64_t)base);
+			prevId = (uint32_t)value[i].id;
+		}
+	}
+	static void decode(WireReader &in, vector<MemberListEntry> &value) {
+		uint64_t count;
+		uint64_t base;
+		uint32_t prevId = 0;
+		in.getVarint(count);
+		in.getVarint(base);
+		if ( count > in.remaining() / minEntrySize ) {
+			in.fail();
+			return;
+		}
+		value.resize(count);
+		for ( size_t i = 0; i < value.size() && in.ok(); i++ ) {
+			uint64_t idDelta;
+			uint64_t port;
+			uint64_t heartbeatDelta;
+			in.getVarint(idDelta);
+			in.getVarint(port);
+			in.getVarint(heartbeatDelta);
+			if ( idDelta > numeric_limits<uint32_t>::max() || port > numeric_limits<uint16_t>::max() ) {
+				in.fail();
+				return;
+			}
+			prevId += (uint32_t)idDelta;
+			value[i] = MemberListEntry((int)prevId, (short)port, (long)(base + heartbeatDelta), 0);
+		}
+	}
+	static long baseHeartbeat(const vector<MemberListEntry> &value) {
+		long base = value.empty() ? 0 : value[0].heartbeat;
+		for ( size_t i = 1; i < value.size(); i++ ) {
+			base = min(base, value[i].heartbeat);
+		}
+		return base;
+	}
+};
 
-typedef struct MP1NodeMessage {
-    MessageHdr msgHdr;
-    MessageContent msgContent;
-}mP1NodeMessage;
+typedef WireFields<
+	WIRE_FIELD(MemberListMessage, msgType),
+	WIRE_FIELD_AS(MemberListMessage, memberList, MemberListCodec)> MemberListFields;
 
 /**
  * CLASS NAME: MP1Node
@@ -111,13 +183,16 @@ private:
 
     vector<int> *membersToRemoveList;
 
-    void receivedJoinReq(Member *memberNode, JoinReqContent *mesg_data);
+    void receivedJoinReq(Member *memberNode, JoinReqMessage *mesg_data);
 	void receivedJoinRep(Member *memberNode);
-    void receivedJoinRep(Member *memberNode, GossipContent *gossip_mesg);
-    void receivedGossipMessage(Member *memberNode, GossipContent *gossip_mesg);
+    void receivedJoinRep(Member *memberNode, MemberListMessage *gossip_mesg);
+    void receivedGossipMessage(Member *memberNode, MemberListMessage *gossip_mesg);
     void sendJoinRep(Address *addr);
 	void sendMemberList(Address *addr);
     void sendGossipMessage(Address *addr);
+    void buildMemberListMessage(MemberListMessage &message, enum MsgTypes msgType);
+    template <typename Fields, typename S>
+    void sendMessage(Address *addr, const S &message);
     MemberListEntry *getMemberById(int id);
     void identifyAndRemoveFailedNodes();
 
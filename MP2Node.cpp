@@ -4,6 +4,7 @@
  * DESCRIPTION: MP2Node class definition
  **********************************/
 #include "MP2Node.h"
+#include <errno.h>
 
 /**
  * constructor
@@ -13,14 +14,43 @@ MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log,
 	this->par = par;
 	this->emulNet = emulNet;
 	this->log = log;
-	ht = new HashTable();
 	this->memberNode->addr = *address;
+	int id;
+	memcpy(&id, &this->memberNode->addr.addr[0], sizeof(int));
+	readCache = NULL;
+	MessageView header;
+	char headerBuffer[MP2_SEND_BUFFER_SIZE];
+	header.type = BATCH;
+	header.fromAddr = this->memberNode->addr;
+	batchHeader.assign(headerBuffer, header.encode(headerBuffer, sizeof(headerBuffer)));
+	expiryWheel = new TimerWheel(this->par->getcurrtime());
+	if ( this->par->READ_CACHE_SIZE > 0 ) {
+		readCache = new ReadCache(this->par->READ_CACHE_SIZE, this->par->READ_CACHE_TTL);
+	}
+	ht = new PartitionedStore(this->par->STORAGE_ENGINE, this->par->DATA_DIR + "/node-" + to_string(id) + ".lsm");
+	if ( this->par->MEMORY_LIMIT > 0 ) {
+		ht->setMemoryLimit(this->par->MEMORY_LIMIT, this->par->EVICTION_POLICY);
+	}
+	if ( this->par->ORDERED_INDEX ) {
+		ht->setOrderedIndex(true);
+	}
+	if ( !this->par->SNAPSHOT_DIR.empty() ) {
+		// Serve the last snapshot of this node while it warms up, no reload needed
+		snapshotPath = this->par->SNAPSHOT_DIR + "/node-" + to_string(id) + ".snap";
+		ht->openSnapshot(snapshotPath);
+	}
+	if ( !this->par->WAL_DIR.empty() ) {
+		// Replay the mutations made since that snapshot from the log of this node
+		ht->openLog(this->par->WAL_DIR + "/node-" + to_string(id) + ".wal", this->par->WAL_SYNC_MS);
+	}
 }
 
 /**
  * Destructor
  */
 MP2Node::~MP2Node() {
+	delete readCache;
+	delete expiryWheel;
 	delete ht;
 	delete memberNode;
 }
@@ -93,10 +123,10 @@ vector<Node> MP2Node::getMembershipList() {
  * RETURNS:
  * size_t position on the ring
  */
-size_t MP2Node::hashFunction(string key) {
-	std::hash<string> hashFunc;
-	size_t ret = hashFunc(key);
-	return ret%RING_SIZE;
+size_t MP2Node::hashFunction(const Key &key) {
+	// The key was hashed once when it was built, its position also picks
+	// the partition of the local store that holds it
+	return PartitionedStore::positionOf(key);
 }
 
 /**
@@ -107,11 +137,16 @@ size_t MP2Node::hashFunction(string key) {
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
+ * 				A ttl above 0 makes the replicas drop the key that many
+ * 				time units after the write.
  */
-void MP2Node::clientCreate(string key, string value) {
+void MP2Node::clientCreate(const Key &key, string value, int ttl) {
 	// Increment the global transaction Id 
 	g_transID++;
 
+	// Reads coordinated here must not be served the value this write replaces
+	invalidateCachedRead(key);
+
 	// Get the repicas for the key
 	vector<Node> replicas = findNodes(key);
 
@@ -121,8 +156,10 @@ void MP2Node::clientCreate(string key, string value) {
 	for(auto &&node: replicas) {
 		// create message
 		Message createMsg = Message(g_transID, this->memberNode->addr, CREATE, key, value, ReplicaType(replicaType));
+		createMsg.version = Entry::makeVersion(this->par->getcurrtime(), g_transID);
+		createMsg.ttl = ttl;
 		// send message to emulnet
-		this->emulNet->ENsend(&memberNode->addr, &node.nodeAddress, (char*) &createMsg, sizeof(createMsg));
+		sendMessage(&node.nodeAddress, createMsg);
 		// increase to next ReplicaType
 		replicaType++;
 	}
@@ -138,10 +175,30 @@ void MP2Node::clientCreate(string key, string value) {
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientRead(string key){
+void MP2Node::clientRead(const Key &key){
 	// Increment the global transaction Id 
 	g_transID++;
 
+	// A hot key read lately is answered here, without asking the replicas
+	string cached;
+	if ( readCache != NULL && readCache->get(key, this->par->getcurrtime(), cached) ) {
+		this->log->logReadSuccess(&this->memberNode->addr, true, g_transID, key.toString(), cached);
+		return;
+	}
+
+	if ( readCache != NULL ) {
+		// Reads whose replies would be too old to serve by now are forgotten.
+		// transIDs grow with time, so they are the first in the map.
+		int now = this->par->getcurrtime();
+		while ( !pendingReads.empty() && pendingReads.begin()->second.issuedAt + this->par->READ_CACHE_TTL < now ) {
+			pendingReads.erase(pendingReads.begin());
+		}
+		PendingRead pending;
+		pending.key = key;
+		pending.issuedAt = now;
+		pendingReads[g_transID] = pending;
+	}
+
 	// Get the repicas for the key
 	vector<Node> replicas = findNodes(key);
 
@@ -151,7 +208,7 @@ void MP2Node::clientRead(string key){
 		// create message
 		Message readMsg = Message(g_transID, this->memberNode->addr, READ, key);
 		// send message to emulnet
-		this->emulNet->ENsend(&memberNode->addr, &node.nodeAddress, (char*) &readMsg, sizeof(readMsg));		
+		sendMessage(&node.nodeAddress, readMsg);		
 	}
 }
 
@@ -163,11 +220,16 @@ void MP2Node::clientRead(string key){
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
+ * 				A ttl above 0 makes the replicas drop the key that many
+ * 				time units after the write.
  */
-void MP2Node::clientUpdate(string key, string value){
+void MP2Node::clientUpdate(const Key &key, string value, int ttl){
 	// Increment the global transaction Id 
 	g_transID++;
 
+	// Reads coordinated here must not be served the value this write replaces
+	invalidateCachedRead(key);
+
 	// Get the repicas for the key
 	vector<Node> replicas = findNodes(key);
 
@@ -177,8 +239,10 @@ void MP2Node::clientUpdate(string key, string value){
 	for(auto &&node: replicas) {
 		// create message
 		Message updateMsg = Message(g_transID, this->memberNode->addr, UPDATE, key, value, ReplicaType(replicaType));
+		updateMsg.version = Entry::makeVersion(this->par->getcurrtime(), g_transID);
+		updateMsg.ttl = ttl;
 		// send message to emulnet
-		this->emulNet->ENsend(&memberNode->addr, &node.nodeAddress, (char*) &updateMsg, sizeof(updateMsg));
+		sendMessage(&node.nodeAddress, updateMsg);
 		// increase to next ReplicaType
 		replicaType++;
 	}
@@ -193,10 +257,13 @@ void MP2Node::clientUpdate(string key, string value){
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
  */
-void MP2Node::clientDelete(string key){
+void MP2Node::clientDelete(const Key &key){
 	// Increment the global transaction Id 
 	g_transID++;
 
+	// Reads coordinated here must not be served the value this write replaces
+	invalidateCachedRead(key);
+
 	// Get the repicas for the key
 	vector<Node> replicas = findNodes(key);
 
@@ -205,8 +272,197 @@ void MP2Node::clientDelete(string key){
 	for(auto &&node: replicas) {
 		// create message
 		Message deleteMsg = Message(g_transID, this->memberNode->addr, DELETE, key);
+		deleteMsg.version = Entry::makeVersion(this->par->getcurrtime(), g_transID);
 		// send message to emulnet
-		this->emulNet->ENsend(&memberNode->addr, &node.nodeAddress, (char*) &deleteMsg, sizeof(deleteMsg));
+		sendMessage(&node.nodeAddress, deleteMsg);
+	}
+}
+
+/**
+ * FUNCTION NAME: clientIncr
+ *
+ * DESCRIPTION: client side INCR API
+ * 				Adds delta to the counter stored under key, a missing key
+ * 				counts from 0. Each replica applies the increment to its own
+ * 				copy, so a bump costs a single round trip to the replicas.
+ */
+void MP2Node::clientIncr(const Key &key, long long delta) {
+	sendReadModifyWrite(INCR, key, to_string(delta), 0);
+}
+
+/**
+ * FUNCTION NAME: clientDecr
+ *
+ * DESCRIPTION: client side DECR API
+ * 				Subtracts delta from the counter stored under key, a missing
+ * 				key counts from 0
+ */
+void MP2Node::clientDecr(const Key &key, long long delta) {
+	sendReadModifyWrite(DECR, key, to_string(delta), 0);
+}
+
+/**
+ * FUNCTION NAME: clientAppend
+ *
+ * DESCRIPTION: client side APPEND API
+ * 				Adds suffix to the end of the value stored under key, a
+ * 				missing key is created with suffix as its value
+ */
+void MP2Node::clientAppend(const Key &key, string suffix) {
+	sendReadModifyWrite(APPEND, key, suffix, 0);
+}
+
+/**
+ * FUNCTION NAME: clientCompareAndSet
+ *
+ * DESCRIPTION: client side CAS API
+ * 				Replaces the value of key only where the version stored is
+ * 				expectedVersion. An expectedVersion of 0 creates the key only
+ * 				where it is missing.
+ */
+void MP2Node::clientCompareAndSet(const Key &key, string value, uint64_t expectedVersion) {
+	sendReadModifyWrite(CAS, key, value, expectedVersion);
+}
+
+/**
+ * FUNCTION NAME: sendReadModifyWrite
+ *
+ * DESCRIPTION: Sends a read-modify-write to the replicas of key.
+ * 				The function does the following:
+ * 				1) Constructs the message, with the version of the write
+ * 				2) Finds the replicas of this key
+ * 				3) Sends a message to the replica
+ */
+void MP2Node::sendReadModifyWrite(MessageType type, const Key &key, const string &operand, uint64_t expectedVersion) {
+	// Increment the global transaction Id
+	g_transID++;
+
+	// Reads coordinated here must not be served the value this write replaces
+	invalidateCachedRead(key);
+
+	// Get the repicas for the key
+	vector<Node> replicas = findNodes(key);
+
+	int replicaType = 0;
+	// Every replica stores the result under the same version, so a later
+	// compare-and-set sees the same version on all of them
+	uint64_t version = Entry::makeVersion(this->par->getcurrtime(), g_transID);
+	for(auto &&node: replicas) {
+		// create message
+		Message rmwMsg = Message(g_transID, this->memberNode->addr, type, key, operand, ReplicaType(replicaType), expectedVersion);
+		rmwMsg.version = version;
+		// send message to emulnet
+		sendMessage(&node.nodeAddress, rmwMsg);
+		// increase to next ReplicaType
+		replicaType++;
+	}
+}
+
+/**
+ * FUNCTION NAME: sendMessage
+ *
+ * DESCRIPTION: Serializes msg and sends it to toAddr. A message that fits is
+ * 				encoded on the stack, only a large value needs a heap buffer.
+ */
+void MP2Node::sendMessage(Address *toAddr, const Message &msg) {
+	char stackBuffer[MP2_SEND_BUFFER_SIZE];
+	vector<char> heapBuffer;
+	char *buffer = stackBuffer;
+	if ( msg.encodedSizeBound() > sizeof(stackBuffer) ) {
+		heapBuffer.resize(msg.encodedSizeBound());
+		buffer = &heapBuffer[0];
+	}
+	size_t size = msg.encode(buffer);
+	queueMessage(toAddr, buffer, size);
+}
+
+/**
+ * FUNCTION NAME: addressKey
+ *
+ * DESCRIPTION: Returns the bytes of addr as one integer, to key maps by node
+ */
+uint64_t MP2Node::addressKey(const Address &addr) {
+	uint64_t key = 0;
+	memcpy(&key, addr.addr, sizeof(addr.addr));
+	return key;
+}
+
+/**
+ * FUNCTION NAME: batchCapacity
+ *
+ * DESCRIPTION: Returns the most bytes one message may take for EmulNet to
+ * 				deliver it
+ */
+size_t MP2Node::batchCapacity() {
+	return this->par->MAX_MSG_SIZE - sizeof(en_msg) - 1;
+}
+
+/**
+ * FUNCTION NAME: queueMessage
+ *
+ * DESCRIPTION: Adds the encoded message [data, data + size) to the batch of
+ * 				toAddr, sending the batch first if the message would not fit.
+ * 				The batches go out in flushBatches at the end of the time
+ * 				unit, so each node gets one EmulNet message per time unit
+ * 				instead of one per request. A message too large to share a
+ * 				batch, or any message with BATCH_MESSAGES off, is sent at once.
+ */
+void MP2Node::queueMessage(Address *toAddr, const char *data, size_t size) {
+	size_t capacity = batchCapacity();
+	if ( !this->par->BATCH_MESSAGES || batchHeader.size() + MAX_VARINT_SIZE + size > capacity ) {
+		this->emulNet->ENsend(&this->memberNode->addr, toAddr, (char *)data, (int)size);
+		return;
+	}
+	OutgoingBatch &batch = outBatches[addressKey(*toAddr)];
+	if ( batch.count > 0 && batch.bytes.size() + varintLength(size) + size > capacity ) {
+		flushBatch(batch);
+	}
+	if ( batch.count == 0 ) {
+		batch.toAddr = *toAddr;
+		batch.bytes.assign(batchHeader);
+		batch.firstSize = size;
+	}
+	char prefix[MAX_VARINT_SIZE];
+	batch.bytes.append(prefix, encodeVarint(prefix, size) - prefix);
+	batch.bytes.append(data, size);
+	batch.count++;
+}
+
+/**
+ * FUNCTION NAME: flushBatch
+ *
+ * DESCRIPTION: Sends the messages waiting in batch and empties it. A single
+ * 				message is sent as it is, without the BATCH around it.
+ */
+void MP2Node::flushBatch(OutgoingBatch &batch) {
+	if ( batch.count == 1 ) {
+		size_t offset = batchHeader.size() + varintLength(batch.firstSize);
+		this->emulNet->ENsend(&this->memberNode->addr, &batch.toAddr, &batch.bytes[offset], (int)batch.firstSize);
+	}
+	else if ( batch.count > 1 ) {
+		this->emulNet->ENsend(&this->memberNode->addr, &batch.toAddr, &batch.bytes[0], (int)batch.bytes.size());
+	}
+	batch.bytes.clear();
+	batch.count = 0;
+}
+
+/**
+ * FUNCTION NAME: flushBatches
+ *
+ * DESCRIPTION: Sends the messages queued this time unit, called once per time
+ * 				unit after every message and client request was handled.
+ * 				A failed node drops what it queued.
+ */
+void MP2Node::flushBatches() {
+	map<uint64_t, OutgoingBatch>::iterator it;
+	for ( it = outBatches.begin(); it != outBatches.end(); it++ ) {
+		if ( this->memberNode->bFailed ) {
+			it->second.bytes.clear();
+			it->second.count = 0;
+		}
+		else {
+			flushBatch(it->second);
+		}
 	}
 }
 
@@ -215,12 +471,18 @@ void MP2Node::clientDelete(string key){
  *
  * DESCRIPTION: Server side CREATE API
  * 			   	The function does the following:
- * 			   	1) Inserts key value into the local hash table
- * 			   	2) Return true or false based on success or failure
+ * 			   	1) Inserts key value into the local hash table, the write
+ * 			   	   with the highest version wins if the key exists
+ * 			   	2) Schedules the expiry of the write if it has a ttl
+ * 			   	3) Return true or false based on success or failure
  */
-bool MP2Node::createKeyValue(string key, string value, ReplicaType replica) {
+bool MP2Node::createKeyValue(const Key &key, const string &value, ReplicaType replica, uint64_t version, int ttl) {
 	// Insert key, value, replicaType into the hash table
-	return ht->create(key, value);
+	bool isSuccess = ht->create(key, Entry(value, version, replica));
+	if ( isSuccess && ttl > 0 ) {
+		expiryWheel->schedule(key, version, this->par->getcurrtime() + ttl);
+	}
+	return isSuccess;
 }
 
 /**
@@ -231,22 +493,96 @@ bool MP2Node::createKeyValue(string key, string value, ReplicaType replica) {
  * 			    1) Read key from local hash table
  * 			    2) Return value
  */
-string MP2Node::readKey(string key) {
+string MP2Node::readKey(const Key &key) {
+	// The filter answers most reads of missing keys without a lookup
+	if ( !ht->mayContain(key) ) {
+		return "";
+	}
 	// Read key from local hash table and return value
 	return ht->read(key);
 }
 
+/**
+ * FUNCTION NAME: filterStats
+ *
+ * DESCRIPTION: Returns how the filters of the local store did on missing keys,
+ * 				falsePositiveRate() of the result is the false positive rate
+ */
+BloomStats MP2Node::filterStats() {
+	return ht->filterStats();
+}
+
+/**
+ * FUNCTION NAME: invalidateCachedRead
+ *
+ * DESCRIPTION: Drops the cached value of key and forgets the reads of key in
+ * 				flight, as a write coordinated here may change it
+ */
+void MP2Node::invalidateCachedRead(const Key &key) {
+	if ( readCache == NULL ) {
+		return;
+	}
+	readCache->invalidate(key);
+	map<int, PendingRead>::iterator it = pendingReads.begin();
+	while ( it != pendingReads.end() ) {
+		if ( it->second.key == key ) {
+			pendingReads.erase(it++);
+		}
+		else {
+			it++;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: fillReadCache
+ *
+ * DESCRIPTION: Caches the value of a READREPLY if it is the first successful
+ * 				reply to a read still pending here. Replies to writes and
+ * 				read-modify-writes, later replies to the same read and replies
+ * 				to reads sent before a write of the key are not cached.
+ */
+void MP2Node::fillReadCache(const MessageView &msg) {
+	string value;
+	if ( readCache == NULL || !msg.success() ) {
+		return;
+	}
+	map<int, PendingRead>::iterator it = pendingReads.find(msg.transID);
+	if ( it == pendingReads.end() || !(it->second.key == Key(msg.key)) ) {
+		return;
+	}
+	pendingReads.erase(it);
+	if ( msg.copyValue(value) ) {
+		readCache->put(Key(msg.key), value, this->par->getcurrtime());
+	}
+}
+
+/**
+ * FUNCTION NAME: readCacheHitRatio
+ *
+ * DESCRIPTION: Returns the share of the reads coordinated here that the read cache answered
+ */
+double MP2Node::readCacheHitRatio() {
+	return readCache == NULL ? 0.0 : readCache->hitRatio();
+}
+
 /**
  * FUNCTION NAME: updateKeyValue
  *
  * DESCRIPTION: Server side UPDATE API
  * 				This function does the following:
  * 				1) Update the key to the new value in the local hash table
- * 				2) Return true or false based on success or failure
+ * 				   unless a newer version is already stored
+ * 				2) Schedules the expiry of the write if it has a ttl
+ * 				3) Return true or false based on success or failure
  */
-bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica) {
+bool MP2Node::updateKeyValue(const Key &key, const string &value, ReplicaType replica, uint64_t version, int ttl) {
 	// Update key in local hash table and return true or false
-	return ht->update(key, value);
+	bool isSuccess = ht->update(key, Entry(value, version, replica));
+	if ( isSuccess && ttl > 0 ) {
+		expiryWheel->schedule(key, version, this->par->getcurrtime() + ttl);
+	}
+	return isSuccess;
 }
 
 /**
@@ -254,12 +590,159 @@ bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica) {
  *
  * DESCRIPTION: Server side DELETE API
  * 				This function does the following:
- * 				1) Delete the key from the local hash table
+ * 				1) Delete the key from the local hash table, leaving a tombstone
+ * 				   with the version of the delete
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::deletekey(string key) {
+bool MP2Node::deletekey(const Key &key, uint64_t version) {
 	// Delete the key from the local hash table and return true of false
-	return ht->deleteKey(key);
+	return ht->deleteKey(key, version, this->par->getcurrtime());
+}
+
+/**
+ * FUNCTION NAME: readModifyWrite
+ *
+ * DESCRIPTION: Server side INCR, DECR, APPEND and CAS API
+ * 				This function does the following:
+ * 				1) Reads the live value of key from the local hash table
+ * 				2) Computes the new value from it and the operand
+ * 				3) Stores the new value under version, which only lands if
+ * 				   no newer write is stored
+ * 				Messages are handled one at a time, no other write gets in
+ * 				between the read and the write.
+ *
+ * RETURNS:
+ * true and the new value in result on success
+ * false if the stored value is no counter, a CAS finds another version, or a
+ * newer write is stored
+ */
+bool MP2Node::readModifyWrite(MessageType type, const Key &key, const string &operand, uint64_t expectedVersion, ReplicaType replica, uint64_t version, string &result) {
+	Entry current;
+	bool found = ht->readEntry(key, current);
+
+	switch ( type ) {
+		case INCR:
+		case DECR: {
+			long long counter = 0;
+			long long delta;
+			if ( (found && !parseCounter(current.value, counter)) || !parseCounter(operand, delta) ) {
+				return false;
+			}
+			// Counters wrap around rather than overflow
+			unsigned long long next = (unsigned long long)counter;
+			next = type == INCR ? next + (unsigned long long)delta : next - (unsigned long long)delta;
+			result = to_string((long long)next);
+			break;
+		}
+		case APPEND:
+			result = found ? current.value + operand : operand;
+			break;
+		case CAS:
+			if ( (found ? current.version : 0) != expectedVersion ) {
+				return false;
+			}
+			result = operand;
+			break;
+		default:
+			return false;
+	}
+	// create stores over a live key or a tombstone as long as version is newer
+	return ht->create(key, Entry(result, version, replica));
+}
+
+/**
+ * FUNCTION NAME: parseCounter
+ *
+ * DESCRIPTION: Reads text as a decimal counter
+ *
+ * RETURNS:
+ * false if text is not a whole number that fits in a long long
+ */
+bool MP2Node::parseCounter(const string &text, long long &counter) {
+	char *end;
+	if ( text.empty() ) {
+		return false;
+	}
+	errno = 0;
+	counter = strtoll(text.c_str(), &end, 10);
+	return errno == 0 && *end == '\0';
+}
+
+/**
+ * FUNCTION NAME: runCompaction
+ *
+ * DESCRIPTION: Background maintenance of the local hash table.
+ * 				Drops tombstones older than the grace period, looking at no more than
+ * 				COMPACTION_BUDGET slots so a pass never holds up message handling.
+ */
+void MP2Node::runCompaction() {
+	ht->compact(this->par->getcurrtime(), this->par->TOMBSTONE_GRACE, this->par->COMPACTION_BUDGET);
+}
+
+/**
+ * FUNCTION NAME: syncLog
+ *
+ * DESCRIPTION: Group commit of the write ahead log. All mutations of this time unit
+ * 				are made durable with a single sync.
+ */
+void MP2Node::syncLog() {
+	ht->syncLog();
+}
+
+/**
+ * FUNCTION NAME: runExpiry
+ *
+ * DESCRIPTION: Advances the expiry wheel to the current time and deletes the keys whose
+ * 				ttl ran out. Each replica expires its own copy, no messages are sent.
+ * 				The tombstone carries the version of the expiring write, so a key
+ * 				written again since then is left alone.
+ */
+void MP2Node::runExpiry() {
+	vector<ExpiryTimer> expired;
+	int now = this->par->getcurrtime();
+	expiryWheel->advance(now, expired);
+	for ( size_t i = 0; i < expired.size(); i++ ) {
+		ht->deleteKey(expired[i].key, expired[i].version, now);
+	}
+}
+
+/**
+ * FUNCTION NAME: logStats
+ *
+ * DESCRIPTION: Every STATS_INTERVAL time units writes the size and memory use of
+ * 				the local store to the stats log, along with the filter false
+ * 				positive rate and the read cache hit ratio
+ */
+void MP2Node::logStats() {
+	if ( this->par->STATS_INTERVAL <= 0 || this->par->getcurrtime() % this->par->STATS_INTERVAL != 0 ) {
+		return;
+	}
+	unsigned long live, tombstones;
+	MemoryUsage usage = ht->memoryUsage();
+	ht->countKeys(live, tombstones);
+	this->log->LOG(&this->memberNode->addr,
+			"#STATSLOG# keys=%lu tombstones=%lu memory=%lu limit=%lu keyBytes=%lu valueBytes=%lu "
+			"metadataBytes=%lu arenaBytes=%lu evictions=%lu filterFPR=%.4f readCacheHitRatio=%.3f",
+			live, tombstones, usage.total(), usage.limitBytes, usage.keyBytes,
+			usage.valueBytes, usage.metadataBytes, usage.arenaBytes, usage.evictions,
+			filterStats().falsePositiveRate(), readCacheHitRatio());
+}
+
+/**
+ * FUNCTION NAME: runSnapshot
+ *
+ * DESCRIPTION: Loads up to WARM_BUDGET more records of the snapshot the node started
+ * 				from, and every SNAPSHOT_INTERVAL time units writes a new snapshot,
+ * 				which lets the write ahead log start over.
+ */
+void MP2Node::runSnapshot() {
+	if ( snapshotPath.empty() ) {
+		return;
+	}
+	ht->warmSnapshot(this->par->WARM_BUDGET);
+	if ( this->par->SNAPSHOT_INTERVAL > 0 && this->par->getcurrtime() % this->par->SNAPSHOT_INTERVAL == 0 ) {
+		ht->dumpSnapshot(snapshotPath);
+	}
 }
 
 /**
@@ -268,7 +751,7 @@ bool MP2Node::deletekey(string key) {
  * the transactionId that is used as the unique identifier when emplacing the transactionData 
  * into the transactionHistory map.
  */
-void MP2Node::addTransactionHistory(string k, string v, MessageType msgType, int transId) {
+void MP2Node::addTransactionHistory(const Key &k, string v, MessageType msgType, int transId) {
 	TransactionData td;
 	td.key = k;
 	td.value = v;
@@ -308,118 +791,21 @@ void MP2Node::checkMessages() {
 		size = memberNode->mp2q.front().size;
 		memberNode->mp2q.pop();
 
-		string message(data, data + size);
-
 		/*
 		 * Handle the message types here
 		 */
-	
-		// Need to have a default constructor
-		//WrapperMessage curMsg;
-		//memcpy(&curMsg, data, size);
-		Message curMsg(message);
-		// http://www.cplusplus.com/forum/general/68994/
-		switch(curMsg.type) {
-			// When here node is replica.
-			case CREATE: {
-				Message replyMsg = curMsg;
-				//Message replyMsg = curMsg;
-				// Insert the message (createKeyValue).
-				bool isSuccess = createKeyValue(curMsg.key, curMsg.value, curMsg.replica);
-				//replyMsg.msgMeta.timeStamp = this->par->getcurrtime();
-				// Log the success or failure of the message.  This is not the coordinator as it is getting message from coordinator.
-				if(isSuccess) {
-					this->log->logCreateSuccess(&this->memberNode->addr, false, curMsg.transID, curMsg.key, curMsg.value);
-				} else {
-					this->log->logCreateFail(&this->memberNode->addr, false, curMsg.transID, curMsg.key, curMsg.value);
-				}
-				// Create message of type REPLY
-				// so reply message can be explicit by type instead of implicit by parameters.
-				// Message newMsg = Message(curMsg.transID, this->memberNode->addr, isSuccess);  
-				// Create a new message based on the current message that was received.
-				// Update the messageType to reply
-				replyMsg.type = REPLY;
-				//newMsg.msgData.fromAddr = this->memberNode->addr;
-				// newMsg.msgMeta.transID = 
-				// send it back to the fromAddr.
-				this->emulNet->ENsend(&this->memberNode->addr, &replyMsg.fromAddr, (char *)&replyMsg, (int)sizeof(replyMsg));
-				addTransactionHistory(replyMsg.key, replyMsg.value, replyMsg.type, replyMsg.transID);
-				break;
-			} 
-			// When here node is replica.
-			case READ: {
-				// Get the value of the key in the hash table
-				//WrapperMessage replyMsg = curMsg;
-				Message replyMsg = curMsg;
-				replyMsg.type = READREPLY;
-				string retValue = readKey(curMsg.key);
-				replyMsg.value = retValue;
-				if(retValue == "") {
-					// Handle no key
-					replyMsg.success = false;
-					this->log->logReadFail(&this->memberNode->addr, false, curMsg.transID, curMsg.key);
-				} else {
-					// Handle the value
-					replyMsg.success = true;
-					this->log->logReadSuccess(&this->memberNode->addr, false, curMsg.transID, curMsg.key, curMsg.value);
-				}
-				//replyMsg.msgMeta.timeStamp = this->par->getcurrtime();
-				// Send message back to the user with returned value and READREPLY msgType
-				this->emulNet->ENsend(&this->memberNode->addr, &replyMsg.fromAddr, (char *)&replyMsg, (int)sizeof(replyMsg));
-				addTransactionHistory(replyMsg.key, replyMsg.value, replyMsg.type, replyMsg.transID);
-				break;
+		MessageView view;
+		if ( view.parse(data, size) ) {
+			if ( view.type == BATCH ) {
+				handleBatch(view);
 			}
-			// When here node is replica.
-			case UPDATE: {
-				bool isSuccess = updateKeyValue(curMsg.key, curMsg.value, curMsg.replica);
-				//WrapperMessage replyMsg = curMsg;
-				Message replyMsg = curMsg;
-				// replyMsg.msgMeta.msgType = REPLY;
-				// replyMsg.msgMeta.success = isSuccess;
-				// replyMsg.msgMeta.timeStamp = this->par->getcurrtime();
-				if(isSuccess) {
-					this->log->logUpdateSuccess(&this->memberNode->addr, false, curMsg.transID, curMsg.key, curMsg.value);
-				} else {
-					this->log->logUpdateFail(&this->memberNode->addr, false, curMsg.transID, curMsg.key, curMsg.value);
-				}
-
-				this->emulNet->ENsend(&this->memberNode->addr, &replyMsg.fromAddr, (char *)&replyMsg, (int)sizeof(replyMsg));
-				addTransactionHistory(replyMsg.key, replyMsg.value, replyMsg.type, replyMsg.transID);
-			}
-			// When here node is replica.
-			case DELETE: {
-				bool isSuccess = createKeyValue(curMsg.key, curMsg.value, curMsg.replica);
-				Message replyMsg = curMsg;
-				replyMsg.type = REPLY;
-				replyMsg.success = isSuccess;
-				//replyMsg.timeStamp = this->par->getcurrtime();
-				if(isSuccess) {
-					this->log->logDeleteSuccess(&this->memberNode->addr, false, curMsg.transID, curMsg.key);
-				} else {
-					this->log->logDeleteFail(&this->memberNode->addr, false, curMsg.transID, curMsg.key);
-				}
-				this->emulNet->ENsend(&this->memberNode->addr, &replyMsg.fromAddr, (char *)&replyMsg, (int)sizeof(replyMsg));
-				addTransactionHistory(replyMsg.key, replyMsg.value, replyMsg.type, replyMsg.transID);
-				break;
-			}
-			// When here node is coordinator.
-			case REPLY: {
-				// Check for quorum for the transID of the reply for updates.
-				//WrapperMessage replyMsg = curMsg;
-				Message replyMsg = curMsg;
-				this->emulNet->ENsend(&this->memberNode->addr, &replyMsg.fromAddr, (char *)&replyMsg, (int)sizeof(replyMsg));
-			}
-			// When here node is coordinator.
-			case READREPLY: {
-				// Check for quorum for the transID of the read-reply for reads.
-				// Create helper method for checking for quorum.  Shouldn't have code directly in READREPLY or REPLY cases.
-				// WrapperMessage replyMsg = curMsg;
-				Message replyMsg = curMsg;
-				this->emulNet->ENsend(&this->memberNode->addr, &replyMsg.fromAddr, (char *)&replyMsg, (int)sizeof(replyMsg));
+			else {
+				handleMessage(view, data, size);
 			}
 		}
-
-
+		// A damaged message is dropped, the coordinator times the request out.
+		// The view is gone now, so the buffer can go too.
+		free(data);
 	}
 
 	/*
@@ -428,6 +814,159 @@ void MP2Node::checkMessages() {
 	 */
 }
 
+/**
+ * FUNCTION NAME: handleMessage
+ *
+ * DESCRIPTION: Handles one message, parsed in place over the received buffer
+ * 				[data, data + size). Keys and values are only copied out of
+ * 				the buffer where they are stored or logged.
+ */
+void MP2Node::handleMessage(const MessageView &msg, const char *data, int size) {
+	switch(msg.type) {
+		// When here node is replica.
+		case CREATE: {
+			Key key(msg.key);
+			string value;
+			// Insert the message (createKeyValue).
+			bool isSuccess = msg.copyValue(value) && createKeyValue(key, value, msg.replica, msg.version, msg.ttl);
+			// Log the success or failure of the message.  This is not the coordinator as it is getting message from coordinator.
+			if(isSuccess) {
+				this->log->logCreateSuccess(&this->memberNode->addr, false, msg.transID, key.toString(), value);
+			} else {
+				this->log->logCreateFail(&this->memberNode->addr, false, msg.transID, key.toString(), value);
+			}
+			// Create message of type REPLY and send it back to the fromAddr.
+			Message replyMsg(msg.transID, msg.fromAddr, REPLY, isSuccess);
+			sendMessage(&replyMsg.fromAddr, replyMsg);
+			addTransactionHistory(key, value, REPLY, msg.transID);
+			break;
+		}
+		// When here node is replica.
+		case READ: {
+			// Get the value of the key in the hash table
+			Key key(msg.key);
+			string retValue = readKey(key);
+			Message replyMsg(msg.transID, msg.fromAddr, retValue);
+			replyMsg.key = key;
+			if(retValue == "") {
+				// Handle no key
+				replyMsg.success = false;
+				this->log->logReadFail(&this->memberNode->addr, false, msg.transID, key.toString());
+			} else {
+				// Handle the value
+				replyMsg.success = true;
+				this->log->logReadSuccess(&this->memberNode->addr, false, msg.transID, key.toString(), retValue);
+			}
+			// Send message back to the user with returned value and READREPLY msgType
+			sendMessage(&replyMsg.fromAddr, replyMsg);
+			addTransactionHistory(key, retValue, READREPLY, msg.transID);
+			break;
+		}
+		// When here node is replica.
+		case UPDATE: {
+			Key key(msg.key);
+			string value;
+			bool isSuccess = msg.copyValue(value) && updateKeyValue(key, value, msg.replica, msg.version, msg.ttl);
+			if(isSuccess) {
+				this->log->logUpdateSuccess(&this->memberNode->addr, false, msg.transID, key.toString(), value);
+			} else {
+				this->log->logUpdateFail(&this->memberNode->addr, false, msg.transID, key.toString(), value);
+			}
+			Message replyMsg(msg.transID, msg.fromAddr, REPLY, isSuccess);
+			sendMessage(&replyMsg.fromAddr, replyMsg);
+			addTransactionHistory(key, value, REPLY, msg.transID);
+			break;
+		}
+		// When here node is replica.
+		case DELETE: {
+			Key key(msg.key);
+			bool isSuccess = deletekey(key, msg.version);
+			if(isSuccess) {
+				this->log->logDeleteSuccess(&this->memberNode->addr, false, msg.transID, key.toString());
+			} else {
+				this->log->logDeleteFail(&this->memberNode->addr, false, msg.transID, key.toString());
+			}
+			Message replyMsg(msg.transID, msg.fromAddr, REPLY, isSuccess);
+			sendMessage(&replyMsg.fromAddr, replyMsg);
+			addTransactionHistory(key, "", REPLY, msg.transID);
+			break;
+		}
+		// When here node is replica.
+		case INCR:
+		case DECR:
+		case APPEND:
+		case CAS: {
+			Key key(msg.key);
+			string operand;
+			string result;
+			bool isSuccess = msg.copyValue(operand) && readModifyWrite(msg.type, key, operand, msg.expectedVersion, msg.replica, msg.version, result);
+			Message replyMsg(msg.transID, msg.fromAddr, REPLY, isSuccess);
+			if(isSuccess) {
+				// The coordinator gets the new value back, no read needed
+				replyMsg.type = READREPLY;
+				replyMsg.key = key;
+				replyMsg.value = result;
+				this->log->logUpdateSuccess(&this->memberNode->addr, false, msg.transID, key.toString(), result);
+			} else {
+				this->log->logUpdateFail(&this->memberNode->addr, false, msg.transID, key.toString(), operand);
+			}
+			sendMessage(&replyMsg.fromAddr, replyMsg);
+			addTransactionHistory(key, result, replyMsg.type, msg.transID);
+			break;
+		}
+		// When here node is coordinator.
+		case REPLY: {
+			// Check for quorum for the transID of the reply for updates.
+			// The reply is passed on as it came, no need to serialize it again.
+			// A reply to this node is not sent to itself again.
+			Address toAddr = msg.fromAddr;
+			if ( !(toAddr == this->memberNode->addr) ) {
+				queueMessage(&toAddr, data, size);
+			}
+			break;
+		}
+		// When here node is coordinator.
+		case READREPLY: {
+			// Check for quorum for the transID of the read-reply for reads.
+			// Create helper method for checking for quorum.  Shouldn't have code directly in READREPLY or REPLY cases.
+			fillReadCache(msg);
+			Address toAddr = msg.fromAddr;
+			if ( !(toAddr == this->memberNode->addr) ) {
+				queueMessage(&toAddr, data, size);
+			}
+			break;
+		}
+		// Batches are unpacked by checkMessages, never nested
+		case BATCH:
+			break;
+	}
+}
+
+/**
+ * FUNCTION NAME: handleBatch
+ *
+ * DESCRIPTION: Handles the messages of a BATCH one by one, each parsed in
+ * 				place like a message received alone. The replies they cause
+ * 				are batched again for the next flush.
+ */
+void MP2Node::handleBatch(const MessageView &batch) {
+	const char *ptr = batch.value.data;
+	const char *limit = ptr + batch.value.size;
+	while ( ptr < limit ) {
+		uint64_t size;
+		ptr = getVarint(ptr, limit, size);
+		if ( ptr == NULL || size > (uint64_t)(limit - ptr) ) {
+			// The rest of a damaged batch is dropped
+			return;
+		}
+		MessageView msg;
+		if ( msg.parse(ptr, size) && msg.type != BATCH ) {
+			handleMessage(msg, ptr, (int)size);
+		}
+		ptr += size;
+	}
+}
+
 /**
  * FUNCTION NAME: checkForQuorum
  * 
@@ -449,7 +988,7 @@ void checkForQuorum(WrapperMessage *msg) {
  * DESCRIPTION: Find the replicas of the given keyfunction
  * 				This function is responsible for finding the replicas of a key
  */
-vector<Node> MP2Node::findNodes(string key) {
+vector<Node> MP2Node::findNodes(const Key &key) {
 	size_t pos = hashFunction(key);
 	vector<Node> addr_vec;
 	if (ring.size() >= 3) {
@@ -13,13 +13,21 @@
 #include "stdincludes.h"
 #include "EmulNet.h"
 #include "Node.h"
-#include "HashTable.h"
+#include "PartitionedStore.h"
+#include "ReadCache.h"
+#include "TimerWheel.h"
 #include "Log.h"
 #include "Params.h"
 #include "Message.h"
 #include "Queue.h"
 #include "Params.h"
 
+/*
+ * Macros
+ */
+// bytes a message is encoded into on the stack, larger ones go to the heap
+#define MP2_SEND_BUFFER_SIZE 1024
+
 /**
  * This is a struct that is used to hold all required data for a specific transaction.  
  * This is helpful for determining a quorum.  Given that messages are asynchronous they will not necessarily
@@ -28,7 +36,7 @@
  */
 typedef struct TransactionData {
 	MessageType msgType;
-	string key;
+	Key key;
 	string value;
 	int failureReplyCount;
 	int successReplyCount;
@@ -40,6 +48,33 @@ typedef struct TransactionData {
 	long timeStamp;
 } TransactionData;
 
+/**
+ * STRUCT NAME: OutgoingBatch
+ *
+ * DESCRIPTION: Messages waiting to go to one node as a single BATCH message,
+ * 				sent when the time unit ends or the next one would not fit
+ */
+typedef struct OutgoingBatch {
+	Address toAddr;
+	// BATCH header followed by the messages, each length prefixed
+	string bytes;
+	int count;
+	// size of the first message, sent alone if no other joins it
+	size_t firstSize;
+	OutgoingBatch(): count(0), firstSize(0) {}
+} OutgoingBatch;
+
+/**
+ * STRUCT NAME: PendingRead
+ *
+ * DESCRIPTION: A read sent to the replicas whose first successful reply may
+ * 				fill the read cache
+ */
+typedef struct PendingRead {
+	Key key;
+	int issuedAt;
+} PendingRead;
+
 class MessageMetadata {
 	public:
 		MessageType msgType;
@@ -52,12 +87,12 @@ class MessageMetadata {
 
 class MessageData {
 	public:
-		string key;
+		Key key;
 		string value;
 		Address fromAddr;	
 		MessageData();
-		MessageData(string k, string v): key(k), value(v) { }
-		MessageData(string k, string v, Address addr): key(k), value(v), fromAddr(addr) { }
+		MessageData(const Key &k, string v): key(k), value(v) { }
+		MessageData(const Key &k, string v, Address addr): key(k), value(v), fromAddr(addr) { }
 };
 
 // Wrapper class for the message and added function
@@ -89,8 +124,9 @@ private:
 	vector<Node> haveReplicasOf;
 	// Ring
 	vector<Node> ring;
-	// Hash Table
-	HashTable * ht;
+	// Local key value store, one partition per ring position, each an engine
+	// of the type STORAGE_ENGINE names
+	PartitionedStore * ht;
 	// Member representing this member
 	Member *memberNode;
 	// Params object
@@ -101,6 +137,26 @@ private:
 	Log * log;
 	// A mapping of all the different data for each transaction
 	map<int, TransactionData> transactionHistory;
+	// File the local hash table is snapshotted to, empty to take no snapshots
+	string snapshotPath;
+	// Results of reads this node coordinated, NULL when READ_CACHE_SIZE is 0
+	ReadCache *readCache;
+	// Deadlines of the writes stored here that carry a ttl
+	TimerWheel *expiryWheel;
+	// Reads this node coordinates that may fill readCache, by transID. A write
+	// of the key drops them, so a reply read before the write is not cached.
+	map<int, PendingRead> pendingReads;
+	// Messages waiting to be sent, by the address of the node they go to
+	map<uint64_t, OutgoingBatch> outBatches;
+	// Header of every BATCH message this node sends
+	string batchHeader;
+
+	static uint64_t addressKey(const Address &addr);
+	size_t batchCapacity();
+	void queueMessage(Address *toAddr, const char *data, size_t size);
+	void flushBatch(OutgoingBatch &batch);
+	void invalidateCachedRead(const Key &key);
+	void fillReadCache(const MessageView &msg);
 
 public:
 	MP2Node(Member *memberNode, Params *par, EmulNet *emulNet, Log *log, Address *addressOfMember);
@@ -111,14 +167,23 @@ public:
 	// ring functionalities
 	void updateRing();
 	vector<Node> getMembershipList();
-	size_t hashFunction(string key);
+	size_t hashFunction(const Key &key);
 	void findNeighbors();
 
 	// client side CRUD APIs
-	void clientCreate(string key, string value);
-	void clientRead(string key);
-	void clientUpdate(string key, string value);
-	void clientDelete(string key);
+	void clientCreate(const Key &key, string value, int ttl = 0);
+	void clientRead(const Key &key);
+	void clientUpdate(const Key &key, string value, int ttl = 0);
+	void clientDelete(const Key &key);
+
+	// client side read-modify-write APIs, one quorum round trip each
+	void clientIncr(const Key &key, long long delta);
+	void clientDecr(const Key &key, long long delta);
+	void clientAppend(const Key &key, string suffix);
+	void clientCompareAndSet(const Key &key, string value, uint64_t expectedVersion);
+	void sendReadModifyWrite(MessageType type, const Key &key, const string &operand, uint64_t expectedVersion);
+	void sendMessage(Address *toAddr, const Message &msg);
+	void flushBatches();
 
 	// receive messages from Emulnet
 	bool recvLoop();
@@ -126,23 +191,36 @@ public:
 
 	// handle messages from receiving queue
 	void checkMessages();
+	void handleMessage(const MessageView &msg, const char *data, int size);
+	void handleBatch(const MessageView &batch);
 
 	// coordinator dispatches messages to corresponding nodes
 	void dispatchMessages(Message message);
 
 	// find the addresses of nodes that are responsible for a key
-	vector<Node> findNodes(string key);
+	vector<Node> findNodes(const Key &key);
 
 	// server
-	bool createKeyValue(string key, string value, ReplicaType replica);
-	string readKey(string key);
-	bool updateKeyValue(string key, string value, ReplicaType replica);
-	bool deletekey(string key);
+	bool createKeyValue(const Key &key, const string &value, ReplicaType replica, uint64_t version = 0, int ttl = 0);
+	string readKey(const Key &key);
+	bool updateKeyValue(const Key &key, const string &value, ReplicaType replica, uint64_t version = 0, int ttl = 0);
+	bool deletekey(const Key &key, uint64_t version = 0);
+	bool readModifyWrite(MessageType type, const Key &key, const string &operand, uint64_t expectedVersion, ReplicaType replica, uint64_t version, string &result);
+	static bool parseCounter(const string &text, long long &counter);
+	BloomStats filterStats();
+	double readCacheHitRatio();
 
 	// stabilization protocol - handle multiple failures
 	void stabilizationProtocol();
 
-	void addTransactionHistory(string key, string value, MessageType msgType, int transId);
+	// background maintenance
+	void runCompaction();
+	void syncLog();
+	void runSnapshot();
+	void runExpiry();
+	void logStats();
+
+	void addTransactionHistory(const Key &key, string value, MessageType msgType, int transId);
 
 	~MP2Node();
 };
@@ -0,0 +1,136 @@
+/**********************************
+ * FILE NAME: MerkleTree.cpp
+ *
+ * DESCRIPTION: Definition of the hash tree replicas compare a partition with
+ **********************************/
+
+#include "MerkleTree.h"
+
+/**
+ * Constructor
+ */
+MerkleTree::MerkleTree() {
+	clear();
+}
+
+/**
+ * FUNCTION NAME: leafOf
+ *
+ * DESCRIPTION: Returns the leaf of key, from the top bits of its hash
+ */
+size_t MerkleTree::leafOf(const Key &key) {
+	return (size_t)(key.hash() >> (64 - MERKLE_DEPTH));
+}
+
+/**
+ * FUNCTION NAME: digest
+ *
+ * DESCRIPTION: Returns the digest of one version of a key. Versions are unique
+ * 				per write, so the value does not need to be hashed.
+ */
+uint64_t MerkleTree::digest(const Key &key, uint64_t version) {
+	uint64_t words[2] = { key.hash(), version };
+	return hashBytes((const char *)words, sizeof(words));
+}
+
+/**
+ * FUNCTION NAME: combine
+ *
+ * DESCRIPTION: Returns the hash of an inner node from the hashes of its children
+ */
+uint64_t MerkleTree::combine(uint64_t left, uint64_t right) {
+	uint64_t words[2] = { left, right };
+	return hashBytes((const char *)words, sizeof(words));
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Adds a version of key that became live
+ */
+void MerkleTree::add(const Key &key, uint64_t version) {
+	toggle(key, version);
+}
+
+/**
+ * FUNCTION NAME: remove
+ *
+ * DESCRIPTION: Removes a version of key that was overwritten or deleted
+ */
+void MerkleTree::remove(const Key &key, uint64_t version) {
+	// xor is its own inverse
+	toggle(key, version);
+}
+
+/**
+ * FUNCTION NAME: toggle
+ *
+ * DESCRIPTION: Xors the digest into the leaf of key and hashes the path up to the root again
+ */
+void MerkleTree::toggle(const Key &key, uint64_t version) {
+	size_t node = MERKLE_LEAVES - 1 + leafOf(key);
+	tree[node] ^= digest(key, version);
+	while ( node > 0 ) {
+		node = (node - 1) / 2;
+		tree[node] = combine(tree[2 * node + 1], tree[2 * node + 2]);
+	}
+}
+
+/**
+ * FUNCTION NAME: root
+ *
+ * DESCRIPTION: Returns the hash of the whole partition
+ */
+uint64_t MerkleTree::root() const {
+	return tree[0];
+}
+
+/**
+ * FUNCTION NAME: nodes
+ *
+ * DESCRIPTION: Returns the MERKLE_NODES hashes of the tree, root first, to send to a replica
+ */
+const uint64_t *MerkleTree::nodes() const {
+	return tree;
+}
+
+/**
+ * FUNCTION NAME: differingLeaves
+ *
+ * DESCRIPTION: Compares the tree with the nodes of a replica, top down, and
+ * 				fills leaves with the leaves that differ. Subtrees whose hashes
+ * 				match are not looked into.
+ */
+void MerkleTree::differingLeaves(const uint64_t *remoteNodes, vector<size_t> &leaves) const {
+	vector<size_t> pending;
+	leaves.clear();
+	if ( tree[0] != remoteNodes[0] ) {
+		pending.push_back(0);
+	}
+	while ( !pending.empty() ) {
+		size_t node = pending.back();
+		pending.pop_back();
+		if ( node >= MERKLE_LEAVES - 1 ) {
+			leaves.push_back(node - (MERKLE_LEAVES - 1));
+			continue;
+		}
+		for ( size_t child = 2 * node + 1; child <= 2 * node + 2; child++ ) {
+			if ( tree[child] != remoteNodes[child] ) {
+				pending.push_back(child);
+			}
+		}
+	}
+	sort(leaves.begin(), leaves.end());
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Empties the tree
+ */
+void MerkleTree::clear() {
+	memset(tree, 0, sizeof(tree));
+	for ( size_t node = MERKLE_LEAVES - 1; node-- > 0; ) {
+		tree[node] = combine(tree[2 * node + 1], tree[2 * node + 2]);
+	}
+}
@@ -0,0 +1,59 @@
+/**********************************
+ * FILE NAME: MerkleTree.h
+ *
+ * DESCRIPTION: Header file of the hash tree replicas compare a partition with
+ **********************************/
+
+#ifndef MERKLETREE_H_
+#define MERKLETREE_H_
+
+#include "stdincludes.h"
+#include "Key.h"
+
+/*
+ * Macros
+ */
+// levels below the root, the tree has 1 << MERKLE_DEPTH leaves
+#define MERKLE_DEPTH 6
+#define MERKLE_LEAVES (1 << MERKLE_DEPTH)
+#define MERKLE_NODES (2 * MERKLE_LEAVES - 1)
+
+/**
+ * CLASS NAME: MerkleTree
+ *
+ * DESCRIPTION: Hash tree over the live keys of one partition.
+ * 				A key falls in the leaf picked by the top bits of its hash.
+ * 				The partition position comes from the low bits, so the keys of a
+ * 				partition spread over all leaves. A leaf is the xor of the
+ * 				digests of its (key, version) pairs, so a write only xors out
+ * 				the digest of the version it replaces and xors in its own. The
+ * 				path up to the root is then hashed again, MERKLE_DEPTH steps
+ * 				per write.
+ *
+ * 				Tombstones are not in the tree. Dropping them in compaction
+ * 				leaves it as it is, so replicas that compacted at different
+ * 				times still agree. Two replicas that saw the same writes have
+ * 				the same root. Otherwise differingLeaves walks down from the
+ * 				root and returns only the leaves whose keys must be compared.
+ *
+ * 				Nodes are kept in one array, the children of node i are
+ * 				2i + 1 and 2i + 2 and the leaves are the last MERKLE_LEAVES.
+ */
+class MerkleTree {
+public:
+	MerkleTree();
+	static size_t leafOf(const Key &key);
+	static uint64_t digest(const Key &key, uint64_t version);
+	void add(const Key &key, uint64_t version);
+	void remove(const Key &key, uint64_t version);
+	uint64_t root() const;
+	const uint64_t *nodes() const;
+	void differingLeaves(const uint64_t *remoteNodes, vector<size_t> &leaves) const;
+	void clear();
+private:
+	uint64_t tree[MERKLE_NODES];
+	void toggle(const Key &key, uint64_t version);
+	static uint64_t combine(uint64_t left, uint64_t right);
+};
+
+#endif /* MERKLETREE_H_ */
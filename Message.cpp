@@ -4,76 +4,43 @@
  * DESCRIPTION: Message class definition
  **********************************/
 #include "Message.h"
+#include "Compression.h"
 
 /**
  * Constructor
  */
-// transID::fromAddr::CREATE::key::value::ReplicaType
-// transID::fromAddr::READ::key
-// transID::fromAddr::UPDATE::key::value::ReplicaType
-// transID::fromAddr::DELETE::key
-// transID::fromAddr::REPLY::sucess
-// transID::fromAddr::READREPLY::value
-Message::Message(string message){
-	this->delimiter = "::";
-	vector<string> tuple;
-	size_t pos = message.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = message.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + 2;
-		pos = message.find(delimiter, start);
-	}
-	tuple.push_back(message.substr(start));
-
-	transID = stoi(tuple.at(0));
-	Address addr(tuple.at(1));
-	fromAddr = addr;
-	type = static_cast<MessageType>(stoi(tuple.at(2)));
-	switch(type){
-		case CREATE:
-		case UPDATE:
-			key = tuple.at(3);
-			value = tuple.at(4);
-			if (tuple.size() > 5)
-				replica = static_cast<ReplicaType>(stoi(tuple.at(5)));
-			break;
-		case READ:
-		case DELETE:
-			key = tuple.at(3);
-			break;
-		case REPLY:
-			if (tuple.at(3) == "1")
-				success = true;
-			else
-				success = false;
-			break;
-		case READREPLY:
-			value = tuple.at(3);
-			break;
-	}
+// construct an empty message, to decode into
+Message::Message(){
+	transID = 0;
+	type = REPLY;
+	replica = PRIMARY;
+	success = false;
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
 }
 
 /**
  * Constructor
  */
 // construct a create or update message
-Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica){
-	this->delimiter = "::";
+Message::Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key, string _value, ReplicaType _replica){
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
 	key = _key;
 	value = _value;
 	replica = _replica;
+	success = false;
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
 }
 
 /**
  * Constructor
  */
 Message::Message(const Message& anotherMessage) {
-	this->delimiter = anotherMessage.delimiter;
 	this->fromAddr = anotherMessage.fromAddr;
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
@@ -81,30 +48,58 @@ Message::Message(const Message& anotherMessage) {
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
+	this->version = anotherMessage.version;
+	this->ttl = anotherMessage.ttl;
+	this->expectedVersion = anotherMessage.expectedVersion;
 }
 
 /**
  * Constructor
  */
-Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value){
-	this->delimiter = "::";
+Message::Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key, string _value){
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
 	key = _key;
 	value = _value;
+	replica = PRIMARY;
+	success = false;
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
 }
 
 /**
  * Constructor
  */
 // construct a read or delete message
-Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key){
-	this->delimiter = "::";
+Message::Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key){
+	transID = _transID;
+	fromAddr = _fromAddr;
+	type = _type;
+	key = _key;
+	replica = PRIMARY;
+	success = false;
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
+}
+
+/**
+ * Constructor
+ */
+// construct a read-modify-write message
+Message::Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key, string _value, ReplicaType _replica, uint64_t _expectedVersion){
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
 	key = _key;
+	value = _value;
+	replica = _replica;
+	success = false;
+	version = 0;
+	ttl = 0;
+	expectedVersion = _expectedVersion;
 }
 
 /**
@@ -112,11 +107,14 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
  */
 // construct reply message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _success){
-	this->delimiter = "::";
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
 	success = _success;
+	replica = PRIMARY;
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
 }
 
 /**
@@ -124,47 +122,271 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _succe
  */
 // construct read reply message
 Message::Message(int _transID, Address _fromAddr, string _value){
-	this->delimiter = "::";
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = READREPLY;
 	value = _value;
+	replica = PRIMARY;
+	success = false;
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
 }
 
+/*
+ * Field lists of the wire format, see Message.h. The header comes first,
+ * then the fields of the message type.
+ */
+typedef WireFields<
+	WIRE_FIELD(MessageView, type),
+	WIRE_FIELD(MessageView, replica),
+	WIRE_FIELD(MessageView, flags),
+	WIRE_FIELD(MessageView, transID),
+	WIRE_FIELD(MessageView, fromAddr)> HeaderFields;
+// CREATE, UPDATE
+typedef WireFields<
+	WIRE_FIELD(MessageView, version),
+	WIRE_FIELD_AS(MessageView, ttl, WireVarint<int>),
+	WIRE_FIELD(MessageView, key),
+	WIRE_FIELD(MessageView, value)> WriteFields;
+// READ
+typedef WireFields<
+	WIRE_FIELD(MessageView, key)> ReadFields;
+// DELETE
+typedef WireFields<
+	WIRE_FIELD(MessageView, version),
+	WIRE_FIELD(MessageView, key)> DeleteFields;
+// REPLY, success is a header flag
+typedef WireFields<> ReplyFields;
+// READREPLY
+typedef WireFields<
+	WIRE_FIELD(MessageView, key),
+	WIRE_FIELD(MessageView, value)> ReadReplyFields;
+// INCR, DECR, APPEND, CAS
+typedef WireFields<
+	WIRE_FIELD(MessageView, version),
+	WIRE_FIELD(MessageView, expectedVersion),
+	WIRE_FIELD(MessageView, key),
+	WIRE_FIELD(MessageView, value)> ReadModifyWriteFields;
+// BATCH, the value holds the messages, see MP2Node::queueMessage
+typedef WireFields<
+	WIRE_FIELD_AS(MessageView, value, WireRest)> BatchFields;
+
 /**
- * FUNCTION NAME: toString
+ * FUNCTION NAME: withBodyFields
+ *
+ * DESCRIPTION: Runs op with the field list of the fields of type that follow
+ * 				the header. op is EncodeBody or DecodeBody.
  *
- * DESCRIPTION: Serialized Message in string format
+ * RETURNS:
+ * false if type is unknown
  */
-string Message::toString(){
-	string message = to_string(transID) + delimiter + fromAddr.getAddress() + delimiter + to_string(type) + delimiter;
-	switch(type){
+template <typename Op>
+static bool withBodyFields(MessageType type, Op &op) {
+	switch ( type ) {
 		case CREATE:
 		case UPDATE:
-			message += key + delimiter + value + delimiter + to_string(replica);
-			break;
+			op.template run<WriteFields>();
+			return true;
 		case READ:
+			op.template run<ReadFields>();
+			return true;
 		case DELETE:
-			message += key;
-			break;
+			op.template run<DeleteFields>();
+			return true;
 		case REPLY:
-			if (success)
-				message += "1";
-			else
-				message += "0";
-			break;
+			op.template run<ReplyFields>();
+			return true;
 		case READREPLY:
-			message += value;
-			break;
+			op.template run<ReadReplyFields>();
+			return true;
+		case INCR:
+		case DECR:
+		case APPEND:
+		case CAS:
+			op.template run<ReadModifyWriteFields>();
+			return true;
+		case BATCH:
+			op.template run<BatchFields>();
+			return true;
+	}
+	return false;
+}
+
+struct EncodeBody {
+	WireWriter &out;
+	const MessageView &view;
+	EncodeBody(WireWriter &out, const MessageView &view): out(out), view(view) {}
+	template <typename Fields>
+	void run() {
+		Fields::encode(out, view);
+	}
+};
+
+struct DecodeBody {
+	WireReader &in;
+	MessageView &view;
+	DecodeBody(WireReader &in, MessageView &view): in(in), view(view) {}
+	template <typename Fields>
+	void run() {
+		Fields::decode(in, view);
+	}
+};
+
+/**
+ * FUNCTION NAME: hasValue
+ *
+ * DESCRIPTION: Returns whether messages of type carry a value, which may be
+ * 				sent compressed. The messages in a BATCH are not its value.
+ */
+static bool hasValue(MessageType type) {
+	return type != READ && type != DELETE && type != REPLY && type != BATCH;
+}
+
+/**
+ * FUNCTION NAME: encodedSizeBound
+ *
+ * DESCRIPTION: Returns the most bytes encode writes for this message. A value
+ * 				is only sent compressed when that makes it smaller.
+ */
+size_t Message::encodedSizeBound() const {
+	return HeaderFields::minSize + 2 * sizeof(uint64_t) + 3 * MAX_VARINT_SIZE + key.size() + value.size();
+}
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Serializes the message into buf, see the layout in Message.h.
+ * 				Nothing is allocated unless the value is large enough to be
+ * 				compressed.
+ *
+ * RETURNS:
+ * the number of bytes written
+ */
+size_t Message::encode(char *buf) const {
+	string block;
+	MessageView wire;
+
+	wire.type = type;
+	wire.replica = replica;
+	wire.flags = success ? MESSAGE_FLAG_SUCCESS : 0;
+	wire.transID = transID;
+	wire.fromAddr = fromAddr;
+	wire.version = version;
+	wire.ttl = ttl;
+	wire.expectedVersion = expectedVersion;
+	wire.key = key.slice();
+	wire.value = Slice(value);
+	if ( hasValue(type) && compressValue(wire.value, block) ) {
+		wire.value = Slice(block);
+		wire.flags |= MESSAGE_FLAG_COMPRESSED;
+	}
+	return wire.encode(buf, encodedSizeBound());
+}
+
+/**
+ * FUNCTION NAME: decode
+ *
+ * DESCRIPTION: Parses a message written by encode from [data, data + size).
+ * 				The strings of the message keep their buffers, so decoding
+ * 				into the same message again only allocates for a longer
+ * 				value than before.
+ *
+ * RETURNS:
+ * false if the bytes are not a whole message
+ */
+bool Message::decode(const char *data, size_t size) {
+	MessageView view;
+	if ( !view.parse(data, size) ) {
+		return false;
+	}
+	type = view.type;
+	replica = view.replica;
+	key = Key(view.key);
+	fromAddr = view.fromAddr;
+	transID = view.transID;
+	success = view.success();
+	version = view.version;
+	ttl = view.ttl;
+	expectedVersion = view.expectedVersion;
+	return view.copyValue(value);
+}
+
+/**
+ * Constructor
+ */
+MessageView::MessageView(){
+	type = REPLY;
+	replica = PRIMARY;
+	flags = 0;
+	transID = 0;
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
+}
+
+/**
+ * FUNCTION NAME: parse
+ *
+ * DESCRIPTION: Parses a message written by encode from [data, data + size)
+ * 				without copying it. Every length is checked against the buffer.
+ *
+ * RETURNS:
+ * false if the bytes are not a whole message
+ */
+bool MessageView::parse(const char *data, size_t size) {
+	WireReader in(data, size);
+	DecodeBody body(in, *this);
+
+	if ( size < HeaderFields::minSize ) {
+		return false;
+	}
+	version = 0;
+	ttl = 0;
+	expectedVersion = 0;
+	key = Slice();
+	value = Slice();
+	HeaderFields::decode(in, *this);
+	return in.ok() && withBodyFields(type, body) && in.atEnd();
+}
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Serializes the view into buf
+ *
+ * RETURNS:
+ * the number of bytes written, 0 if they do not fit in capacity
+ */
+size_t MessageView::encode(char *buf, size_t capacity) const {
+	WireWriter out(buf, capacity);
+	EncodeBody body(out, *this);
+
+	HeaderFields::encode(out, *this);
+	withBodyFields(type, body);
+	return out.ok() ? out.size() : 0;
+}
+
+/**
+ * FUNCTION NAME: copyValue
+ *
+ * DESCRIPTION: Sets dst to the value of the message, decompressed if it was sent compressed
+ *
+ * RETURNS:
+ * false if the compressed block is damaged
+ */
+bool MessageView::copyValue(string &dst) const {
+	if ( compressed() ) {
+		return decompressBlock(value.data, value.size, dst);
 	}
-	return message;
+	dst.assign(value.data, value.size);
+	return true;
 }
 
 /**
  * Assignment operator overloading
  */
 Message& Message::operator =(const Message& anotherMessage) {
-	this->delimiter = anotherMessage.delimiter;
 	this->fromAddr = anotherMessage.fromAddr;
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
@@ -172,5 +394,8 @@ Message& Message::operator =(const Message& anotherMessage) {
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
+	this->version = anotherMessage.version;
+	this->ttl = anotherMessage.ttl;
+	this->expectedVersion = anotherMessage.expectedVersion;
 	return *this;
 }
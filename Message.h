@@ -9,38 +9,120 @@
 #include "stdincludes.h"
 #include "Member.h"
 #include "common.h"
+#include "Key.h"
+#include "Slice.h"
+#include "Serializer.h"
+
+/*
+ * Macros
+ */
+// header flags
+#define MESSAGE_FLAG_SUCCESS 0x01
+// the value bytes are a compressed block, see Compression.h
+#define MESSAGE_FLAG_COMPRESSED 0x02
 
 /**
  * CLASS NAME: Message
  *
- * DESCRIPTION: This class is used for message passing among nodes
+ * DESCRIPTION: This class is used for message passing among nodes.
+ * 				On the wire a message is a fixed header followed by the
+ * 				fields of its type, key and value length prefixed, so any
+ * 				bytes may appear in them:
+ *
+ * 				type (1) replica (1) flags (1) transID (4) fromAddr (6)
+ * 				CREATE, UPDATE:			version (8) ttl (varint) key value
+ * 				READ:					key
+ * 				DELETE:					version (8) key
+ * 				REPLY:					nothing, success is a flag
+ * 				READREPLY:				key value
+ * 				INCR, DECR, APPEND, CAS:	version (8) expectedVersion (8) key value
+ * 				BATCH:					messages, each length prefixed
+ *
+ * 				Integers are little endian. Large values are sent compressed.
  */
 class Message{
 public:
 	MessageType type;
 	ReplicaType replica;
-	string key;
+	Key key;
 	string value;
 	Address fromAddr;
 	int transID;
-	bool success; // success or not 
-	// delimiter
-	string delimiter;
-	// construct a message from a string
-	Message(string message);
+	bool success; // success or not
+	uint64_t version; // version of a create or update, 0 if unversioned
+	int ttl; // time units a created or updated key lives for, 0 if it never expires
+	uint64_t expectedVersion; // version a CAS expects stored, 0 for a key that must be missing
+	// construct an empty message, to decode into
+	Message();
 	Message(const Message& anotherMessage);
 	// construct a create or update message
-	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value);
-	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica);
+	Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key, string _value);
+	Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key, string _value, ReplicaType _replica);
 	// construct a read or delete message
-	Message(int _transID, Address _fromAddr, MessageType _type, string _key);
+	Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key);
+	// construct a read-modify-write message, value is the operand
+	Message(int _transID, Address _fromAddr, MessageType _type, const Key &_key, string _value, ReplicaType _replica, uint64_t _expectedVersion);
 	// construct reply message
 	Message(int _transID, Address _fromAddr, MessageType _type, bool _success);
 	// construct read reply message
 	Message(int _transID, Address _fromAddr, string _value);
 	Message& operator = (const Message& anotherMessage);
-	// serialize to a string
-	string toString();
+	// most bytes encode writes
+	size_t encodedSizeBound() const;
+	// serialize into buf, which has room for encodedSizeBound() bytes
+	size_t encode(char *buf) const;
+	// parse a serialized message, false if it is damaged
+	bool decode(const char *data, size_t size);
+};
+
+/**
+ * CLASS NAME: MessageView
+ *
+ * DESCRIPTION: A serialized message parsed in place. key and value point into
+ * 				the buffer it was parsed from, so a view only lives while the
+ * 				message is handled, and nothing is copied out of the buffer
+ * 				until a handler stores the bytes.
+ *
+ * 				The view is also the form a Message is encoded from, its
+ * 				field lists in Message.cpp declare the layout once for both.
+ */
+class MessageView{
+public:
+	MessageType type;
+	ReplicaType replica;
+	uint8_t flags;
+	int transID;
+	Address fromAddr;
+	uint64_t version;
+	int ttl;
+	uint64_t expectedVersion;
+	Slice key;
+	// the value as sent, a compressed block if MESSAGE_FLAG_COMPRESSED is set
+	Slice value;
+	MessageView();
+	bool success() const {
+		return (flags & MESSAGE_FLAG_SUCCESS) != 0;
+	}
+	bool compressed() const {
+		return (flags & MESSAGE_FLAG_COMPRESSED) != 0;
+	}
+	// parse a serialized message, false if it is damaged
+	bool parse(const char *data, size_t size);
+	// serialize into buf, 0 if it does not fit in capacity
+	size_t encode(char *buf, size_t capacity) const;
+	// copy the value out of the buffer, false if it does not decompress
+	bool copyValue(string &dst) const;
+};
+
+// largest values of the enums a message carries
+template <>
+struct WireEnumLimit<MessageType> {
+	static const int value = BATCH;
+};
+
+template <>
+struct WireEnumLimit<ReplicaType> {
+	static const int value = TERTIARY;
 };
 
 #endif
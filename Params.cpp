@@ -40,6 +40,31 @@ void Params::setparams(char *config_file) {
 		this->CRUDTEST = DELETE_TEST;
 	}
 
+	// Defaults of the optional parameters
+	TOMBSTONE_GRACE = 20;
+	COMPACTION_BUDGET = 256;
+	WAL_DIR = "";
+	WAL_SYNC_MS = 0;
+	SNAPSHOT_DIR = "";
+	SNAPSHOT_INTERVAL = 0;
+	WARM_BUDGET = 4096;
+	STORAGE_ENGINE = "HASH";
+	DATA_DIR = ".";
+	READ_CACHE_SIZE = 0;
+	READ_CACHE_TTL = 5;
+	MEMORY_LIMIT = 0;
+	EVICTION_POLICY = "NONE";
+	STATS_INTERVAL = 50;
+	ORDERED_INDEX = 0;
+	BATCH_MESSAGES = 1;
+
+	// Optional parameters follow the required ones, one "NAME: value" per line
+	char name[64];
+	char value[256];
+	while ( fscanf(fp, " %63[A-Z_]: %255s", name, value) == 2 ) {
+		setOptionalParam(name, value);
+	}
+
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
 	EN_GPSZ = MAX_NNB;
@@ -56,6 +81,74 @@ void Params::setparams(char *config_file) {
 	return;
 }
 
+/**
+ * FUNCTION NAME: setOptionalParam
+ *
+ * DESCRIPTION: Set one optional parameter of the test case by name.
+ * 				Unknown names are ignored.
+ */
+void Params::setOptionalParam(const char *name, const char *value) {
+	if ( 0 == strcmp(name, "TOMBSTONE_GRACE") ) {
+		TOMBSTONE_GRACE = atoi(value);
+	}
+	else if ( 0 == strcmp(name, "COMPACTION_BUDGET") ) {
+		COMPACTION_BUDGET = strtoul(value, NULL, 10);
+	}
+	else if ( 0 == strcmp(name, "WAL_DIR") ) {
+		WAL_DIR = value;
+	}
+	else if ( 0 == strcmp(name, "WAL_SYNC_MS") ) {
+		WAL_SYNC_MS = atoi(value);
+	}
+	else if ( 0 == strcmp(name, "SNAPSHOT_DIR") ) {
+		SNAPSHOT_DIR = value;
+	}
+	else if ( 0 == strcmp(name, "SNAPSHOT_INTERVAL") ) {
+		SNAPSHOT_INTERVAL = atoi(value);
+	}
+	else if ( 0 == strcmp(name, "WARM_BUDGET") ) {
+		WARM_BUDGET = strtoul(value, NULL, 10);
+	}
+	else if ( 0 == strcmp(name, "STORAGE_ENGINE") ) {
+		STORAGE_ENGINE = value;
+	}
+	else if ( 0 == strcmp(name, "DATA_DIR") ) {
+		DATA_DIR = value;
+	}
+	else if ( 0 == strcmp(name, "READ_CACHE_SIZE") ) {
+		READ_CACHE_SIZE = strtoul(value, NULL, 10);
+	}
+	else if ( 0 == strcmp(name, "READ_CACHE_TTL") ) {
+		READ_CACHE_TTL = atoi(value);
+	}
+	else if ( 0 == strcmp(name, "MEMORY_LIMIT") ) {
+		// A K, M or G suffix scales the number of bytes
+		char *suffix;
+		MEMORY_LIMIT = strtoul(value, &suffix, 10);
+		if ( *suffix == 'K' ) {
+			MEMORY_LIMIT <<= 10;
+		}
+		else if ( *suffix == 'M' ) {
+			MEMORY_LIMIT <<= 20;
+		}
+		else if ( *suffix == 'G' ) {
+			MEMORY_LIMIT <<= 30;
+		}
+	}
+	else if ( 0 == strcmp(name, "EVICTION_POLICY") ) {
+		EVICTION_POLICY = value;
+	}
+	else if ( 0 == strcmp(name, "STATS_INTERVAL") ) {
+		STATS_INTERVAL = atoi(value);
+	}
+	else if ( 0 == strcmp(name, "ORDERED_INDEX") ) {
+		ORDERED_INDEX = atoi(value);
+	}
+	else if ( 0 == strcmp(name, "BATCH_MESSAGES") ) {
+		BATCH_MESSAGES = atoi(value);
+	}
+}
+
 /**
  * FUNCTION NAME: getcurrtime
  *
@@ -32,8 +32,25 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	int TOMBSTONE_GRACE;		// time units a tombstone is kept before compaction may drop it
+	unsigned long COMPACTION_BUDGET;	// slots a compaction pass may look at per time unit
+	string WAL_DIR;				// directory of the write ahead logs, empty to keep no log
+	int WAL_SYNC_MS;			// sync the log at least this often, 0 to sync once per time unit only
+	string SNAPSHOT_DIR;		// directory of the snapshots, empty to take no snapshot
+	int SNAPSHOT_INTERVAL;		// time units between snapshots, 0 to only warm up the existing one
+	unsigned long WARM_BUDGET;	// snapshot records loaded into memory per time unit
+	string STORAGE_ENGINE;		// local store of every node: HASH, SHARDED or LSM
+	string DATA_DIR;			// directory the LSM engine keeps its tables in
+	unsigned long READ_CACHE_SIZE;	// read results a coordinator caches, 0 to cache none
+	int READ_CACHE_TTL;			// time units a cached read result may be served for
+	unsigned long MEMORY_LIMIT;	// bytes the local store of a node may take up, 0 for no limit
+	string EVICTION_POLICY;		// keys evicted over the limit: LRU, CLOCK, LFU, or NONE to reject writes
+	int STATS_INTERVAL;			// time units between usage lines in the stats log, 0 for none
+	int ORDERED_INDEX;			// 1 to keep the keys of hashed stores sorted for range scans
+	int BATCH_MESSAGES;			// 1 to send the messages of a time unit to each node as one batch
 	Params();
 	void setparams(char *);
+	void setOptionalParam(const char *name, const char *value);
 	int getcurrtime();
 };
 
@@ -0,0 +1,965 @@
+/**********************************
+ * FILE NAME: PartitionedStore.cpp
+ *
+ * DESCRIPTION: Definition of the local store split into one table per ring position
+ **********************************/
+
+#include "PartitionedStore.h"
+#include <dirent.h>
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: Partitions will be engines of type engineType. LSM partitions
+ * 				keep their tables in dataPath.<position>, the ones found there
+ * 				are opened right away.
+ */
+PartitionedStore::PartitionedStore(const string &engineType, const string &dataPath):
+		numPartitions(0), engineType(engineType), dataPath(dataPath), syncIntervalMs(0), orderedIndex(false) {
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		partitions[i] = NULL;
+		partitionBytes[i] = 0;
+		unsynced[i] = false;
+	}
+	if ( engineType == "LSM" ) {
+		vector<size_t> found = positionsOnDisk(dataPath);
+		for ( size_t i = 0; i < found.size(); i++ ) {
+			partitions[found[i]] = newPartition(found[i]);
+			numPartitions++;
+		}
+	}
+}
+
+/**
+ * Destructor
+ */
+PartitionedStore::~PartitionedStore() {
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		delete partitions[i];
+	}
+}
+
+/**
+ * FUNCTION NAME: positionOf
+ *
+ * DESCRIPTION: Returns the ring position of key, the one MP2Node::hashFunction returns.
+ * 				The key hash is mixed before the position is taken from it.
+ * 				Taken straight from the hash, the position bits would be the
+ * 				same for every key of a partition. Its FlatTable tags and home
+ * 				groups, filter blocks and hash tree leaves all come from that
+ * 				same hash.
+ */
+size_t PartitionedStore::positionOf(const Key &key) {
+	uint64_t mixed = key.hash();
+	mixed ^= mixed >> 33;
+	mixed *= 0xff51afd7ed558ccdULL;
+	mixed ^= mixed >> 33;
+	mixed *= 0xc4ceb9fe1a85ec53ULL;
+	mixed ^= mixed >> 33;
+	return mixed % RING_SIZE;
+}
+
+/**
+ * FUNCTION NAME: partitionOf
+ *
+ * DESCRIPTION: Returns the partition of key, creating it if create is set
+ *
+ * RETURNS:
+ * the partition, NULL if it does not exist and create is not set
+ */
+Partition *PartitionedStore::partitionOf(const Key &key, bool create) {
+	size_t position = positionOf(key);
+	if ( partitions[position] == NULL && create ) {
+		partitions[position] = newPartition(position);
+		numPartitions++;
+		joinBudget(position);
+	}
+	return partitions[position];
+}
+
+/**
+ * FUNCTION NAME: newPartition
+ *
+ * DESCRIPTION: Builds the engine of a position and opens its snapshot and its
+ * 				log, when the store has them
+ */
+Partition *PartitionedStore::newPartition(size_t position) {
+	Partition *partition = new Partition(newStorageEngine(engineType, partitionPath(dataPath, position)));
+	if ( !snapshotPath.empty() ) {
+		partition->engine->openSnapshot(partitionPath(snapshotPath, position));
+	}
+	if ( !logPath.empty() ) {
+		partition->engine->openLog(partitionPath(logPath, position), syncIntervalMs);
+	}
+	if ( orderedIndex ) {
+		partition->engine->setOrderedIndex(true);
+	}
+	partition->rebuildTree();
+	return partition;
+}
+
+/**
+ * FUNCTION NAME: rebuildTree
+ *
+ * DESCRIPTION: Builds the hash tree again from every live key of the engine,
+ * 				after its content was loaded from disk
+ */
+void Partition::rebuildTree() {
+	tree.clear();
+	engine->forEachRecord(addToTree, &tree);
+}
+
+/**
+ * FUNCTION NAME: addToTree
+ *
+ * DESCRIPTION: Visitor of rebuildTree, adds a live record to the tree in env
+ */
+void Partition::addToTree(void *env, const Slice &key, const EntryRecord &record) {
+	if ( !record.isTombstone() ) {
+		((MerkleTree *)env)->add(Key(key), record.version);
+	}
+}
+
+/**
+ * FUNCTION NAME: joinBudget
+ *
+ * DESCRIPTION: Puts the partition of position under the memory budget of the
+ * 				store, if there is one, and counts its bytes into it. The
+ * 				eviction policy of the partition is kept if it has one.
+ */
+void PartitionedStore::joinBudget(size_t position) {
+	if ( memoryBudget.limit > 0 ) {
+		partitions[position]->engine->setMemoryBudget(&memoryBudget, evictionPolicy);
+	}
+	account(position);
+}
+
+/**
+ * FUNCTION NAME: leaveBudget
+ *
+ * DESCRIPTION: Takes the bytes of the partition of position out of the budget
+ * 				and leaves the partition without a limit, before it is detached
+ */
+void PartitionedStore::leaveBudget(size_t position) {
+	memoryBudget.used -= partitionBytes[position];
+	partitionBytes[position] = 0;
+	if ( memoryBudget.limit > 0 ) {
+		partitions[position]->engine->setMemoryBudget(NULL, evictionPolicy);
+	}
+}
+
+/**
+ * FUNCTION NAME: account
+ *
+ * DESCRIPTION: Counts the bytes the partition of position takes up now into
+ * 				the budget, after a write or maintenance changed them
+ */
+void PartitionedStore::account(size_t position) {
+	if ( memoryBudget.limit == 0 || partitions[position] == NULL ) {
+		return;
+	}
+	unsigned long bytes = partitions[position]->engine->memoryBytes();
+	memoryBudget.used = memoryBudget.used - partitionBytes[position] + bytes;
+	partitionBytes[position] = bytes;
+}
+
+/**
+ * FUNCTION NAME: largestPartition
+ *
+ * DESCRIPTION: Finds the partition counted with the most bytes, of the ones
+ * 				not passed over
+ *
+ * RETURNS:
+ * its position, -1 if there is none
+ */
+long PartitionedStore::largestPartition(const vector<bool> &passed) {
+	long largest = -1;
+	for ( size_t position = 0; position < RING_SIZE; position++ ) {
+		if ( partitions[position] != NULL && !passed[position] &&
+				(largest < 0 || partitionBytes[position] > partitionBytes[largest]) ) {
+			largest = (long)position;
+		}
+	}
+	return largest;
+}
+
+/**
+ * FUNCTION NAME: makeRoom
+ *
+ * DESCRIPTION: Before a new key of the given bytes goes into the partition of
+ * 				position, reclaims memory from the partition taking up the most,
+ * 				up to PARTITION_RECLAIM_BATCH times, until the key fits under
+ * 				the limit. Room for the resize the key starts is made as well
+ * 				while the partition stays no larger than the one reclaimed
+ * 				from. A partition with nothing left to reclaim is passed over.
+ */
+void PartitionedStore::makeRoom(size_t position, unsigned long bytes) {
+	if ( memoryBudget.limit == 0 ) {
+		return;
+	}
+	vector<bool> passed(RING_SIZE, false);
+	unsigned long growth = partitions[position]->engine->growthBytes();
+	for ( int i = 0; i < PARTITION_RECLAIM_BATCH; i++ ) {
+		long largest = largestPartition(passed);
+		if ( largest < 0 ) {
+			return;
+		}
+		if ( (size_t)largest == position || partitionBytes[position] + growth > partitionBytes[largest] ) {
+			growth = 0;
+		}
+		if ( memoryBudget.used + bytes + growth <= memoryBudget.limit ) {
+			return;
+		}
+		if ( partitions[largest]->engine->reclaim(1) == 0 ) {
+			passed[largest] = true;
+		}
+		account(largest);
+	}
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: Inserts the (key,entry) pair into the partition of key, last writer wins
+ */
+bool PartitionedStore::create(const Key &key, const Entry &entry) {
+	Partition *partition = partitionOf(key, true);
+	uint64_t replaced;
+	bool wasLive = partition->engine->liveVersion(key, replaced);
+	makeRoom(positionOf(key), key.size() + entry.value.size());
+	bool created = partition->engine->create(key, entry);
+	account(positionOf(key));
+	markUnsynced(positionOf(key));
+	if ( !created ) {
+		return false;
+	}
+	if ( wasLive ) {
+		partition->tree.remove(key, replaced);
+	}
+	partition->tree.add(key, entry.version);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: read
+ *
+ * DESCRIPTION: Searches for the key in its partition
+ *
+ * RETURNS:
+ * string value if found
+ * else it returns an empty string
+ */
+string PartitionedStore::read(const Key &key) {
+	Partition *partition = partitionOf(key, false);
+	return partition == NULL ? "" : partition->engine->read(key);
+}
+
+/**
+ * FUNCTION NAME: readEntry
+ *
+ * DESCRIPTION: Fills in the entry of key from its partition
+ */
+bool PartitionedStore::readEntry(const Key &key, Entry &entry, bool withTombstones) {
+	Partition *partition = partitionOf(key, false);
+	return partition != NULL && partition->engine->readEntry(key, entry, withTombstones);
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: Updates the given key with the entry unless a newer version is stored
+ */
+bool PartitionedStore::update(const Key &key, const Entry &entry) {
+	Partition *partition = partitionOf(key, false);
+	uint64_t replaced;
+	// Only a live key is updated
+	if ( partition == NULL || !partition->engine->liveVersion(key, replaced) || !partition->engine->update(key, entry) ) {
+		return false;
+	}
+	account(positionOf(key));
+	markUnsynced(positionOf(key));
+	partition->tree.remove(key, replaced);
+	partition->tree.add(key, entry.version);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: Leaves a tombstone of the given version for the key. A versioned
+ * 				tombstone is kept even if the key was never seen, so it creates
+ * 				the partition.
+ */
+bool PartitionedStore::deleteKey(const Key &key, uint64_t version, int time) {
+	Partition *partition = partitionOf(key, version > 0);
+	uint64_t deleted;
+	if ( partition == NULL ) {
+		return false;
+	}
+	bool wasLive = partition->engine->liveVersion(key, deleted);
+	// True only when the live key is gone, a newer write keeps it
+	bool isDeleted = partition->engine->deleteKey(key, version, time);
+	account(positionOf(key));
+	markUnsynced(positionOf(key));
+	if ( wasLive && isDeleted ) {
+		partition->tree.remove(key, deleted);
+	}
+	return isDeleted;
+}
+
+/**
+ * FUNCTION NAME: currentSize
+ *
+ * DESCRIPTION: Returns the number of keys over all partitions
+ */
+unsigned long PartitionedStore::currentSize() {
+	unsigned long size = 0;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			size += partitions[i]->engine->currentSize();
+		}
+	}
+	return size;
+}
+
+/**
+ * FUNCTION NAME: tombstoneCount
+ *
+ * DESCRIPTION: Returns the number of tombstones over all partitions
+ */
+unsigned long PartitionedStore::tombstoneCount() {
+	unsigned long tombstones = 0;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			tombstones += partitions[i]->engine->tombstoneCount();
+		}
+	}
+	return tombstones;
+}
+
+/**
+ * FUNCTION NAME: countKeys
+ *
+ * DESCRIPTION: Counts the live keys and the tombstones over all partitions in
+ * 				one pass, for the stats log
+ */
+void PartitionedStore::countKeys(unsigned long &live, unsigned long &tombstones) {
+	live = 0;
+	tombstones = 0;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			live += partitions[i]->engine->currentSize();
+			tombstones += partitions[i]->engine->tombstoneCount();
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Clear all contents from every partition
+ */
+void PartitionedStore::clear() {
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			partitions[i]->engine->clear();
+			partitions[i]->tree.clear();
+			account(i);
+			markUnsynced(i);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: Returns the count of the number of values for the passed in key
+ */
+unsigned long PartitionedStore::count(const Key &key) {
+	Partition *partition = partitionOf(key, false);
+	return partition == NULL ? 0 : partition->engine->count(key);
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: A key whose partition does not exist is surely not stored,
+ * 				otherwise the filter of the partition decides
+ */
+bool PartitionedStore::mayContain(const Key &key) {
+	Partition *partition = partitionOf(key, false);
+	return partition != NULL && partition->engine->mayContain(key);
+}
+
+/**
+ * FUNCTION NAME: liveVersion
+ *
+ * DESCRIPTION: Looks up the version of key in its partition
+ */
+bool PartitionedStore::liveVersion(const Key &key, uint64_t &version) {
+	Partition *partition = partitionOf(key, false);
+	return partition != NULL && partition->engine->liveVersion(key, version);
+}
+
+/**
+ * FUNCTION NAME: filterStats
+ *
+ * DESCRIPTION: Returns the filter counts summed over all partitions
+ */
+BloomStats PartitionedStore::filterStats() {
+	BloomStats stats;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			BloomStats partitionStats = partitions[i]->engine->filterStats();
+			stats.negatives += partitionStats.negatives;
+			stats.falsePositives += partitionStats.falsePositives;
+		}
+	}
+	return stats;
+}
+
+/**
+ * FUNCTION NAME: forEachRecord
+ *
+ * DESCRIPTION: Visits the records of every partition, in ring order
+ */
+void PartitionedStore::forEachRecord(RecordVisitFn visit, void *env) {
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			partitions[i]->engine->forEachRecord(visit, env);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: scan
+ *
+ * DESCRIPTION: Scans every partition for up to limit keys and keeps the first
+ * 				limit of them all
+ */
+void PartitionedStore::scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries) {
+	size_t from = entries.size();
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			partitions[i]->engine->scan(startKey, endKey, limit, entries);
+		}
+	}
+	mergeScanEntries(entries, from, limit);
+}
+
+/**
+ * FUNCTION NAME: setOrderedIndex
+ *
+ * DESCRIPTION: Turns the ordered index of every partition on or off, partitions
+ * 				created later follow
+ */
+void PartitionedStore::setOrderedIndex(bool enabled) {
+	orderedIndex = enabled;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			partitions[i]->engine->setOrderedIndex(enabled);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Returns the memory taken up by all partitions
+ */
+MemoryUsage PartitionedStore::memoryUsage() {
+	MemoryUsage usage;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			MemoryUsage partitionUsage = partitions[i]->engine->memoryUsage();
+			usage.keyBytes += partitionUsage.keyBytes;
+			usage.valueBytes += partitionUsage.valueBytes;
+			usage.metadataBytes += partitionUsage.metadataBytes;
+			usage.arenaBytes += partitionUsage.arenaBytes;
+			usage.evictions += partitionUsage.evictions;
+		}
+	}
+	usage.limitBytes = memoryBudget.limit;
+	return usage;
+}
+
+/**
+ * FUNCTION NAME: setMemoryLimit
+ *
+ * DESCRIPTION: Sets the limit of the whole store, one budget every partition
+ * 				shares. Partitions created later join it.
+ */
+void PartitionedStore::setMemoryLimit(unsigned long bytes, const string &policy) {
+	memoryBudget.limit = bytes;
+	memoryBudget.used = 0;
+	evictionPolicy = policy;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		partitionBytes[i] = 0;
+		if ( partitions[i] != NULL ) {
+			partitions[i]->engine->setMemoryBudget(bytes == 0 ? NULL : &memoryBudget, policy);
+			account(i);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: setMemoryBudget
+ *
+ * DESCRIPTION: A store is not put under the budget of another one, the budget
+ * 				only sets the limit of the store
+ */
+void PartitionedStore::setMemoryBudget(const MemoryBudget *budget, const string &policy) {
+	setMemoryLimit(budget == NULL ? 0 : budget->limit, policy);
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the bytes of all partitions counted against the limit
+ */
+unsigned long PartitionedStore::memoryBytes() {
+	unsigned long bytes = 0;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			bytes += memoryBudget.limit > 0 ? partitionBytes[i] : partitions[i]->engine->memoryBytes();
+		}
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: growthBytes
+ *
+ * DESCRIPTION: The partition a new key resizes is only known with the key, the
+ * 				store itself makes room for it
+ */
+unsigned long PartitionedStore::growthBytes() {
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: reclaim
+ *
+ * DESCRIPTION: Reclaims the memory of up to count keys, each from the
+ * 				partition counted with the most bytes
+ *
+ * RETURNS:
+ * number of keys reclaimed
+ */
+unsigned long PartitionedStore::reclaim(unsigned long count) {
+	unsigned long reclaimed = 0;
+	vector<bool> passed(RING_SIZE, false);
+	while ( reclaimed < count ) {
+		long largest = largestPartition(passed);
+		if ( largest < 0 ) {
+			break;
+		}
+		unsigned long keys = partitions[largest]->engine->reclaim(1);
+		if ( keys == 0 ) {
+			passed[largest] = true;
+		}
+		reclaimed += keys;
+		account(largest);
+	}
+	return reclaimed;
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: Runs a compaction pass on every partition, splitting the budget between them
+ */
+unsigned long PartitionedStore::compact(int time, int gracePeriod, unsigned long budget) {
+	unsigned long dropped = 0;
+	if ( numPartitions == 0 ) {
+		return 0;
+	}
+	unsigned long share = max(budget / numPartitions, 1UL);
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			dropped += partitions[i]->engine->compact(time, gracePeriod, share);
+			account(i);
+		}
+	}
+	return dropped;
+}
+
+/**
+ * FUNCTION NAME: openLog
+ *
+ * DESCRIPTION: Every partition logs to path.<position>. The partitions that
+ * 				left a log behind are created and replay it, later ones open
+ * 				their log when they are created.
+ */
+bool PartitionedStore::openLog(const string &path, int syncIntervalMs) {
+	bool opened = true;
+	vector<size_t> found = positionsOnDisk(path);
+	for ( size_t i = 0; i < found.size(); i++ ) {
+		if ( partitions[found[i]] == NULL ) {
+			// Created without a log path, opened below like the existing ones
+			partitions[found[i]] = newPartition(found[i]);
+			numPartitions++;
+		}
+	}
+	logPath = path;
+	this->syncIntervalMs = syncIntervalMs;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			opened = partitions[i]->engine->openLog(partitionPath(path, i), syncIntervalMs) && opened;
+			partitions[i]->rebuildTree();
+			joinBudget(i);
+		}
+	}
+	return opened;
+}
+
+/**
+ * FUNCTION NAME: syncLog
+ *
+ * DESCRIPTION: Syncs the logs of the partitions written since the last call.
+ * 				A partition whose log fails to sync is tried again next time.
+ */
+bool PartitionedStore::syncLog() {
+	bool synced = true;
+	vector<size_t> positions;
+	positions.swap(unsyncedPositions);
+	for ( size_t i = 0; i < positions.size(); i++ ) {
+		unsynced[positions[i]] = false;
+		if ( partitions[positions[i]] != NULL && !partitions[positions[i]]->engine->syncLog() ) {
+			synced = false;
+			markUnsynced(positions[i]);
+		}
+	}
+	return synced;
+}
+
+/**
+ * FUNCTION NAME: markUnsynced
+ *
+ * DESCRIPTION: Lists the partition of position for the next syncLog, once
+ */
+void PartitionedStore::markUnsynced(size_t position) {
+	if ( !unsynced[position] ) {
+		unsynced[position] = true;
+		unsyncedPositions.push_back(position);
+	}
+}
+
+/**
+ * FUNCTION NAME: dumpSnapshot
+ *
+ * DESCRIPTION: Writes one snapshot per partition, named path.<position>
+ */
+bool PartitionedStore::dumpSnapshot(const string &path) {
+	bool dumped = true;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			dumped = partitions[i]->engine->dumpSnapshot(partitionPath(path, i)) && dumped;
+		}
+	}
+	return dumped;
+}
+
+/**
+ * FUNCTION NAME: openSnapshot
+ *
+ * DESCRIPTION: Creates the partition of every snapshot named path.<position>
+ * 				and maps it. Partitions created later look for theirs too.
+ */
+bool PartitionedStore::openSnapshot(const string &path) {
+	bool opened = true;
+	vector<size_t> found = positionsOnDisk(path);
+	snapshotPath = path;
+	for ( size_t i = 0; i < found.size(); i++ ) {
+		if ( partitions[found[i]] == NULL ) {
+			// Opens the snapshot as it is created
+			partitions[found[i]] = newPartition(found[i]);
+			numPartitions++;
+		}
+		else {
+			opened = partitions[found[i]]->engine->openSnapshot(partitionPath(path, found[i])) && opened;
+			partitions[found[i]]->rebuildTree();
+		}
+		joinBudget(found[i]);
+	}
+	return opened;
+}
+
+/**
+ * FUNCTION NAME: warmSnapshot
+ *
+ * DESCRIPTION: Warms up every partition, splitting the budget between them
+ */
+unsigned long PartitionedStore::warmSnapshot(unsigned long budget) {
+	unsigned long loaded = 0;
+	if ( numPartitions == 0 ) {
+		return 0;
+	}
+	unsigned long share = max(budget / numPartitions, 1UL);
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[i] != NULL ) {
+			loaded += partitions[i]->engine->warmSnapshot(share);
+			account(i);
+		}
+	}
+	return loaded;
+}
+
+/**
+ * FUNCTION NAME: treeOf
+ *
+ * DESCRIPTION: Returns the hash tree of a position, NULL if it has no partition.
+ * 				A replica without the partition compares against an empty tree.
+ */
+const MerkleTree *PartitionedStore::treeOf(size_t position) {
+	Partition *partition = partitions[position % RING_SIZE];
+	return partition == NULL ? NULL : &partition->tree;
+}
+
+/**
+ * STRUCT NAME: LeafScan
+ *
+ * DESCRIPTION: What leafEntries collects the keys of one leaf with
+ */
+typedef struct LeafScan {
+	size_t leaf;
+	vector<Key> keys;
+} LeafScan;
+
+/**
+ * FUNCTION NAME: collectLeaf
+ *
+ * DESCRIPTION: Visitor of leafEntries, keeps the keys of the leaf, tombstones included
+ */
+static void collectLeaf(void *env, const Slice &key, const EntryRecord &record) {
+	LeafScan *scan = (LeafScan *)env;
+	Key found(key);
+	if ( MerkleTree::leafOf(found) == scan->leaf ) {
+		scan->keys.push_back(found);
+	}
+}
+
+/**
+ * FUNCTION NAME: leafEntries
+ *
+ * DESCRIPTION: Fills entries with every key of one leaf of a partition and its
+ * 				entry, tombstones included so a newer delete wins on the
+ * 				replica it is shipped to. Scans the one partition only.
+ */
+void PartitionedStore::leafEntries(size_t position, size_t leaf, vector<pair<Key, Entry> > &entries) {
+	Partition *partition = partitions[position % RING_SIZE];
+	LeafScan scan;
+	entries.clear();
+	if ( partition == NULL ) {
+		return;
+	}
+	scan.leaf = leaf;
+	partition->engine->forEachRecord(collectLeaf, &scan);
+	for ( size_t i = 0; i < scan.keys.size(); i++ ) {
+		Entry entry;
+		if ( partition->engine->readEntry(scan.keys[i], entry, true) ) {
+			entries.push_back(make_pair(scan.keys[i], entry));
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: repair
+ *
+ * DESCRIPTION: Applies an entry shipped by a replica, the newer version wins
+ * 				as for any other write
+ *
+ * RETURNS:
+ * true if the entry changed the store
+ */
+bool PartitionedStore::repair(const Key &key, const Entry &entry, int time) {
+	Entry shipped = entry;
+	if ( shipped.isTombstone() ) {
+		return deleteKey(key, shipped.version, time);
+	}
+	return create(key, shipped);
+}
+
+/**
+ * FUNCTION NAME: detach
+ *
+ * DESCRIPTION: Takes the partition of a position out of the store, keys, hash
+ * 				tree and open files included, to hand it to another node
+ *
+ * RETURNS:
+ * the partition, to be deleted by the caller, NULL if the position has none
+ */
+Partition *PartitionedStore::detach(size_t position) {
+	Partition *partition = partitions[position % RING_SIZE];
+	if ( partition != NULL ) {
+		leaveBudget(position % RING_SIZE);
+		partitions[position % RING_SIZE] = NULL;
+		numPartitions--;
+	}
+	return partition;
+}
+
+/**
+ * FUNCTION NAME: attach
+ *
+ * DESCRIPTION: Makes partition the one of position, the store then owns it
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the position already has a partition, which is left as it is
+ */
+bool PartitionedStore::attach(size_t position, Partition *partition) {
+	if ( partitions[position % RING_SIZE] != NULL ) {
+		return false;
+	}
+	partitions[position % RING_SIZE] = partition;
+	numPartitions++;
+	partition->engine->setOrderedIndex(orderedIndex);
+	joinBudget(position % RING_SIZE);
+	// Whatever the partition logged before it came here is synced with the next writes
+	markUnsynced(position % RING_SIZE);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: positionsIn
+ *
+ * DESCRIPTION: Returns the positions with a partition in the ring range
+ * 				(from, to], which wraps around past RING_SIZE - 1 when to
+ * 				is not above from. from == to is the whole ring.
+ */
+vector<size_t> PartitionedStore::positionsIn(size_t from, size_t to) {
+	vector<size_t> positions;
+	from %= RING_SIZE;
+	to %= RING_SIZE;
+	size_t position = (from + 1) % RING_SIZE;
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		if ( partitions[position] != NULL ) {
+			positions.push_back(position);
+		}
+		if ( position == to ) {
+			break;
+		}
+		position = (position + 1) % RING_SIZE;
+	}
+	return positions;
+}
+
+/**
+ * FUNCTION NAME: dropRange
+ *
+ * DESCRIPTION: Deletes the partitions of the ring range (from, to] along with
+ * 				their log and snapshot files, once this node no longer holds
+ * 				a replica of the range
+ *
+ * RETURNS:
+ * number of keys dropped
+ */
+unsigned long PartitionedStore::dropRange(size_t from, size_t to) {
+	unsigned long dropped = 0;
+	vector<size_t> positions = positionsIn(from, to);
+	for ( size_t i = 0; i < positions.size(); i++ ) {
+		Partition *partition = detach(positions[i]);
+		dropped += partition->engine->currentSize();
+		// Leaves nothing behind that a restart could bring back
+		partition->engine->clear();
+		delete partition;
+		removeFiles(positions[i]);
+	}
+	return dropped;
+}
+
+/**
+ * FUNCTION NAME: partitionCount
+ *
+ * DESCRIPTION: Returns the number of partitions the store holds
+ */
+unsigned int PartitionedStore::partitionCount() {
+	return numPartitions;
+}
+
+/**
+ * FUNCTION NAME: removeFiles
+ *
+ * DESCRIPTION: Removes the logs, the snapshots and the emptied table directory
+ * 				of a dropped partition
+ */
+void PartitionedStore::removeFiles(size_t position) {
+	vector<pair<size_t, string> > files;
+	if ( !logPath.empty() ) {
+		filesOnDisk(logPath, files);
+	}
+	if ( !snapshotPath.empty() ) {
+		filesOnDisk(snapshotPath, files);
+	}
+	for ( size_t i = 0; i < files.size(); i++ ) {
+		if ( files[i].first == position ) {
+			unlink(files[i].second.c_str());
+		}
+	}
+	if ( engineType == "LSM" ) {
+		unlink((partitionPath(dataPath, position) + "/MANIFEST").c_str());
+		rmdir(partitionPath(dataPath, position).c_str());
+	}
+}
+
+/**
+ * FUNCTION NAME: partitionPath
+ *
+ * DESCRIPTION: Returns the file name of the partition of position for a store file
+ */
+string PartitionedStore::partitionPath(const string &path, size_t position) {
+	return path + "." + to_string(position);
+}
+
+/**
+ * FUNCTION NAME: positionsOnDisk
+ *
+ * DESCRIPTION: Lists the positions that have a file of the store file path
+ */
+vector<size_t> PartitionedStore::positionsOnDisk(const string &path) {
+	vector<pair<size_t, string> > files;
+	vector<size_t> positions;
+	filesOnDisk(path, files);
+	for ( size_t i = 0; i < files.size(); i++ ) {
+		positions.push_back(files[i].first);
+	}
+	sort(positions.begin(), positions.end());
+	positions.erase(unique(positions.begin(), positions.end()), positions.end());
+	return positions;
+}
+
+/**
+ * FUNCTION NAME: filesOnDisk
+ *
+ * DESCRIPTION: Adds the (position, file name) of every file named path.<position>
+ * 				to files, along with path.<position>.<anything> for engines
+ * 				that keep several files
+ */
+void PartitionedStore::filesOnDisk(const string &path, vector<pair<size_t, string> > &files) {
+	size_t slash = path.rfind('/');
+	string dir = slash == string::npos ? "." : path.substr(0, slash);
+	string prefix = (slash == string::npos ? path : path.substr(slash + 1)) + ".";
+	DIR *dp = opendir(dir.c_str());
+	if ( dp == NULL ) {
+		return;
+	}
+	struct dirent *entry;
+	while ( (entry = readdir(dp)) != NULL ) {
+		string name = entry->d_name;
+		if ( name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0 ) {
+			continue;
+		}
+		string digits = name.substr(prefix.size());
+		digits = digits.substr(0, digits.find('.'));
+		if ( digits.empty() || digits.size() > 3 || digits.find_first_not_of("0123456789") != string::npos ) {
+			continue;
+		}
+		size_t position = (size_t)atoi(digits.c_str());
+		// Rejects leading zeros, which no partition is named with
+		if ( position < RING_SIZE && to_string(position) == digits ) {
+			files.push_back(make_pair(position, dir + "/" + name));
+		}
+	}
+	closedir(dp);
+}
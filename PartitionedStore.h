@@ -0,0 +1,150 @@
+/**********************************
+ * FILE NAME: PartitionedStore.h
+ *
+ * DESCRIPTION: Header file of the local store split into one table per ring position
+ **********************************/
+
+#ifndef PARTITIONEDSTORE_H_
+#define PARTITIONEDSTORE_H_
+
+#include "stdincludes.h"
+#include "StorageEngine.h"
+#include "MerkleTree.h"
+
+/*
+ * Macros
+ */
+// most times one write may reclaim memory from other partitions to get under the limit
+#define PARTITION_RECLAIM_BATCH 16
+
+/**
+ * CLASS NAME: Partition
+ *
+ * DESCRIPTION: The engine holding the keys of one ring position, with the
+ * 				hash tree of its live keys. Owns the engine.
+ */
+class Partition {
+public:
+	StorageEngine *engine;
+	MerkleTree tree;
+	Partition(StorageEngine *engine): engine(engine) {}
+	~Partition() {
+		delete engine;
+	}
+	void rebuildTree();
+private:
+	Partition(const Partition &anotherPartition);
+	Partition& operator =(const Partition &anotherPartition);
+	static void addToTree(void *env, const Slice &key, const EntryRecord &record);
+};
+
+/**
+ * CLASS NAME: PartitionedStore
+ *
+ * DESCRIPTION: Local store made of one partition per position of the ring.
+ * 				A key lives in the partition of its ring position, the same
+ * 				position findNodes places it with, so the range a node owns
+ * 				on the ring is always a whole set of partitions. Handing a
+ * 				range off or dropping it detaches those partitions without
+ * 				looking at any key.
+ *
+ * 				Partitions are engines of the type STORAGE_ENGINE names and
+ * 				are created by the first write to their position. Partition
+ * 				files are named after the store file with .<position> added.
+ * 				syncLog() only syncs the logs of the partitions written since
+ * 				the last one, so a node pays for the partitions it writes,
+ * 				not for all it holds.
+ * 				A memory limit is one MemoryBudget for the whole store. The
+ * 				bytes of every partition are counted after each write, and a
+ * 				new key that finds the store over the limit first reclaims
+ * 				memory from the partition taking up the most. A partition
+ * 				may grow into whatever the others leave unused, and resize
+ * 				into the keys of larger ones while it stays no larger than
+ * 				they are. Slots never shrink, so a partition growing past
+ * 				the others by taking their keys would leave them for good.
+ *
+ * 				Writes keep the MerkleTree of their partition up to date, so
+ * 				replicas find the keys they disagree on by comparing trees
+ * 				and exchanging only the entries of the leaves that differ.
+ * 				Under an eviction policy the trees follow the writes, not
+ * 				the keys eviction kept.
+ *
+ * 				Keys are spread over partitions by hash, so a scan asks every
+ * 				partition for up to limit keys and keeps the first limit.
+ */
+class PartitionedStore : public StorageEngine {
+public:
+	PartitionedStore(const string &engineType, const string &dataPath);
+	static size_t positionOf(const Key &key);
+	bool create(const Key &key, const Entry &entry);
+	string read(const Key &key);
+	bool readEntry(const Key &key, Entry &entry, bool withTombstones = false);
+	bool update(const Key &key, const Entry &entry);
+	bool deleteKey(const Key &key, uint64_t version, int time);
+	unsigned long currentSize();
+	unsigned long tombstoneCount();
+	void countKeys(unsigned long &live, unsigned long &tombstones);
+	void clear();
+	unsigned long count(const Key &key);
+	bool mayContain(const Key &key);
+	bool liveVersion(const Key &key, uint64_t &version);
+	BloomStats filterStats();
+	void forEachRecord(RecordVisitFn visit, void *env);
+	void scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries);
+	void setOrderedIndex(bool enabled);
+	MemoryUsage memoryUsage();
+	void setMemoryLimit(unsigned long bytes, const string &policy);
+	void setMemoryBudget(const MemoryBudget *budget, const string &policy);
+	unsigned long memoryBytes();
+	unsigned long growthBytes();
+	unsigned long reclaim(unsigned long count);
+	unsigned long compact(int time, int gracePeriod, unsigned long budget);
+	bool openLog(const string &path, int syncIntervalMs);
+	bool syncLog();
+	bool dumpSnapshot(const string &path);
+	bool openSnapshot(const string &path);
+	unsigned long warmSnapshot(unsigned long budget);
+	// anti-entropy
+	const MerkleTree *treeOf(size_t position);
+	void leafEntries(size_t position, size_t leaf, vector<pair<Key, Entry> > &entries);
+	bool repair(const Key &key, const Entry &entry, int time);
+	// rebalancing
+	Partition *detach(size_t position);
+	bool attach(size_t position, Partition *partition);
+	vector<size_t> positionsIn(size_t from, size_t to);
+	unsigned long dropRange(size_t from, size_t to);
+	unsigned int partitionCount();
+	virtual ~PartitionedStore();
+private:
+	Partition *partitions[RING_SIZE];
+	unsigned int numPartitions;
+	string engineType;
+	string dataPath;
+	string logPath;
+	int syncIntervalMs;
+	// positions written since the last syncLog, each listed once
+	vector<size_t> unsyncedPositions;
+	bool unsynced[RING_SIZE];
+	string snapshotPath;
+	MemoryBudget memoryBudget;
+	// bytes of every partition as last counted into the budget
+	unsigned long partitionBytes[RING_SIZE];
+	string evictionPolicy;
+	bool orderedIndex;
+	PartitionedStore(const PartitionedStore &anotherStore);
+	PartitionedStore& operator =(const PartitionedStore &anotherStore);
+	Partition *partitionOf(const Key &key, bool create);
+	Partition *newPartition(size_t position);
+	void joinBudget(size_t position);
+	void leaveBudget(size_t position);
+	void account(size_t position);
+	long largestPartition(const vector<bool> &passed);
+	void makeRoom(size_t position, unsigned long bytes);
+	void markUnsynced(size_t position);
+	void removeFiles(size_t position);
+	static string partitionPath(const string &path, size_t position);
+	static vector<size_t> positionsOnDisk(const string &path);
+	static void filesOnDisk(const string &path, vector<pair<size_t, string> > &files);
+};
+
+#endif /* PARTITIONEDSTORE_H_ */
@@ -0,0 +1,235 @@
+/**********************************
+ * FILE NAME: ReadCache.cpp
+ *
+ * DESCRIPTION: Definition of the coordinator side cache of read results
+ **********************************/
+
+#include "ReadCache.h"
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: Sizes the sketch to a power of two number of counters per row,
+ * 				at least one per cached key
+ */
+FrequencySketch::FrequencySketch(unsigned long capacity): additions(0) {
+	width = 16;
+	while ( width < capacity ) {
+		width <<= 1;
+	}
+	counters.assign(width * SKETCH_DEPTH, 0);
+	sampleSize = max(capacity, 1UL) * SKETCH_SAMPLE_FACTOR;
+}
+
+/**
+ * FUNCTION NAME: indexOf
+ *
+ * DESCRIPTION: Counter of the key of this hash in a row, every row remixes the hash
+ */
+size_t FrequencySketch::indexOf(uint64_t hash, int row) {
+	static const uint64_t seeds[SKETCH_DEPTH] = {
+		0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+	};
+	uint64_t h = (hash ^ seeds[row]) * 0x9E3779B97F4A7C15ULL;
+	return row * width + ((h >> 32) & (width - 1));
+}
+
+/**
+ * FUNCTION NAME: increment
+ *
+ * DESCRIPTION: Counts one access to the key of this hash
+ */
+void FrequencySketch::increment(uint64_t hash) {
+	for ( int row = 0; row < SKETCH_DEPTH; row++ ) {
+		uint8_t &counter = counters[indexOf(hash, row)];
+		if ( counter < 15 ) {
+			counter++;
+		}
+	}
+	if ( ++additions >= sampleSize ) {
+		age();
+	}
+}
+
+/**
+ * FUNCTION NAME: estimate
+ *
+ * DESCRIPTION: Returns how often the key of this hash was accessed lately, an upper bound
+ */
+int FrequencySketch::estimate(uint64_t hash) {
+	int frequency = 15;
+	for ( int row = 0; row < SKETCH_DEPTH; row++ ) {
+		frequency = min(frequency, (int)counters[indexOf(hash, row)]);
+	}
+	return frequency;
+}
+
+/**
+ * FUNCTION NAME: age
+ *
+ * DESCRIPTION: Halves every counter
+ */
+void FrequencySketch::age() {
+	for ( size_t i = 0; i < counters.size(); i++ ) {
+		counters[i] >>= 1;
+	}
+	additions /= 2;
+}
+
+/**
+ * Constructor
+ */
+ReadCache::ReadCache(unsigned long capacity, int ttl): sketch(capacity), ttl(ttl), hits(0), misses(0) {
+	capacity = max(capacity, 2UL);
+	windowCapacity = max(capacity * READ_CACHE_WINDOW_PERCENT / 100, 1UL);
+	mainCapacity = capacity - windowCapacity;
+	protectedCapacity = mainCapacity * READ_CACHE_PROTECTED_PERCENT / 100;
+}
+
+list<CachedRead> &ReadCache::segmentOf(int segment) {
+	return segment == 0 ? window : (segment == 1 ? probation : protectedSegment);
+}
+
+/**
+ * FUNCTION NAME: moveTo
+ *
+ * DESCRIPTION: Moves an entry to the front of a segment, no copy is made
+ */
+void ReadCache::moveTo(Position position, int segment) {
+	segmentOf(segment).splice(segmentOf(segment).begin(), segmentOf(position->segment), position);
+	position->segment = segment;
+}
+
+/**
+ * FUNCTION NAME: evict
+ *
+ * DESCRIPTION: Drops an entry
+ */
+void ReadCache::evict(Position position) {
+	index.erase(position->key);
+	segmentOf(position->segment).erase(position);
+}
+
+/**
+ * FUNCTION NAME: get
+ *
+ * DESCRIPTION: Looks key up and counts the access in the sketch.
+ * 				A hit in probation promotes the key to the protected segment,
+ * 				whose least recent key falls back to probation if it is full.
+ *
+ * RETURNS:
+ * true with value set on a hit
+ * false on a miss or a value older than the ttl
+ */
+bool ReadCache::get(const Key &key, int now, string &value) {
+	sketch.increment(key.hash());
+	unordered_map<Key, Position, KeyHasher>::iterator found = index.find(key);
+	if ( found == index.end() ) {
+		misses++;
+		return false;
+	}
+	Position position = found->second;
+	if ( now - position->filledAt > ttl ) {
+		evict(position);
+		misses++;
+		return false;
+	}
+	if ( position->segment == 1 ) {
+		moveTo(position, 2);
+		if ( protectedSegment.size() > protectedCapacity ) {
+			moveTo(--protectedSegment.end(), 1);
+		}
+	}
+	else {
+		moveTo(position, position->segment);
+	}
+	value = position->value;
+	hits++;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Caches the value a read returned. A new key starts in the window.
+ */
+void ReadCache::put(const Key &key, const string &value, int now) {
+	unordered_map<Key, Position, KeyHasher>::iterator found = index.find(key);
+	if ( found != index.end() ) {
+		found->second->value = value;
+		found->second->filledAt = now;
+		return;
+	}
+	CachedRead entry;
+	entry.key = key;
+	entry.value = value;
+	entry.filledAt = now;
+	entry.segment = 0;
+	window.push_front(entry);
+	index[key] = window.begin();
+	if ( window.size() > windowCapacity ) {
+		evictFromWindow();
+	}
+}
+
+/**
+ * FUNCTION NAME: evictFromWindow
+ *
+ * DESCRIPTION: Moves the least recent key of the window to probation while the
+ * 				main segments have room. Once they are full the key only gets
+ * 				in if the sketch rates it above the key probation would evict.
+ */
+void ReadCache::evictFromWindow() {
+	Position candidate = --window.end();
+	if ( probation.size() + protectedSegment.size() < mainCapacity ) {
+		moveTo(candidate, 1);
+		return;
+	}
+	list<CachedRead> &victims = probation.empty() ? protectedSegment : probation;
+	if ( victims.empty() ) {
+		evict(candidate);
+		return;
+	}
+	Position victim = --victims.end();
+	if ( sketch.estimate(candidate->key.hash()) > sketch.estimate(victim->key.hash()) ) {
+		evict(victim);
+		moveTo(candidate, 1);
+	}
+	else {
+		evict(candidate);
+	}
+}
+
+/**
+ * FUNCTION NAME: invalidate
+ *
+ * DESCRIPTION: Drops the cached value of key, if any
+ */
+void ReadCache::invalidate(const Key &key) {
+	unordered_map<Key, Position, KeyHasher>::iterator found = index.find(key);
+	if ( found != index.end() ) {
+		evict(found->second);
+	}
+}
+
+unsigned long ReadCache::size() {
+	return index.size();
+}
+
+unsigned long ReadCache::hitCount() {
+	return hits;
+}
+
+unsigned long ReadCache::missCount() {
+	return misses;
+}
+
+/**
+ * FUNCTION NAME: hitRatio
+ *
+ * DESCRIPTION: Returns the share of reads answered from the cache
+ */
+double ReadCache::hitRatio() {
+	unsigned long reads = hits + misses;
+	return reads == 0 ? 0.0 : (double)hits / reads;
+}
@@ -0,0 +1,100 @@
+/**********************************
+ * FILE NAME: ReadCache.h
+ *
+ * DESCRIPTION: Header file of the coordinator side cache of read results
+ **********************************/
+
+#ifndef READCACHE_H_
+#define READCACHE_H_
+
+#include "stdincludes.h"
+#include "Key.h"
+#include <list>
+#include <unordered_map>
+
+/*
+ * Macros
+ */
+#define SKETCH_DEPTH 4
+// counters are halved once this many accesses per cached key were counted
+#define SKETCH_SAMPLE_FACTOR 10
+// share of the capacity given to the admission window, in percent
+#define READ_CACHE_WINDOW_PERCENT 1
+// share of the main space given to the protected segment, in percent
+#define READ_CACHE_PROTECTED_PERCENT 80
+
+/**
+ * CLASS NAME: FrequencySketch
+ *
+ * DESCRIPTION: Count-min sketch of how often keys were accessed lately.
+ * 				Counters saturate at 15 and are all halved every sample
+ * 				period, so old popularity fades.
+ */
+class FrequencySketch {
+public:
+	FrequencySketch(unsigned long capacity);
+	void increment(uint64_t hash);
+	int estimate(uint64_t hash);
+private:
+	vector<uint8_t> counters;
+	size_t width;
+	unsigned long additions;
+	unsigned long sampleSize;
+	size_t indexOf(uint64_t hash, int row);
+	void age();
+};
+
+/**
+ * STRUCT NAME: CachedRead
+ *
+ * DESCRIPTION: A cached value and the time it was filled at
+ */
+typedef struct CachedRead {
+	Key key;
+	string value;
+	int filledAt;
+	// 0 window, 1 probation, 2 protected
+	int segment;
+} CachedRead;
+
+/**
+ * CLASS NAME: ReadCache
+ *
+ * DESCRIPTION: Bounded cache of read results with W-TinyLFU admission.
+ * 				New keys enter a small LRU window. A key pushed out of the
+ * 				window only gets into the main segmented LRU if the sketch
+ * 				has seen it more often than the key it would evict, so one
+ * 				off reads do not flush hot keys. A value older than ttl time
+ * 				units is never served.
+ */
+class ReadCache {
+public:
+	ReadCache(unsigned long capacity, int ttl);
+	bool get(const Key &key, int now, string &value);
+	void put(const Key &key, const string &value, int now);
+	void invalidate(const Key &key);
+	unsigned long size();
+	unsigned long hitCount();
+	unsigned long missCount();
+	double hitRatio();
+private:
+	typedef list<CachedRead>::iterator Position;
+	FrequencySketch sketch;
+	unsigned long windowCapacity;
+	unsigned long mainCapacity;
+	unsigned long protectedCapacity;
+	int ttl;
+	// most recently used at the front
+	list<CachedRead> window;
+	list<CachedRead> probation;
+	list<CachedRead> protectedSegment;
+	unordered_map<Key, Position, KeyHasher> index;
+	unsigned long hits;
+	unsigned long misses;
+	list<CachedRead> &segmentOf(int segment);
+	void moveTo(Position position, int segment);
+	void evict(Position position);
+	void evictFromWindow();
+};
+
+#endif /* READCACHE_H_ */
@@ -0,0 +1,109 @@
+/**********************************
+ * FILE NAME: RecordIterator.h
+ *
+ * DESCRIPTION: Iteration over the sorted records of a memtable or SSTable
+ **********************************/
+
+#ifndef RECORDITERATOR_H_
+#define RECORDITERATOR_H_
+
+#include "stdincludes.h"
+#include "Entry.h"
+
+/**
+ * CLASS NAME: RecordIterator
+ *
+ * DESCRIPTION: Walks (key, record) pairs in byte wise key order, every key once.
+ * 				key() and record() stay valid until the next call to next().
+ */
+class RecordIterator {
+public:
+	virtual ~RecordIterator() {}
+	virtual bool valid() = 0;
+	virtual void next() = 0;
+	virtual const Slice &key() = 0;
+	virtual const EntryRecord &record() = 0;
+	// moves forward to the first key not below target, iterators that can
+	// jump there override it
+	virtual void seek(const Slice &target) {
+		while ( valid() && key().compare(target) < 0 ) {
+			next();
+		}
+	}
+	// true if iteration stopped early at damaged data
+	virtual bool corrupted() {
+		return false;
+	}
+};
+
+/**
+ * CLASS NAME: MergingIterator
+ *
+ * DESCRIPTION: Merges sorted iterators into one, newest first.
+ * 				When several inputs hold the same key only the record of the
+ * 				first of them is returned, the older ones are skipped.
+ * 				The inputs are owned, and deleted, by the merging iterator.
+ */
+class MergingIterator : public RecordIterator {
+public:
+	MergingIterator(const vector<RecordIterator *> &inputs): inputs(inputs), current(-1) {
+		pick();
+	}
+	virtual ~MergingIterator() {
+		for ( size_t i = 0; i < inputs.size(); i++ ) {
+			delete inputs[i];
+		}
+	}
+	virtual bool valid() {
+		return current >= 0;
+	}
+	virtual void next() {
+		// Step every input past the current key, the one it came from last
+		// as its key bytes may not outlive the step
+		const Slice &skipped = inputs[current]->key();
+		for ( size_t i = 0; i < inputs.size(); i++ ) {
+			if ( (int)i != current && inputs[i]->valid() && inputs[i]->key() == skipped ) {
+				inputs[i]->next();
+			}
+		}
+		inputs[current]->next();
+		pick();
+	}
+	virtual const Slice &key() {
+		return inputs[current]->key();
+	}
+	virtual const EntryRecord &record() {
+		return inputs[current]->record();
+	}
+	virtual void seek(const Slice &target) {
+		for ( size_t i = 0; i < inputs.size(); i++ ) {
+			inputs[i]->seek(target);
+		}
+		pick();
+	}
+	virtual bool corrupted() {
+		for ( size_t i = 0; i < inputs.size(); i++ ) {
+			if ( inputs[i]->corrupted() ) {
+				return true;
+			}
+		}
+		return false;
+	}
+private:
+	vector<RecordIterator *> inputs;
+	int current;
+	MergingIterator(const MergingIterator &anotherIterator);
+	MergingIterator& operator =(const MergingIterator &anotherIterator);
+
+	// The inputs are few, a linear scan for the smallest key beats a heap
+	void pick() {
+		current = -1;
+		for ( size_t i = 0; i < inputs.size(); i++ ) {
+			if ( inputs[i]->valid() && (current < 0 || inputs[i]->key().compare(inputs[current]->key()) < 0) ) {
+				current = (int)i;
+			}
+		}
+	}
+};
+
+#endif /* RECORDITERATOR_H_ */
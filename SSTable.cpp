@@ -0,0 +1,456 @@
+/**********************************
+ * FILE NAME: SSTable.cpp
+ *
+ * DESCRIPTION: Definition of the immutable sorted tables of LSMTable
+ **********************************/
+
+#include "SSTable.h"
+#include "Coding.h"
+#include "Crc32.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * CLASS NAME: SSTableIterator
+ *
+ * DESCRIPTION: Walks the records of an SSTable block by block.
+ * 				Iteration ends early at a block that fails its crc.
+ */
+class SSTableIterator : public RecordIterator {
+public:
+	SSTableIterator(SSTable *table): table(table), block(0), ptr(NULL), limit(NULL), isValid(false), isCorrupted(false) {
+		if ( !table->blocks.empty() ) {
+			isCorrupted = !table->readBlock(0, ptr, limit);
+			if ( !isCorrupted ) {
+				decode();
+			}
+		}
+	}
+	virtual bool valid() {
+		return isValid;
+	}
+	virtual void next() {
+		if ( ptr == limit ) {
+			if ( ++block >= table->blocks.size() ) {
+				isValid = false;
+				return;
+			}
+			if ( !table->readBlock(block, ptr, limit) ) {
+				isValid = false;
+				isCorrupted = true;
+				return;
+			}
+		}
+		decode();
+	}
+	virtual const Slice &key() {
+		return currentKey;
+	}
+	virtual const EntryRecord &record() {
+		return currentRecord;
+	}
+	virtual bool corrupted() {
+		return isCorrupted;
+	}
+	virtual void seek(const Slice &target) {
+		// Jump straight to the block that may hold target, then walk it
+		size_t found = table->blockOf(target);
+		if ( found >= table->blocks.size() ) {
+			isValid = false;
+			return;
+		}
+		if ( isValid && found > block ) {
+			block = found;
+			if ( !table->readBlock(block, ptr, limit) ) {
+				isValid = false;
+				isCorrupted = true;
+				return;
+			}
+			decode();
+		}
+		RecordIterator::seek(target);
+	}
+private:
+	SSTable *table;
+	size_t block;
+	const char *ptr;
+	const char *limit;
+	bool isValid;
+	bool isCorrupted;
+	Slice currentKey;
+	EntryRecord currentRecord;
+
+	void decode() {
+		ptr = decodeRecord(ptr, limit, currentKey, currentRecord);
+		isValid = ptr != NULL;
+		isCorrupted = ptr == NULL;
+	}
+};
+
+/**
+ * Constructor
+ */
+SSTableBuilder::SSTableBuilder(): fp(NULL), offset(0), numRecords(0), ok(false) {}
+
+/**
+ * Destructor
+ */
+SSTableBuilder::~SSTableBuilder() {
+	abandon();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Starts a new table that finish() will put at path
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool SSTableBuilder::open(const string &path) {
+	abandon();
+	this->path = path;
+	fp = fopen((path + ".tmp").c_str(), "wb");
+	block.clear();
+	index.clear();
+	lastKey.clear();
+	hashes.clear();
+	offset = 0;
+	numRecords = 0;
+	ok = fp != NULL;
+	return ok;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Appends a record, keys must come in increasing order
+ */
+void SSTableBuilder::add(const Slice &key, const EntryRecord &record) {
+	encodeRecord(block, key, record);
+	lastKey.assign(key.data, key.size);
+	hashes.push_back(hashBytes(key));
+	numRecords++;
+	if ( block.size() >= SSTABLE_BLOCK_SIZE ) {
+		flushBlock();
+	}
+}
+
+/**
+ * FUNCTION NAME: flushBlock
+ *
+ * DESCRIPTION: Writes the current block with its crc and indexes it by its last key
+ */
+void SSTableBuilder::flushBlock() {
+	if ( block.empty() || fp == NULL ) {
+		return;
+	}
+	putLengthPrefixed(index, lastKey.data(), lastKey.size());
+	putFixed64(index, offset);
+	putFixed32(index, (uint32_t)block.size());
+	putFixed32(block, crc32(block.data(), block.size()));
+	ok = ok && fwrite(block.data(), 1, block.size(), fp) == block.size();
+	offset += block.size();
+	block.clear();
+}
+
+/**
+ * FUNCTION NAME: finish
+ *
+ * DESCRIPTION: Writes the index and footer, syncs the file and renames it into place
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool SSTableBuilder::finish() {
+	if ( fp == NULL ) {
+		return false;
+	}
+	flushBlock();
+	BloomFilter filter;
+	filter.reset(hashes.size());
+	for ( size_t i = 0; i < hashes.size(); i++ ) {
+		filter.add(hashes[i]);
+	}
+	Slice filterBytes = filter.data();
+	string padding((BLOOM_BLOCK_BYTES - offset % BLOOM_BLOCK_BYTES) % BLOOM_BLOCK_BYTES, '\0');
+	uint64_t filterOffset = offset + padding.size();
+	uint64_t indexOffset = filterOffset + filterBytes.size;
+
+	string footer(SSTABLE_MAGIC, 8);
+	putFixed64(footer, indexOffset);
+	putFixed64(footer, index.size());
+	putFixed64(footer, filterOffset);
+	putFixed64(footer, filterBytes.size);
+	putFixed64(footer, numRecords);
+	putFixed32(footer, crc32(index.data(), index.size()));
+	putFixed32(footer, crc32(filterBytes.data, filterBytes.size));
+	putFixed32(footer, crc32(footer.data(), footer.size()));
+	ok = ok && fwrite(padding.data(), 1, padding.size(), fp) == padding.size();
+	ok = ok && fwrite(filterBytes.data, 1, filterBytes.size, fp) == filterBytes.size;
+	ok = ok && fwrite(index.data(), 1, index.size(), fp) == index.size();
+	ok = ok && fwrite(footer.data(), 1, footer.size(), fp) == footer.size();
+	ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+	ok = (fclose(fp) == 0) && ok;
+	fp = NULL;
+	if ( !ok || rename((path + ".tmp").c_str(), path.c_str()) != 0 ) {
+		unlink((path + ".tmp").c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: abandon
+ *
+ * DESCRIPTION: Drops a table that was not finished
+ */
+void SSTableBuilder::abandon() {
+	if ( fp != NULL ) {
+		fclose(fp);
+		fp = NULL;
+		unlink((path + ".tmp").c_str());
+	}
+}
+
+/**
+ * FUNCTION NAME: fileSize
+ *
+ * DESCRIPTION: Returns the number of bytes written or buffered so far
+ */
+uint64_t SSTableBuilder::fileSize() {
+	return offset + block.size();
+}
+
+unsigned long SSTableBuilder::count() {
+	return numRecords;
+}
+
+/**
+ * Constructor
+ */
+SSTable::SSTable(): base(NULL), mappedSize(0), numRecords(0), number(0) {}
+
+/**
+ * Destructor
+ */
+SSTable::~SSTable() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Maps the table at path, checks its footer and index and decodes the index
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the file is missing or damaged
+ */
+bool SSTable::open(const string &path, uint64_t number) {
+	struct stat st;
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if ( fd < 0 ) {
+		return false;
+	}
+	if ( fstat(fd, &st) != 0 || st.st_size < SSTABLE_FOOTER_SIZE ) {
+		::close(fd);
+		return false;
+	}
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if ( mem == MAP_FAILED ) {
+		return false;
+	}
+	base = (const char *)mem;
+	mappedSize = st.st_size;
+	this->path = path;
+	this->number = number;
+
+	const char *footer = base + mappedSize - SSTABLE_FOOTER_SIZE;
+	uint64_t indexOffset = decodeFixed64(footer + 8);
+	uint64_t indexSize = decodeFixed64(footer + 16);
+	uint64_t filterOffset = decodeFixed64(footer + 24);
+	uint64_t filterSize = decodeFixed64(footer + 32);
+	bool valid = memcmp(footer, SSTABLE_MAGIC, 8) == 0
+		&& decodeFixed32(footer + 56) == crc32(footer, 56)
+		&& indexOffset + indexSize == mappedSize - SSTABLE_FOOTER_SIZE
+		&& filterOffset + filterSize == indexOffset
+		&& decodeFixed32(footer + 48) == crc32(base + indexOffset, indexSize)
+		&& decodeFixed32(footer + 52) == crc32(base + filterOffset, filterSize)
+		&& filter.attach(Slice(base + filterOffset, filterSize));
+	const char *p = base + indexOffset;
+	const char *limit = p + indexSize;
+	while ( valid && p < limit ) {
+		SSTableBlock block;
+		uint64_t size;
+		p = getVarint(p, limit, size);
+		if ( p == NULL || (uint64_t)(limit - p) < size + 12 ) {
+			valid = false;
+			break;
+		}
+		block.lastKey = Slice(p, size);
+		block.offset = decodeFixed64(p + size);
+		block.size = decodeFixed32(p + size + 8);
+		p += size + 12;
+		valid = block.offset + block.size + 4 <= filterOffset;
+		blocks.push_back(block);
+	}
+	const char *data;
+	const char *dataLimit;
+	EntryRecord record;
+	if ( !valid || blocks.empty() || !readBlock(0, data, dataLimit) || decodeRecord(data, dataLimit, smallest, record) == NULL ) {
+		close();
+		return false;
+	}
+	numRecords = decodeFixed64(footer + 40);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Unmaps the table
+ */
+void SSTable::close() {
+	if ( base != NULL ) {
+		munmap((void *)base, mappedSize);
+	}
+	base = NULL;
+	mappedSize = 0;
+	blocks.clear();
+	filter.attach(Slice());
+	smallest = Slice();
+	numRecords = 0;
+}
+
+/**
+ * FUNCTION NAME: readBlock
+ *
+ * DESCRIPTION: Checks block i against its crc and returns the range of its records
+ */
+bool SSTable::readBlock(size_t i, const char *&data, const char *&limit) {
+	const SSTableBlock &block = blocks[i];
+	data = base + block.offset;
+	limit = data + block.size;
+	return crc32(data, block.size) == decodeFixed32(limit);
+}
+
+/**
+ * FUNCTION NAME: blockOf
+ *
+ * DESCRIPTION: Returns the first block whose last key is not below key, the
+ * 				only one that may hold it. blocks.size() if key is past the table.
+ */
+size_t SSTable::blockOf(const Slice &key) {
+	size_t lo = 0;
+	size_t hi = blocks.size();
+	while ( lo < hi ) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ( blocks[mid].lastKey.compare(key) < 0 ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/**
+ * FUNCTION NAME: get
+ *
+ * DESCRIPTION: Finds the block that may hold key and looks for it there.
+ * 				The value of the record points into the mapping.
+ *
+ * RETURNS:
+ * true if the key is in the table, tombstones included
+ * false otherwise
+ */
+bool SSTable::get(const Slice &key, EntryRecord &record) {
+	size_t lo = blockOf(key);
+	const char *p;
+	const char *limit;
+	if ( lo == blocks.size() || !readBlock(lo, p, limit) ) {
+		return false;
+	}
+	while ( p != NULL && p < limit ) {
+		Slice found;
+		p = decodeRecord(p, limit, found, record);
+		if ( p == NULL ) {
+			break;
+		}
+		int c = found.compare(key);
+		if ( c == 0 ) {
+			return true;
+		}
+		if ( c > 0 ) {
+			break;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: Checks the filter of the table for the key of this hashBytes hash
+ */
+bool SSTable::mayContain(uint64_t hash) {
+	return filter.mayContain(hash);
+}
+
+/**
+ * FUNCTION NAME: newIterator
+ *
+ * DESCRIPTION: Returns an iterator over every record, to be deleted by the caller
+ */
+RecordIterator *SSTable::newIterator() {
+	return new SSTableIterator(this);
+}
+
+/**
+ * FUNCTION NAME: overlaps
+ *
+ * DESCRIPTION: Returns if any key of the table may fall in [smallest, largest]
+ */
+bool SSTable::overlaps(const Slice &smallest, const Slice &largest) {
+	return this->smallest.compare(largest) <= 0 && largestKey().compare(smallest) >= 0;
+}
+
+uint64_t SSTable::getNumber() {
+	return number;
+}
+
+const string &SSTable::getPath() {
+	return path;
+}
+
+const Slice &SSTable::smallestKey() {
+	return smallest;
+}
+
+const Slice &SSTable::largestKey() {
+	return blocks.back().lastKey;
+}
+
+uint64_t SSTable::fileSize() {
+	return mappedSize;
+}
+
+unsigned long SSTable::recordCount() {
+	return numRecords;
+}
+
+/**
+ * FUNCTION NAME: indexBytes
+ *
+ * DESCRIPTION: Returns the bytes of the block index held in memory. Data blocks
+ * 				and the filter are read from the mapping.
+ */
+size_t SSTable::indexBytes() {
+	return blocks.capacity() * sizeof(SSTableBlock);
+}
@@ -0,0 +1,116 @@
+/**********************************
+ * FILE NAME: SSTable.h
+ *
+ * DESCRIPTION: Header file of the immutable sorted tables of LSMTable
+ **********************************/
+
+#ifndef SSTABLE_H_
+#define SSTABLE_H_
+
+#include "stdincludes.h"
+#include "Entry.h"
+#include "RecordIterator.h"
+#include "BloomFilter.h"
+
+/*
+ * Macros
+ */
+#define SSTABLE_MAGIC "KVSST001"
+// a data block is closed once it holds this many bytes
+#define SSTABLE_BLOCK_SIZE 4096
+// magic, index offset, index size, filter offset, filter size, record count,
+// crc of the index, crc of the filter, crc of the footer
+#define SSTABLE_FOOTER_SIZE 60
+
+/**
+ * STRUCT NAME: SSTableBlock
+ *
+ * DESCRIPTION: Index entry of one data block. The key is the last key of the block.
+ */
+typedef struct SSTableBlock {
+	Slice lastKey;
+	uint64_t offset;
+	uint32_t size;
+} SSTableBlock;
+
+/**
+ * CLASS NAME: SSTableBuilder
+ *
+ * DESCRIPTION: Writes an SSTable from records added in increasing key order.
+ * 				The file is written under a temporary name and only renamed
+ * 				into place by finish(), once it is complete and synced.
+ */
+class SSTableBuilder {
+public:
+	SSTableBuilder();
+	virtual ~SSTableBuilder();
+	bool open(const string &path);
+	void add(const Slice &key, const EntryRecord &record);
+	bool finish();
+	void abandon();
+	uint64_t fileSize();
+	unsigned long count();
+private:
+	FILE *fp;
+	string path;
+	string block;
+	string index;
+	string lastKey;
+	// hashes of the keys added, for the filter written by finish()
+	vector<uint64_t> hashes;
+	uint64_t offset;
+	unsigned long numRecords;
+	bool ok;
+	SSTableBuilder(const SSTableBuilder &anotherBuilder);
+	SSTableBuilder& operator =(const SSTableBuilder &anotherBuilder);
+	void flushBlock();
+};
+
+/**
+ * CLASS NAME: SSTable
+ *
+ * DESCRIPTION: Read only, memory mapped sorted table.
+ *
+ * 				Layout: data blocks of about SSTABLE_BLOCK_SIZE bytes, each
+ * 				a run of records written by encodeRecord followed by the crc
+ * 				of the block, then a BloomFilter of every key, the block
+ * 				index and a fixed size footer. The filter starts on a cache
+ * 				line boundary of the file and is used in place in the mapping.
+ * 				The index is decoded when the table is opened, so a lookup
+ * 				binary searches it in memory and reads and checks a single
+ * 				block of the file, if the filter lets it through.
+ */
+class SSTable {
+public:
+	SSTable();
+	virtual ~SSTable();
+	bool open(const string &path, uint64_t number);
+	void close();
+	bool get(const Slice &key, EntryRecord &record);
+	bool mayContain(uint64_t hash);
+	RecordIterator *newIterator();
+	bool overlaps(const Slice &smallest, const Slice &largest);
+	uint64_t getNumber();
+	const string &getPath();
+	const Slice &smallestKey();
+	const Slice &largestKey();
+	uint64_t fileSize();
+	unsigned long recordCount();
+	size_t indexBytes();
+private:
+	const char *base;
+	size_t mappedSize;
+	vector<SSTableBlock> blocks;
+	BloomFilter filter;
+	Slice smallest;
+	unsigned long numRecords;
+	uint64_t number;
+	string path;
+	SSTable(const SSTable &anotherTable);
+	SSTable& operator =(const SSTable &anotherTable);
+	bool readBlock(size_t i, const char *&data, const char *&limit);
+	size_t blockOf(const Slice &key);
+	friend class SSTableIterator;
+};
+
+#endif /* SSTABLE_H_ */
@@ -0,0 +1,439 @@
+/**********************************
+ * FILE NAME: Serializer.h
+ *
+ * DESCRIPTION: Encoding of the structs nodes send each other, generated from
+ * 				a list of fields declared once per struct
+ **********************************/
+
+#ifndef SERIALIZER_H_
+#define SERIALIZER_H_
+
+#include "stdincludes.h"
+#include <limits>
+#include <type_traits>
+#include "Coding.h"
+#include "Member.h"
+#include "Key.h"
+#include "Slice.h"
+
+/**
+ * CLASS NAME: WireWriter
+ *
+ * DESCRIPTION: Writes into a buffer of fixed size. A write that does not fit
+ * 				fails the writer and is dropped, as is every write after it,
+ * 				so callers check ok() once at the end.
+ */
+class WireWriter {
+public:
+	WireWriter(char *buf, size_t capacity): start(buf), ptr(buf), limit(buf + capacity), failed(false) {}
+	void putBytes(const void *data, size_t size) {
+		if ( failed || (size_t)(limit - ptr) < size ) {
+			failed = true;
+			return;
+		}
+		if ( size > 0 ) {
+			memcpy(ptr, data, size);
+			ptr += size;
+		}
+	}
+	void putVarint(uint64_t value) {
+		if ( failed || (size_t)(limit - ptr) < varintLength(value) ) {
+			failed = true;
+			return;
+		}
+		ptr = encodeVarint(ptr, value);
+	}
+	bool ok() const {
+		return !failed;
+	}
+	size_t size() const {
+		return ptr - start;
+	}
+private:
+	char *start;
+	char *ptr;
+	char *limit;
+	bool failed;
+};
+
+/**
+ * CLASS NAME: WireReader
+ *
+ * DESCRIPTION: Reads from a received buffer. A read past the end fails the
+ * 				reader, later reads do nothing, and callers check ok() or
+ * 				atEnd() once at the end.
+ */
+class WireReader {
+public:
+	WireReader(const char *data, size_t size): ptr(data), limit(data + size), failed(false) {}
+	void getBytes(void *dst, size_t size) {
+		const char *bytes = skip(size);
+		if ( bytes != NULL ) {
+			memcpy(dst, bytes, size);
+		}
+	}
+	// returns the next size bytes in place, NULL if there are fewer
+	const char *skip(size_t size) {
+		if ( failed || (size_t)(limit - ptr) < size ) {
+			failed = true;
+			return NULL;
+		}
+		const char *bytes = ptr;
+		ptr += size;
+		return bytes;
+	}
+	void getVarint(uint64_t &value) {
+		const char *next = failed ? NULL : ::getVarint(ptr, limit, value);
+		if ( next == NULL ) {
+			failed = true;
+			value = 0;
+			return;
+		}
+		ptr = next;
+	}
+	void fail() {
+		failed = true;
+	}
+	size_t remaining() const {
+		return limit - ptr;
+	}
+	bool ok() const {
+		return !failed;
+	}
+	// true if every byte was read and nothing failed
+	bool atEnd() const {
+		return !failed && ptr == limit;
+	}
+private:
+	const char *ptr;
+	const char *limit;
+	bool failed;
+};
+
+/**
+ * STRUCT NAME: WireCodec
+ *
+ * DESCRIPTION: How one type is sent. Every codec has
+ * 				minSize, the fewest bytes a value takes
+ * 				size(value), the bytes value takes
+ * 				encode(out, value) and decode(in, value)
+ * 				Integers are sent fixed width and little endian, enums as one
+ * 				byte, strings, keys and vectors with their length in front.
+ */
+template <typename T, typename Enable = void>
+struct WireCodec;
+
+template <typename T>
+struct WireCodec<T, typename enable_if<is_integral<T>::value>::type> {
+	static const size_t minSize = sizeof(T);
+	static size_t size(const T &) {
+		return sizeof(T);
+	}
+	static void encode(WireWriter &out, const T &value) {
+		out.putBytes(&value, sizeof(T));
+	}
+	static void decode(WireReader &in, T &value) {
+		in.getBytes(&value, sizeof(T));
+	}
+};
+
+template <>
+struct WireCodec<bool> {
+	static const size_t minSize = 1;
+	static size_t size(const bool &) {
+		return 1;
+	}
+	static void encode(WireWriter &out, const bool &value) {
+		uint8_t byte = value ? 1 : 0;
+		out.putBytes(&byte, 1);
+	}
+	static void decode(WireReader &in, bool &value) {
+		uint8_t byte = 0;
+		in.getBytes(&byte, 1);
+		value = byte != 0;
+	}
+};
+
+/**
+ * STRUCT NAME: WireEnumLimit
+ *
+ * DESCRIPTION: The largest value of an enum that is sent, specialized next to
+ * 				each enum. Anything above it is rejected when decoding.
+ */
+template <typename E>
+struct WireEnumLimit;
+
+template <typename T>
+struct WireCodec<T, typename enable_if<is_enum<T>::value>::type> {
+	static const size_t minSize = 1;
+	static size_t size(const T &) {
+		return 1;
+	}
+	static void encode(WireWriter &out, const T &value) {
+		uint8_t byte = (uint8_t)value;
+		out.putBytes(&byte, 1);
+	}
+	static void decode(WireReader &in, T &value) {
+		uint8_t byte = 0;
+		in.getBytes(&byte, 1);
+		if ( byte > WireEnumLimit<T>::value ) {
+			in.fail();
+			return;
+		}
+		value = static_cast<T>(byte);
+	}
+};
+
+template <>
+struct WireCodec<Address> {
+	static const size_t minSize = sizeof(((Address *)NULL)->addr);
+	static size_t size(const Address &value) {
+		return sizeof(value.addr);
+	}
+	static void encode(WireWriter &out, const Address &value) {
+		out.putBytes(value.addr, sizeof(value.addr));
+	}
+	static void decode(WireReader &in, Address &value) {
+		in.getBytes(value.addr, sizeof(value.addr));
+	}
+};
+
+// Decoding a Slice leaves it pointing into the received buffer
+template <>
+struct WireCodec<Slice> {
+	static const size_t minSize = 1;
+	static size_t size(const Slice &value) {
+		return varintLength(value.size) + value.size;
+	}
+	static void encode(WireWriter &out, const Slice &value) {
+		out.putVarint(value.size);
+		out.putBytes(value.data, value.size);
+	}
+	static void decode(WireReader &in, Slice &value) {
+		uint64_t size;
+		in.getVarint(size);
+		const char *bytes = size <= in.remaining() ? in.skip(size) : NULL;
+		if ( bytes == NULL ) {
+			in.fail();
+			value = Slice();
+			return;
+		}
+		value = Slice(bytes, size);
+	}
+};
+
+template <>
+struct WireCodec<Key> {
+	static const size_t minSize = 1;
+	static size_t size(const Key &value) {
+		return WireCodec<Slice>::size(value.slice());
+	}
+	static void encode(WireWriter &out, const Key &value) {
+		WireCodec<Slice>::encode(out, value.slice());
+	}
+	static void decode(WireReader &in, Key &value) {
+		Slice bytes;
+		WireCodec<Slice>::decode(in, bytes);
+		value = Key(bytes);
+	}
+};
+
+template <>
+struct WireCodec<string> {
+	static const size_t minSize = 1;
+	static size_t size(const string &value) {
+		return WireCodec<Slice>::size(Slice(value));
+	}
+	static void encode(WireWriter &out, const string &value) {
+		WireCodec<Slice>::encode(out, Slice(value));
+	}
+	static void decode(WireReader &in, string &value) {
+		Slice bytes;
+		WireCodec<Slice>::decode(in, bytes);
+		value.assign(bytes.data, bytes.size);
+	}
+};
+
+// A count of more elements than the bytes left could hold is rejected before
+// anything is allocated for it
+template <typename T>
+struct WireCodec<vector<T> > {
+	static const size_t minSize = 1;
+	static size_t size(const vector<T> &value) {
+		size_t total = varintLength(value.size());
+		for ( size_t i = 0; i < value.size(); i++ ) {
+			total += WireCodec<T>::size(value[i]);
+		}
+		return total;
+	}
+	static void encode(WireWriter &out, const vector<T> &value) {
+		out.putVarint(value.size());
+		for ( size_t i = 0; i < value.size(); i++ ) {
+			WireCodec<T>::encode(out, value[i]);
+		}
+	}
+	static void decode(WireReader &in, vector<T> &value) {
+		const size_t elementSize = WireCodec<T>::minSize;
+		uint64_t count;
+		in.getVarint(count);
+		if ( count > in.remaining() / max(elementSize, (size_t)1) ) {
+			in.fail();
+			return;
+		}
+		value.resize(count);
+		for ( size_t i = 0; i < value.size() && in.ok(); i++ ) {
+			WireCodec<T>::decode(in, value[i]);
+		}
+	}
+};
+
+/**
+ * STRUCT NAME: WireVarint
+ *
+ * DESCRIPTION: Codec sending an integer as a varint, for fields that are
+ * 				mostly small. Signed values go through their unsigned type.
+ */
+template <typename T>
+struct WireVarint {
+	typedef typename make_unsigned<T>::type Unsigned;
+	static const size_t minSize = 1;
+	static size_t size(const T &value) {
+		return varintLength((Unsigned)value);
+	}
+	static void encode(WireWriter &out, const T &value) {
+		out.putVarint((Unsigned)value);
+	}
+	static void decode(WireReader &in, T &value) {
+		uint64_t raw;
+		in.getVarint(raw);
+		if ( raw > numeric_limits<Unsigned>::max() ) {
+			in.fail();
+			return;
+		}
+		value = (T)(Unsigned)raw;
+	}
+};
+
+/**
+ * STRUCT NAME: WireRest
+ *
+ * DESCRIPTION: Codec sending a Slice as the bytes up to the end of the
+ * 				buffer, with no length in front. Only the last field of a
+ * 				list may use it. Decoding leaves it pointing into the buffer.
+ */
+struct WireRest {
+	static const size_t minSize = 0;
+	static size_t size(const Slice &value) {
+		return value.size;
+	}
+	static void encode(WireWriter &out, const Slice &value) {
+		out.putBytes(value.data, value.size);
+	}
+	static void decode(WireReader &in, Slice &value) {
+		size_t size = in.remaining();
+		value = Slice(in.skip(size), size);
+	}
+};
+
+/**
+ * STRUCT NAME: WireField
+ *
+ * DESCRIPTION: One member of a struct S and the codec it is sent with.
+ * 				Declared with WIRE_FIELD or WIRE_FIELD_AS.
+ */
+template <typename S, typename T, T S::*member, typename Codec = WireCodec<T> >
+struct WireField {
+	static const size_t minSize = Codec::minSize;
+	static size_t size(const S &value) {
+		return Codec::size(value.*member);
+	}
+	static void encode(WireWriter &out, const S &value) {
+		Codec::encode(out, value.*member);
+	}
+	static void decode(WireReader &in, S &value) {
+		Codec::decode(in, value.*member);
+	}
+};
+
+#define WIRE_FIELD(S, m) WireField<S, decltype(S::m), &S::m>
+#define WIRE_FIELD_AS(S, m, codec) WireField<S, decltype(S::m), &S::m, codec>
+
+/**
+ * STRUCT NAME: WireFields
+ *
+ * DESCRIPTION: The fields of a struct in the order they are sent. size, encode
+ * 				and decode unroll into one call per field at compile time, and
+ * 				minSize adds up the smallest size of every field.
+ * 				A WireFields is also the codec of a struct sent inside another.
+ */
+template <typename... Fields>
+struct WireFields;
+
+template <>
+struct WireFields<> {
+	static const size_t minSize = 0;
+	template <typename S>
+	static size_t size(const S &) {
+		return 0;
+	}
+	template <typename S>
+	static void encode(WireWriter &, const S &) {}
+	template <typename S>
+	static void decode(WireReader &, S &) {}
+};
+
+template <typename First, typename... Rest>
+struct WireFields<First, Rest...> {
+	static const size_t minSize = First::minSize + WireFields<Rest...>::minSize;
+	template <typename S>
+	static size_t size(const S &value) {
+		return First::size(value) + WireFields<Rest...>::size(value);
+	}
+	template <typename S>
+	static void encode(WireWriter &out, const S &value) {
+		First::encode(out, value);
+		WireFields<Rest...>::encode(out, value);
+	}
+	template <typename S>
+	static void decode(WireReader &in, S &value) {
+		First::decode(in, value);
+		if ( in.ok() ) {
+			WireFields<Rest...>::decode(in, value);
+		}
+	}
+};
+
+/**
+ * FUNCTION NAME: wireEncode
+ *
+ * DESCRIPTION: Encodes value with the field list Fields into buf
+ *
+ * RETURNS:
+ * the number of bytes written, 0 if they do not fit in capacity
+ */
+template <typename Fields, typename S>
+size_t wireEncode(const S &value, char *buf, size_t capacity) {
+	WireWriter out(buf, capacity);
+	Fields::encode(out, value);
+	return out.ok() ? out.size() : 0;
+}
+
+/**
+ * FUNCTION NAME: wireDecode
+ *
+ * DESCRIPTION: Decodes value with the field list Fields from [data, data + size)
+ *
+ * RETURNS:
+ * false if the bytes are not exactly one whole value
+ */
+template <typename Fields, typename S>
+bool wireDecode(const char *data, size_t size, S &value) {
+	if ( size < Fields::minSize ) {
+		return false;
+	}
+	WireReader in(data, size);
+	Fields::decode(in, value);
+	return in.atEnd();
+}
+
+#endif /* SERIALIZER_H_ */
@@ -0,0 +1,558 @@
+/**********************************
+ * FILE NAME: ShardedHashTable.cpp
+ *
+ * DESCRIPTION: Lock striped HashTable definition
+ **********************************/
+
+#include "ShardedHashTable.h"
+
+/**
+ * CLASS NAME: ReadGuard
+ *
+ * DESCRIPTION: Holds the read side of a stripe lock for one scope
+ */
+class ReadGuard {
+public:
+	pthread_rwlock_t *lock;
+	ReadGuard(pthread_rwlock_t *lock): lock(lock) {
+		pthread_rwlock_rdlock(lock);
+	}
+	~ReadGuard() {
+		pthread_rwlock_unlock(lock);
+	}
+};
+
+/**
+ * CLASS NAME: WriteGuard
+ *
+ * DESCRIPTION: Holds the write side of a stripe lock for one scope
+ */
+class WriteGuard {
+public:
+	pthread_rwlock_t *lock;
+	WriteGuard(pthread_rwlock_t *lock): lock(lock) {
+		pthread_rwlock_wrlock(lock);
+	}
+	~WriteGuard() {
+		pthread_rwlock_unlock(lock);
+	}
+};
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: numStripes is rounded up to a power of two
+ */
+ShardedHashTable::ShardedHashTable(unsigned int numStripes): memoryBudget(NULL) {
+	void *mem = NULL;
+	this->numStripes = 1;
+	while ( this->numStripes < numStripes ) {
+		this->numStripes <<= 1;
+	}
+	if ( posix_memalign(&mem, CACHE_LINE_SIZE, this->numStripes * sizeof(Stripe)) != 0 ) {
+		throw bad_alloc();
+	}
+	stripes = (Stripe *)mem;
+	for ( unsigned int i = 0; i < this->numStripes; i++ ) {
+		new (&stripes[i]) Stripe();
+		pthread_rwlock_init(&stripes[i].lock, NULL);
+	}
+}
+
+/**
+ * Destructor
+ */
+ShardedHashTable::~ShardedHashTable() {
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		pthread_rwlock_destroy(&stripes[i].lock);
+		stripes[i].~Stripe();
+	}
+	free(stripes);
+}
+
+/**
+ * FUNCTION NAME: stripeOf
+ *
+ * DESCRIPTION: Picks the stripe of a key from the high half of its hash.
+ * 				The low bits are left to the FlatTable inside the stripe.
+ */
+Stripe &ShardedHashTable::stripeOf(const Key &key) {
+	return stripes[(key.hash() >> 32) & (numStripes - 1)];
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: Inserts the (key,value) pair into the stripe of key
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false in FAILURE
+ */
+bool ShardedHashTable::create(const Key &key, const string &value) {
+	Stripe &stripe = stripeOf(key);
+	WriteGuard guard(&stripe.lock);
+	return stripe.table.create(key, value);
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: Inserts the (key,entry) pair into the stripe of key, last writer wins
+ */
+bool ShardedHashTable::create(const Key &key, const Entry &entry) {
+	Stripe &stripe = stripeOf(key);
+	WriteGuard guard(&stripe.lock);
+	return stripe.table.create(key, entry);
+}
+
+/**
+ * FUNCTION NAME: read
+ *
+ * DESCRIPTION: Searches for the key under the read lock of its stripe,
+ * 				concurrent readers of a stripe do not wait for each other
+ *
+ * RETURNS:
+ * string value if found
+ * else it returns an empty string
+ */
+string ShardedHashTable::read(const Key &key) {
+	Stripe &stripe = stripeOf(key);
+	ReadGuard guard(&stripe.lock);
+	return stripe.table.read(key);
+}
+
+/**
+ * FUNCTION NAME: readEntry
+ *
+ * DESCRIPTION: Fills in the entry of key under the read lock of its stripe
+ */
+bool ShardedHashTable::readEntry(const Key &key, Entry &entry, bool withTombstones) {
+	Stripe &stripe = stripeOf(key);
+	ReadGuard guard(&stripe.lock);
+	return stripe.table.readEntry(key, entry, withTombstones);
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: Updates the given key with the new value if the key is found
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool ShardedHashTable::update(const Key &key, const string &newValue) {
+	Stripe &stripe = stripeOf(key);
+	WriteGuard guard(&stripe.lock);
+	return stripe.table.update(key, newValue);
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: Updates the given key with the entry unless a newer version is stored
+ */
+bool ShardedHashTable::update(const Key &key, const Entry &entry) {
+	Stripe &stripe = stripeOf(key);
+	WriteGuard guard(&stripe.lock);
+	return stripe.table.update(key, entry);
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: Deletes the given key if the key is found
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool ShardedHashTable::deleteKey(const Key &key) {
+	Stripe &stripe = stripeOf(key);
+	WriteGuard guard(&stripe.lock);
+	return stripe.table.deleteKey(key);
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: Leaves a tombstone of the given version for the key
+ */
+bool ShardedHashTable::deleteKey(const Key &key, uint64_t version, int time) {
+	Stripe &stripe = stripeOf(key);
+	WriteGuard guard(&stripe.lock);
+	return stripe.table.deleteKey(key, version, time);
+}
+
+/**
+ * FUNCTION NAME: isEmpty
+ *
+ * DESCRIPTION: Returns if every stripe is empty
+ */
+bool ShardedHashTable::isEmpty() {
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		ReadGuard guard(&stripes[i].lock);
+		if ( !stripes[i].table.isEmpty() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: currentSize
+ *
+ * DESCRIPTION: Returns the sum of the stripe sizes. Stripes are read one
+ * 				after the other, so the total is not a point in time value
+ * 				while writers are running.
+ */
+unsigned long ShardedHashTable::currentSize() {
+	unsigned long size = 0;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		ReadGuard guard(&stripes[i].lock);
+		size += stripes[i].table.currentSize();
+	}
+	return size;
+}
+
+/**
+ * FUNCTION NAME: tombstoneCount
+ *
+ * DESCRIPTION: Returns the number of tombstones over all stripes
+ */
+unsigned long ShardedHashTable::tombstoneCount() {
+	unsigned long tombstones = 0;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		ReadGuard guard(&stripes[i].lock);
+		tombstones += stripes[i].table.tombstoneCount();
+	}
+	return tombstones;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Clear all contents from every stripe
+ */
+void ShardedHashTable::clear() {
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		stripes[i].table.clear();
+	}
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: Returns the count of the number of values for the passed in key
+ */
+unsigned long ShardedHashTable::count(const Key &key) {
+	Stripe &stripe = stripeOf(key);
+	ReadGuard guard(&stripe.lock);
+	return stripe.table.count(key);
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: Checks the filter of the stripe of key under its read lock
+ */
+bool ShardedHashTable::mayContain(const Key &key) {
+	Stripe &stripe = stripeOf(key);
+	ReadGuard guard(&stripe.lock);
+	return stripe.table.mayContain(key);
+}
+
+/**
+ * FUNCTION NAME: liveVersion
+ *
+ * DESCRIPTION: Looks up the version of key under the read lock of its stripe
+ */
+bool ShardedHashTable::liveVersion(const Key &key, uint64_t &version) {
+	Stripe &stripe = stripeOf(key);
+	ReadGuard guard(&stripe.lock);
+	return stripe.table.liveVersion(key, version);
+}
+
+/**
+ * FUNCTION NAME: filterStats
+ *
+ * DESCRIPTION: Returns the filter counts summed over all stripes
+ */
+BloomStats ShardedHashTable::filterStats() {
+	BloomStats stats;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		BloomStats stripeStats = stripes[i].table.filterStats();
+		stats.negatives += stripeStats.negatives;
+		stats.falsePositives += stripeStats.falsePositives;
+	}
+	return stats;
+}
+
+/**
+ * FUNCTION NAME: forEachRecord
+ *
+ * DESCRIPTION: Visits the records of every stripe through a view of the stripe,
+ * 				so the lock is only held to open and close the view and writers
+ * 				go on meanwhile. A stripe still warming up is visited under its
+ * 				read lock instead, a view would load the whole snapshot first.
+ */
+void ShardedHashTable::forEachRecord(RecordVisitFn visit, void *env) {
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		TableView *view = NULL;
+		{
+			WriteGuard guard(&stripes[i].lock);
+			if ( !stripes[i].table.isWarming() ) {
+				view = stripes[i].table.openView();
+			}
+		}
+		if ( view == NULL ) {
+			ReadGuard guard(&stripes[i].lock);
+			stripes[i].table.forEachRecord(visit, env);
+			continue;
+		}
+		view->forEachRecord(visit, env);
+		WriteGuard guard(&stripes[i].lock);
+		stripes[i].table.closeView(view);
+	}
+}
+
+/**
+ * FUNCTION NAME: scan
+ *
+ * DESCRIPTION: Scans every stripe for up to limit keys and keeps the first limit
+ * 				of them all. A stripe still warming up is scanned under its write
+ * 				lock, the scan loads its snapshot first.
+ */
+void ShardedHashTable::scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries) {
+	size_t from = entries.size();
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		{
+			ReadGuard guard(&stripes[i].lock);
+			if ( !stripes[i].table.isWarming() ) {
+				stripes[i].table.scan(startKey, endKey, limit, entries);
+				continue;
+			}
+		}
+		WriteGuard guard(&stripes[i].lock);
+		stripes[i].table.scan(startKey, endKey, limit, entries);
+	}
+	mergeScanEntries(entries, from, limit);
+}
+
+/**
+ * FUNCTION NAME: setOrderedIndex
+ *
+ * DESCRIPTION: Turns the ordered index of every stripe on or off
+ */
+void ShardedHashTable::setOrderedIndex(bool enabled) {
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		stripes[i].table.setOrderedIndex(enabled);
+	}
+}
+
+/**
+ * FUNCTION NAME: memoryUsage
+ *
+ * DESCRIPTION: Returns the memory taken up by all stripes
+ */
+MemoryUsage ShardedHashTable::memoryUsage() {
+	MemoryUsage usage;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		ReadGuard guard(&stripes[i].lock);
+		MemoryUsage stripeUsage = stripes[i].table.memoryUsage();
+		usage.keyBytes += stripeUsage.keyBytes;
+		usage.valueBytes += stripeUsage.valueBytes;
+		usage.metadataBytes += stripeUsage.metadataBytes;
+		usage.arenaBytes += stripeUsage.arenaBytes;
+		usage.limitBytes += stripeUsage.limitBytes;
+		usage.evictions += stripeUsage.evictions;
+	}
+	if ( memoryBudget != NULL ) {
+		usage.limitBytes = memoryBudget->limit;
+	}
+	return usage;
+}
+
+/**
+ * FUNCTION NAME: setMemoryLimit
+ *
+ * DESCRIPTION: Gives every stripe an equal share of the limit and its own policy
+ */
+void ShardedHashTable::setMemoryLimit(unsigned long bytes, const string &policy) {
+	memoryBudget = NULL;
+	unsigned long share = bytes == 0 ? 0 : max(bytes / numStripes, 1UL);
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		stripes[i].table.setMemoryLimit(share, policy);
+	}
+}
+
+/**
+ * FUNCTION NAME: setMemoryBudget
+ *
+ * DESCRIPTION: Every stripe may take up what is left of the shared budget,
+ * 				which its owner brings up to date after each write
+ */
+void ShardedHashTable::setMemoryBudget(const MemoryBudget *budget, const string &policy) {
+	memoryBudget = budget;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		stripes[i].table.setMemoryBudget(budget, policy);
+	}
+}
+
+/**
+ * FUNCTION NAME: memoryBytes
+ *
+ * DESCRIPTION: Returns the bytes of all stripes counted against a memory limit
+ */
+unsigned long ShardedHashTable::memoryBytes() {
+	unsigned long bytes = 0;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		ReadGuard guard(&stripes[i].lock);
+		bytes += stripes[i].table.memoryBytes();
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: growthBytes
+ *
+ * DESCRIPTION: Returns the largest resize the next new key of any stripe may start
+ */
+unsigned long ShardedHashTable::growthBytes() {
+	unsigned long growth = 0;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		ReadGuard guard(&stripes[i].lock);
+		growth = max(growth, stripes[i].table.growthBytes());
+	}
+	return growth;
+}
+
+/**
+ * FUNCTION NAME: reclaim
+ *
+ * DESCRIPTION: Evicts up to count keys, each from the stripe taking up the most
+ *
+ * RETURNS:
+ * number of keys evicted
+ */
+unsigned long ShardedHashTable::reclaim(unsigned long count) {
+	unsigned long evicted = 0;
+	for ( ; evicted < count; evicted++ ) {
+		unsigned int largest = 0;
+		unsigned long largestBytes = 0;
+		for ( unsigned int i = 0; i < numStripes; i++ ) {
+			ReadGuard guard(&stripes[i].lock);
+			if ( stripes[i].table.memoryBytes() > largestBytes ) {
+				largestBytes = stripes[i].table.memoryBytes();
+				largest = i;
+			}
+		}
+		WriteGuard guard(&stripes[largest].lock);
+		if ( stripes[largest].table.reclaim(1) == 0 ) {
+			break;
+		}
+	}
+	return evicted;
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: Runs a compaction pass on every stripe, splitting the budget
+ * 				between them. Each stripe is locked only for its own share.
+ */
+unsigned long ShardedHashTable::compact(int time, int gracePeriod, unsigned long budget) {
+	unsigned long dropped = 0;
+	unsigned long share = max(budget / numStripes, 1UL);
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		dropped += stripes[i].table.compact(time, gracePeriod, share);
+	}
+	return dropped;
+}
+
+/**
+ * FUNCTION NAME: openLog
+ *
+ * DESCRIPTION: Opens one write ahead log per stripe, named path.<stripe>,
+ * 				and replays each into its stripe
+ */
+bool ShardedHashTable::openLog(const string &path, int syncIntervalMs) {
+	bool opened = true;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		opened = stripes[i].table.openLog(path + "." + to_string(i), syncIntervalMs) && opened;
+	}
+	return opened;
+}
+
+/**
+ * FUNCTION NAME: syncLog
+ *
+ * DESCRIPTION: Syncs the log of every stripe
+ */
+bool ShardedHashTable::syncLog() {
+	bool synced = true;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		synced = stripes[i].table.syncLog() && synced;
+	}
+	return synced;
+}
+
+/**
+ * FUNCTION NAME: dumpSnapshot
+ *
+ * DESCRIPTION: Writes one snapshot per stripe, named path.<stripe>
+ */
+bool ShardedHashTable::dumpSnapshot(const string &path) {
+	bool dumped = true;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		dumped = stripes[i].table.dumpSnapshot(path + "." + to_string(i)) && dumped;
+	}
+	return dumped;
+}
+
+/**
+ * FUNCTION NAME: openSnapshot
+ *
+ * DESCRIPTION: Maps the snapshot of every stripe, named path.<stripe>
+ */
+bool ShardedHashTable::openSnapshot(const string &path) {
+	bool opened = true;
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		opened = stripes[i].table.openSnapshot(path + "." + to_string(i)) && opened;
+	}
+	return opened;
+}
+
+/**
+ * FUNCTION NAME: warmSnapshot
+ *
+ * DESCRIPTION: Warms up every stripe, splitting the budget between them
+ */
+unsigned long ShardedHashTable::warmSnapshot(unsigned long budget) {
+	unsigned long loaded = 0;
+	unsigned long share = max(budget / numStripes, 1UL);
+	for ( unsigned int i = 0; i < numStripes; i++ ) {
+		WriteGuard guard(&stripes[i].lock);
+		loaded += stripes[i].table.warmSnapshot(share);
+	}
+	return loaded;
+}
+
+/**
+ * FUNCTION NAME: stripeCount
+ *
+ * DESCRIPTION: Returns the number of stripes
+ */
+unsigned int ShardedHashTable::stripeCount() {
+	return numStripes;
+}
@@ -0,0 +1,89 @@
+/**********************************
+ * FILE NAME: ShardedHashTable.h
+ *
+ * DESCRIPTION: Header file of the lock striped HashTable
+ **********************************/
+
+#ifndef SHARDEDHASHTABLE_H_
+#define SHARDEDHASHTABLE_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include "HashTable.h"
+#include <pthread.h>
+
+/*
+ * Macros
+ */
+#define DEFAULT_NUM_STRIPES 16
+#define CACHE_LINE_SIZE 64
+
+/**
+ * STRUCT NAME: Stripe
+ *
+ * DESCRIPTION: One independently locked part of a ShardedHashTable.
+ * 				Stripes are cache line aligned so two stripes never share
+ * 				the line their lock lives on.
+ */
+typedef struct alignas(CACHE_LINE_SIZE) Stripe {
+	pthread_rwlock_t lock;
+	HashTable table;
+} Stripe;
+
+/**
+ * CLASS NAME: ShardedHashTable
+ *
+ * DESCRIPTION: HashTable split into a power of two number of stripes chosen
+ * 				by key hash. Every stripe has its own reader-writer lock, so
+ * 				reads of any keys run in parallel and writes only serialize
+ * 				with operations on the same stripe.
+ */
+class ShardedHashTable : public StorageEngine {
+public:
+	ShardedHashTable(unsigned int numStripes = DEFAULT_NUM_STRIPES);
+	bool create(const Key &key, const string &value);
+	bool create(const Key &key, const Entry &entry);
+	string read(const Key &key);
+	bool readEntry(const Key &key, Entry &entry, bool withTombstones = false);
+	bool update(const Key &key, const string &newValue);
+	bool update(const Key &key, const Entry &entry);
+	bool deleteKey(const Key &key);
+	bool deleteKey(const Key &key, uint64_t version, int time);
+	bool isEmpty();
+	unsigned long currentSize();
+	unsigned long tombstoneCount();
+	void clear();
+	unsigned long count(const Key &key);
+	bool mayContain(const Key &key);
+	bool liveVersion(const Key &key, uint64_t &version);
+	BloomStats filterStats();
+	void forEachRecord(RecordVisitFn visit, void *env);
+	void scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries);
+	void setOrderedIndex(bool enabled);
+	MemoryUsage memoryUsage();
+	void setMemoryLimit(unsigned long bytes, const string &policy);
+	void setMemoryBudget(const MemoryBudget *budget, const string &policy);
+	unsigned long memoryBytes();
+	unsigned long growthBytes();
+	unsigned long reclaim(unsigned long count);
+	unsigned long compact(int time, int gracePeriod, unsigned long budget);
+	bool openLog(const string &path, int syncIntervalMs);
+	bool syncLog();
+	bool dumpSnapshot(const string &path);
+	bool openSnapshot(const string &path);
+	unsigned long warmSnapshot(unsigned long budget);
+	unsigned int stripeCount();
+	virtual ~ShardedHashTable();
+private:
+	Stripe *stripes;
+	unsigned int numStripes;
+	// budget every stripe shares, NULL unless set by setMemoryBudget
+	const MemoryBudget *memoryBudget;
+	ShardedHashTable(const ShardedHashTable &anotherTable);
+	ShardedHashTable& operator =(const ShardedHashTable &anotherTable);
+	Stripe &stripeOf(const Key &key);
+};
+
+#endif /* SHARDEDHASHTABLE_H_ */
@@ -0,0 +1,170 @@
+/**********************************
+ * FILE NAME: SkipList.h
+ *
+ * DESCRIPTION: Sorted skip list used as the memtable of LSMTable
+ **********************************/
+
+#ifndef SKIPLIST_H_
+#define SKIPLIST_H_
+
+#include "stdincludes.h"
+#include "Slice.h"
+#include "Arena.h"
+
+/*
+ * Macros
+ */
+#define SKIPLIST_MAX_HEIGHT 12
+// one node in SKIPLIST_BRANCHING moves up a level
+#define SKIPLIST_BRANCHING 4
+
+/**
+ * CLASS NAME: SkipList
+ *
+ * DESCRIPTION: Skip list keyed by Slice, in byte wise key order.
+ * 				Nodes are carved from the Arena passed in, so the whole list
+ * 				is freed at once by clearing the arena after clear().
+ * 				Like FlatTable the list never owns key bytes, the caller
+ * 				points the key of a new node at its own copy after insert.
+ */
+template <typename V>
+class SkipList {
+public:
+	struct Node {
+		Slice key;
+		V value;
+		int height;
+		Node *next[1];
+	};
+
+	SkipList(Arena *arena): arena(arena), height(1), numNodes(0), rnd(0x5eed1e55) {
+		head = newNode(SKIPLIST_MAX_HEIGHT);
+	}
+
+	/**
+	 * FUNCTION NAME: find
+	 *
+	 * DESCRIPTION: Returns a pointer to the value of key, NULL if key is not present
+	 */
+	V *find(const Slice &key) {
+		Node *node = findGreaterOrEqual(key, NULL);
+		return (node != NULL && node->key == key) ? &node->value : NULL;
+	}
+
+	/**
+	 * FUNCTION NAME: insert
+	 *
+	 * DESCRIPTION: Finds the node of key, creating it if needed.
+	 * 				inserted is set to true when a new node was created,
+	 * 				its key then still points at the bytes passed in.
+	 *
+	 * RETURNS:
+	 * pointer to the node
+	 */
+	Node *insert(const Slice &key, bool &inserted) {
+		Node *prev[SKIPLIST_MAX_HEIGHT];
+		Node *node = findGreaterOrEqual(key, prev);
+		inserted = false;
+		if ( node != NULL && node->key == key ) {
+			return node;
+		}
+		int h = randomHeight();
+		if ( h > height ) {
+			for ( int i = height; i < h; i++ ) {
+				prev[i] = head;
+			}
+			height = h;
+		}
+		node = newNode(h);
+		node->key = key;
+		for ( int i = 0; i < h; i++ ) {
+			node->next[i] = prev[i]->next[i];
+			prev[i]->next[i] = node;
+		}
+		numNodes++;
+		inserted = true;
+		return node;
+	}
+
+	/**
+	 * FUNCTION NAME: first
+	 *
+	 * DESCRIPTION: Returns the node of the smallest key, NULL if the list is empty.
+	 * 				node->next[0] walks the rest of the list in key order.
+	 */
+	Node *first() const {
+		return head->next[0];
+	}
+
+	// Returns the node of the smallest key not below key, NULL if there is none
+	Node *seek(const Slice &key) const {
+		return findGreaterOrEqual(key, NULL);
+	}
+
+	unsigned long size() const {
+		return numNodes;
+	}
+
+	/**
+	 * FUNCTION NAME: clear
+	 *
+	 * DESCRIPTION: Forgets every node. Their memory is only given back when the
+	 * 				arena is cleared.
+	 */
+	void clear() {
+		head = newNode(SKIPLIST_MAX_HEIGHT);
+		height = 1;
+		numNodes = 0;
+	}
+
+private:
+	Arena *arena;
+	Node *head;
+	int height;
+	unsigned long numNodes;
+	uint32_t rnd;
+	SkipList(const SkipList &anotherList);
+	SkipList& operator =(const SkipList &anotherList);
+
+	Node *newNode(int h) {
+		size_t size = sizeof(Node) + (h - 1) * sizeof(Node *);
+		Node *node = new (arena->allocate(size)) Node();
+		node->height = h;
+		for ( int i = 0; i < h; i++ ) {
+			node->next[i] = NULL;
+		}
+		return node;
+	}
+
+	int randomHeight() {
+		int h = 1;
+		while ( h < SKIPLIST_MAX_HEIGHT ) {
+			// xorshift32
+			rnd ^= rnd << 13;
+			rnd ^= rnd >> 17;
+			rnd ^= rnd << 5;
+			if ( rnd % SKIPLIST_BRANCHING != 0 ) {
+				break;
+			}
+			h++;
+		}
+		return h;
+	}
+
+	Node *findGreaterOrEqual(const Slice &key, Node **prev) const {
+		Node *node = head;
+		for ( int level = height - 1; level >= 0; level-- ) {
+			Node *next = node->next[level];
+			while ( next != NULL && next->key.compare(key) < 0 ) {
+				node = next;
+				next = node->next[level];
+			}
+			if ( prev != NULL ) {
+				prev[level] = node;
+			}
+		}
+		return node->next[0];
+	}
+};
+
+#endif /* SKIPLIST_H_ */
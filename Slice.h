@@ -0,0 +1,86 @@
+/**********************************
+ * FILE NAME: Slice.h
+ *
+ * DESCRIPTION: Non owning reference to a run of bytes
+ **********************************/
+
+#ifndef SLICE_H_
+#define SLICE_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+
+/**
+ * CLASS NAME: Slice
+ *
+ * DESCRIPTION: Pointer and length of bytes owned by someone else
+ * 				(an Arena, a message buffer or a string)
+ */
+class Slice {
+public:
+	const char *data;
+	uint32_t size;
+	Slice(): data(NULL), size(0) {}
+	Slice(const char *data, size_t size): data(data), size((uint32_t)size) {}
+	Slice(const string &str): data(str.data()), size((uint32_t)str.size()) {}
+	bool empty() const {
+		return size == 0;
+	}
+	string toString() const {
+		return string(data, size);
+	}
+	/**
+	 * FUNCTION NAME: compare
+	 *
+	 * DESCRIPTION: Byte wise order, on a common prefix the shorter slice comes first
+	 *
+	 * RETURNS:
+	 * <0, 0 or >0 as this slice orders before, same as or after another
+	 */
+	int compare(const Slice &another) const {
+		size_t common = size < another.size ? size : another.size;
+		int c = common == 0 ? 0 : memcmp(data, another.data, common);
+		if ( c != 0 ) {
+			return c;
+		}
+		return size < another.size ? -1 : (size > another.size ? 1 : 0);
+	}
+	bool operator ==(const Slice &another) const {
+		return size == another.size && (size == 0 || memcmp(data, another.data, size) == 0);
+	}
+	bool operator !=(const Slice &another) const {
+		return !(*this == another);
+	}
+};
+
+/**
+ * FUNCTION NAME: hashBytes
+ *
+ * DESCRIPTION: 64 bit multiply-xorshift hash over a run of bytes, eight bytes at a time
+ */
+inline uint64_t hashBytes(const char *data, size_t size) {
+	const uint64_t mul = 0x9E3779B97F4A7C15ULL;
+	uint64_t h = 0xCBF29CE484222325ULL ^ (size * mul);
+	size_t i = 0;
+	for ( ; i + 8 <= size; i += 8 ) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		h = (h ^ word) * mul;
+		h ^= h >> 29;
+	}
+	uint64_t tail = 0;
+	if ( i < size ) {
+		memcpy(&tail, data + i, size - i);
+	}
+	h = (h ^ tail) * mul;
+	h ^= h >> 32;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 29;
+	return h;
+}
+
+inline uint64_t hashBytes(const Slice &slice) {
+	return hashBytes(slice.data, slice.size);
+}
+
+#endif /* SLICE_H_ */
@@ -0,0 +1,243 @@
+/**********************************
+ * FILE NAME: SnapshotFile.cpp
+ *
+ * DESCRIPTION: Definition of the sorted, checksummed snapshot of a HashTable
+ **********************************/
+
+#include "SnapshotFile.h"
+#include "Coding.h"
+#include "Crc32.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static bool itemLess(const SnapshotItem &a, const SnapshotItem &b) {
+	return a.key.compare(b.key) < 0;
+}
+
+/**
+ * Constructor
+ */
+SnapshotFile::SnapshotFile(): base(NULL), mappedSize(0), numRecords(0), numLive(0), index(NULL) {}
+
+/**
+ * Destructor
+ */
+SnapshotFile::~SnapshotFile() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Sorts the items by key and writes them as a snapshot at path.
+ * 				The file is written under a temporary name, synced and renamed,
+ * 				so path always holds either the old or the new snapshot.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool SnapshotFile::write(const string &path, vector<SnapshotItem> &items) {
+	string tmpPath = path + ".tmp";
+	FILE *fp = fopen(tmpPath.c_str(), "wb");
+	if ( fp == NULL ) {
+		return false;
+	}
+	sort(items.begin(), items.end(), itemLess);
+
+	string header(SNAPSHOT_HEADER_SIZE, '\0');
+	bool ok = fwrite(header.data(), 1, header.size(), fp) == header.size();
+
+	string indexBytes;
+	string record;
+	uint64_t live = 0;
+	uint64_t offset = SNAPSHOT_HEADER_SIZE;
+	for ( size_t i = 0; ok && i < items.size(); i++ ) {
+		const EntryRecord &r = *items[i].record;
+		if ( !r.isTombstone() ) {
+			live++;
+		}
+		record.clear();
+		encodeRecord(record, items[i].key, r);
+		putFixed64(indexBytes, offset);
+		putFixed32(indexBytes, crc32(record.data(), record.size()));
+		ok = fwrite(record.data(), 1, record.size(), fp) == record.size();
+		offset += record.size();
+	}
+	ok = ok && fwrite(indexBytes.data(), 1, indexBytes.size(), fp) == indexBytes.size();
+
+	header.clear();
+	header.append(SNAPSHOT_MAGIC, 8);
+	putFixed64(header, items.size());
+	putFixed64(header, live);
+	putFixed64(header, offset);
+	putFixed32(header, crc32(indexBytes.data(), indexBytes.size()));
+	putFixed32(header, crc32(header.data(), header.size()));
+	ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(header.data(), 1, header.size(), fp) == header.size();
+	ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+	ok = (fclose(fp) == 0) && ok;
+	if ( !ok || rename(tmpPath.c_str(), path.c_str()) != 0 ) {
+		unlink(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Maps the snapshot at path and checks its header and index
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the file is missing or damaged
+ */
+bool SnapshotFile::open(const string &path) {
+	struct stat st;
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if ( fd < 0 ) {
+		return false;
+	}
+	if ( fstat(fd, &st) != 0 || st.st_size < SNAPSHOT_HEADER_SIZE ) {
+		::close(fd);
+		return false;
+	}
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if ( mem == MAP_FAILED ) {
+		return false;
+	}
+	base = (const char *)mem;
+	mappedSize = st.st_size;
+
+	uint64_t records = decodeFixed64(base + 8);
+	uint64_t live = decodeFixed64(base + 16);
+	uint64_t indexOffset = decodeFixed64(base + 24);
+	bool valid = memcmp(base, SNAPSHOT_MAGIC, 8) == 0
+		&& decodeFixed32(base + 36) == crc32(base, 36)
+		&& live <= records
+		&& indexOffset >= SNAPSHOT_HEADER_SIZE && indexOffset <= mappedSize
+		&& records <= (mappedSize - indexOffset) / SNAPSHOT_INDEX_ENTRY_SIZE
+		&& indexOffset + records * SNAPSHOT_INDEX_ENTRY_SIZE == mappedSize
+		&& decodeFixed32(base + 32) == crc32(base + indexOffset, records * SNAPSHOT_INDEX_ENTRY_SIZE);
+	if ( !valid ) {
+		close();
+		return false;
+	}
+	numRecords = records;
+	numLive = live;
+	index = base + indexOffset;
+	// Lookups jump around the file, warm up reads it front to back itself
+	madvise((void *)base, mappedSize, MADV_RANDOM);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Unmaps the snapshot
+ */
+void SnapshotFile::close() {
+	if ( base != NULL ) {
+		munmap((void *)base, mappedSize);
+	}
+	base = NULL;
+	mappedSize = 0;
+	numRecords = 0;
+	numLive = 0;
+	index = NULL;
+}
+
+bool SnapshotFile::isOpen() {
+	return base != NULL;
+}
+
+unsigned long SnapshotFile::count() {
+	return numRecords;
+}
+
+unsigned long SnapshotFile::liveCount() {
+	return numLive;
+}
+
+/**
+ * FUNCTION NAME: keyAt
+ *
+ * DESCRIPTION: Decodes the key of the record at position i of the index
+ */
+bool SnapshotFile::keyAt(unsigned long i, Slice &key) {
+	uint64_t offset = decodeFixed64(index + i * SNAPSHOT_INDEX_ENTRY_SIZE);
+	const char *limit = index;
+	uint64_t size;
+	if ( offset >= (uint64_t)(limit - base) ) {
+		return false;
+	}
+	const char *p = getVarint(base + offset, limit, size);
+	if ( p == NULL || (uint64_t)(limit - p) < size ) {
+		return false;
+	}
+	key = Slice(p, size);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: recordAt
+ *
+ * DESCRIPTION: Decodes and checks the record at position i of the index.
+ * 				The key and value slices point into the mapping.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the record is damaged
+ */
+bool SnapshotFile::recordAt(unsigned long i, Slice &key, EntryRecord &record) {
+	if ( i >= numRecords ) {
+		return false;
+	}
+	const char *entry = index + i * SNAPSHOT_INDEX_ENTRY_SIZE;
+	uint64_t offset = decodeFixed64(entry);
+	uint64_t end = (i + 1 < numRecords) ? decodeFixed64(entry + SNAPSHOT_INDEX_ENTRY_SIZE) : (uint64_t)(index - base);
+	if ( offset >= end || end > (uint64_t)(index - base) ) {
+		return false;
+	}
+	const char *p = base + offset;
+	const char *limit = base + end;
+	if ( crc32(p, limit - p) != decodeFixed32(entry + 8) ) {
+		return false;
+	}
+	return decodeRecord(p, limit, key, record) != NULL;
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Binary search of the index for key
+ *
+ * RETURNS:
+ * true if the key is in the snapshot
+ * false otherwise
+ */
+bool SnapshotFile::find(const Slice &key, EntryRecord &record) {
+	unsigned long lo = 0;
+	unsigned long hi = numRecords;
+	while ( lo < hi ) {
+		unsigned long mid = lo + (hi - lo) / 2;
+		Slice midKey;
+		if ( !keyAt(mid, midKey) ) {
+			return false;
+		}
+		int c = midKey.compare(key);
+		if ( c == 0 ) {
+			Slice found;
+			return recordAt(mid, found, record);
+		}
+		if ( c < 0 ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,69 @@
+/**********************************
+ * FILE NAME: SnapshotFile.h
+ *
+ * DESCRIPTION: Header file of the sorted, checksummed snapshot of a HashTable
+ **********************************/
+
+#ifndef SNAPSHOTFILE_H_
+#define SNAPSHOTFILE_H_
+
+#include "stdincludes.h"
+#include "Entry.h"
+
+/*
+ * Macros
+ */
+#define SNAPSHOT_MAGIC "KVSNAP01"
+// magic, record count, live record count, index offset, crc of the index, crc of the header
+#define SNAPSHOT_HEADER_SIZE 40
+// offset and crc of one record
+#define SNAPSHOT_INDEX_ENTRY_SIZE 12
+
+/**
+ * STRUCT NAME: SnapshotItem
+ *
+ * DESCRIPTION: One key and its record, as handed to SnapshotFile::write
+ */
+typedef struct SnapshotItem {
+	Slice key;
+	const EntryRecord *record;
+} SnapshotItem;
+
+/**
+ * CLASS NAME: SnapshotFile
+ *
+ * DESCRIPTION: Read only, memory mapped snapshot of a table.
+ *
+ * 				Layout: a header, the records sorted by key, then an index of
+ * 				one (offset, crc) pair per record. Records are written by
+ * 				encodeRecord.
+ *
+ * 				Opening maps the file and checks the header and the index
+ * 				only, so it costs the same for any size of snapshot. A record
+ * 				is checked against its crc when it is read. Lookups binary
+ * 				search the index and return slices into the mapping.
+ */
+class SnapshotFile {
+public:
+	SnapshotFile();
+	virtual ~SnapshotFile();
+	static bool write(const string &path, vector<SnapshotItem> &items);
+	bool open(const string &path);
+	void close();
+	bool isOpen();
+	unsigned long count();
+	unsigned long liveCount();
+	bool find(const Slice &key, EntryRecord &record);
+	bool recordAt(unsigned long index, Slice &key, EntryRecord &record);
+private:
+	const char *base;
+	size_t mappedSize;
+	unsigned long numRecords;
+	unsigned long numLive;
+	const char *index;
+	SnapshotFile(const SnapshotFile &anotherFile);
+	SnapshotFile& operator =(const SnapshotFile &anotherFile);
+	bool keyAt(unsigned long i, Slice &key);
+};
+
+#endif /* SNAPSHOTFILE_H_ */
@@ -0,0 +1,75 @@
+/**********************************
+ * FILE NAME: StorageEngine.cpp
+ *
+ * DESCRIPTION: Choice of the local key value store of a node
+ **********************************/
+
+#include "StorageEngine.h"
+#include "HashTable.h"
+#include "ShardedHashTable.h"
+#include "LSMTable.h"
+
+/**
+ * FUNCTION NAME: newStorageEngine
+ *
+ * DESCRIPTION: Builds the engine named by type: HASH, SHARDED or LSM.
+ * 				An LSM engine keeps its tables in the directory dataPath.
+ * 				Unknown names, and an LSM engine whose directory cannot be
+ * 				used, fall back to HASH.
+ *
+ * RETURNS:
+ * the engine, to be deleted by the caller
+ */
+StorageEngine *newStorageEngine(const string &type, const string &dataPath) {
+	if ( type == "SHARDED" ) {
+		return new ShardedHashTable();
+	}
+	if ( type == "LSM" ) {
+		LSMTable *table = new LSMTable();
+		if ( table->open(dataPath) ) {
+			return table;
+		}
+		delete table;
+	}
+	return new HashTable();
+}
+
+/**
+ * FUNCTION NAME: prefixScan
+ *
+ * DESCRIPTION: Appends the live keys starting with prefix, at most limit of them,
+ * 				in key order. The scan ends at the prefix with its last byte below
+ * 				0xff bumped up and the bytes after it dropped.
+ */
+void StorageEngine::prefixScan(const Slice &prefix, unsigned long limit, ScanEntries &entries) {
+	string end(prefix.data, prefix.size);
+	while ( !end.empty() && (uint8_t)end[end.size() - 1] == 0xff ) {
+		end.erase(end.size() - 1);
+	}
+	if ( !end.empty() ) {
+		end[end.size() - 1]++;
+	}
+	scan(prefix, Slice(end), limit, entries);
+}
+
+/**
+ * FUNCTION NAME: compareScanKeys
+ *
+ * DESCRIPTION: Orders scan entries by key
+ */
+static bool compareScanKeys(const pair<Key, Entry> &first, const pair<Key, Entry> &second) {
+	return first.first < second.first;
+}
+
+/**
+ * FUNCTION NAME: mergeScanEntries
+ *
+ * DESCRIPTION: Sorts the entries appended from from on by several scans of
+ * 				disjoint sets of keys, and keeps the first limit of them
+ */
+void mergeScanEntries(ScanEntries &entries, size_t from, unsigned long limit) {
+	sort(entries.begin() + from, entries.end(), compareScanKeys);
+	if ( entries.size() - from > limit ) {
+		entries.resize(from + limit);
+	}
+}
@@ -0,0 +1,126 @@
+/**********************************
+ * FILE NAME: StorageEngine.h
+ *
+ * DESCRIPTION: Header file of the interface every local key value store implements
+ **********************************/
+
+#ifndef STORAGEENGINE_H_
+#define STORAGEENGINE_H_
+
+#include "stdincludes.h"
+#include "Entry.h"
+#include "BloomFilter.h"
+#include "Key.h"
+
+/**
+ * STRUCT NAME: MemoryUsage
+ *
+ * DESCRIPTION: Bytes the in memory part of a store takes up
+ */
+typedef struct MemoryUsage {
+	// bytes of the keys and values held in memory
+	unsigned long keyBytes;
+	unsigned long valueBytes;
+	// index slots, control bytes and filters
+	unsigned long metadataBytes;
+	// bytes the arena holds from the system, keys and values included
+	unsigned long arenaBytes;
+	// memory ceiling, 0 if there is none
+	unsigned long limitBytes;
+	// keys dropped to stay under the ceiling
+	unsigned long evictions;
+	MemoryUsage(): keyBytes(0), valueBytes(0), metadataBytes(0), arenaBytes(0), limitBytes(0), evictions(0) {}
+	unsigned long total() const {
+		return metadataBytes + arenaBytes;
+	}
+} MemoryUsage;
+
+/**
+ * STRUCT NAME: MemoryBudget
+ *
+ * DESCRIPTION: Memory limit shared by several engines, the partitions of a
+ * 				node. Its owner keeps used up to date with the bytes every
+ * 				engine sharing it takes up, an engine may take up to what is
+ * 				left on top of its own bytes.
+ */
+typedef struct MemoryBudget {
+	unsigned long limit;
+	unsigned long used;
+	MemoryBudget(): limit(0), used(0) {}
+	unsigned long left() const {
+		return used >= limit ? 0 : limit - used;
+	}
+} MemoryBudget;
+
+// called with the newest record of every key, see StorageEngine::forEachRecord
+typedef void (*RecordVisitFn)(void *env, const Slice &key, const EntryRecord &record);
+// keys and their entries in key order, as returned by StorageEngine::scan
+typedef vector<pair<Key, Entry> > ScanEntries;
+
+/**
+ * CLASS NAME: StorageEngine
+ *
+ * DESCRIPTION: What MP2Node needs from its local store. HashTable,
+ * 				ShardedHashTable and LSMTable implement it, the engine of a
+ * 				node is picked by the STORAGE_ENGINE parameter.
+ * 				PartitionedStore implements it on top of one such engine
+ * 				per ring position.
+ * 				Writes carry an Entry and the one with the highest version
+ * 				wins, deletes leave a versioned tombstone that compact()
+ * 				drops once its grace period is over.
+ */
+class StorageEngine {
+public:
+	virtual ~StorageEngine() {}
+	virtual bool create(const Key &key, const Entry &entry) = 0;
+	virtual string read(const Key &key) = 0;
+	virtual bool readEntry(const Key &key, Entry &entry, bool withTombstones = false) = 0;
+	virtual bool update(const Key &key, const Entry &entry) = 0;
+	virtual bool deleteKey(const Key &key, uint64_t version, int time) = 0;
+	virtual unsigned long currentSize() = 0;
+	virtual unsigned long tombstoneCount() = 0;
+	virtual void clear() = 0;
+	virtual unsigned long count(const Key &key) = 0;
+	// false only if key is surely not stored, tombstones count as stored
+	virtual bool mayContain(const Key &key) = 0;
+	// version of key if it is live, found without reading the value,
+	// touching the key for eviction or counting a filter check
+	virtual bool liveVersion(const Key &key, uint64_t &version) = 0;
+	virtual BloomStats filterStats() = 0;
+	// visits the newest record of every key, tombstones included. Values
+	// may be compressed, readEntry returns them as written.
+	virtual void forEachRecord(RecordVisitFn visit, void *env) = 0;
+	// ordered scans: append the live keys from startKey up to, not including,
+	// endKey, at most limit of them, in key order. An empty endKey is no bound.
+	// Hashed engines only keep keys in order with the ordered index enabled,
+	// without it a scan visits and sorts every key.
+	virtual void scan(const Slice &startKey, const Slice &endKey, unsigned long limit, ScanEntries &entries) = 0;
+	void prefixScan(const Slice &prefix, unsigned long limit, ScanEntries &entries);
+	virtual void setOrderedIndex(bool enabled) = 0;
+	// memory accounting, and a ceiling enforced by evicting keys picked by
+	// the named policy, or by rejecting new keys with NONE
+	virtual MemoryUsage memoryUsage() = 0;
+	virtual void setMemoryLimit(unsigned long bytes, const string &evictionPolicy) = 0;
+	// the same limit as a budget shared with other engines, NULL for none.
+	// memoryBytes() returns the bytes held against a limit, growthBytes()
+	// the bytes the next new key may add by resizing, and reclaim() frees
+	// the memory of up to count keys by evicting them or writing them out,
+	// returning how many. None of them walks the keys.
+	virtual void setMemoryBudget(const MemoryBudget *budget, const string &evictionPolicy) = 0;
+	virtual unsigned long memoryBytes() = 0;
+	virtual unsigned long growthBytes() = 0;
+	virtual unsigned long reclaim(unsigned long count) = 0;
+	// background maintenance, bounded by budget per call
+	virtual unsigned long compact(int time, int gracePeriod, unsigned long budget) = 0;
+	// durability
+	virtual bool openLog(const string &path, int syncIntervalMs) = 0;
+	virtual bool syncLog() = 0;
+	virtual bool dumpSnapshot(const string &path) = 0;
+	virtual bool openSnapshot(const string &path) = 0;
+	virtual unsigned long warmSnapshot(unsigned long budget) = 0;
+};
+
+StorageEngine *newStorageEngine(const string &type, const string &dataPath);
+void mergeScanEntries(ScanEntries &entries, size_t from, unsigned long limit);
+
+#endif /* STORAGEENGINE_H_ */
@@ -0,0 +1,94 @@
+/**********************************
+ * FILE NAME: TimerWheel.cpp
+ *
+ * DESCRIPTION: Definition of the hierarchical timer wheel that expires keys
+ **********************************/
+
+#include "TimerWheel.h"
+
+/**
+ * Constructor
+ */
+TimerWheel::TimerWheel(int now): currentTick(now), numTimers(0) {}
+
+/**
+ * FUNCTION NAME: schedule
+ *
+ * DESCRIPTION: Fires a timer for the write of key at expiresAt.
+ * 				A deadline that has passed fires on the next tick.
+ */
+void TimerWheel::schedule(const Key &key, uint64_t version, int expiresAt) {
+	ExpiryTimer timer;
+	timer.key = key;
+	timer.version = version;
+	timer.expiresAt = max(expiresAt, currentTick + 1);
+	place(timer);
+	numTimers++;
+}
+
+/**
+ * FUNCTION NAME: place
+ *
+ * DESCRIPTION: Puts timer into the lowest level where its deadline is less
+ * 				than a full turn of that level away from the current tick
+ */
+void TimerWheel::place(ExpiryTimer &timer) {
+	int level = 0;
+	while ( level < TIMER_WHEEL_LEVELS - 1
+			&& (timer.expiresAt >> (TIMER_WHEEL_BITS * level)) - (currentTick >> (TIMER_WHEEL_BITS * level)) >= TIMER_WHEEL_SLOTS ) {
+		level++;
+	}
+	int shift = TIMER_WHEEL_BITS * level;
+	int slot = (timer.expiresAt >> shift) & (TIMER_WHEEL_SLOTS - 1);
+	if ( (timer.expiresAt >> shift) - (currentTick >> shift) >= TIMER_WHEEL_SLOTS ) {
+		// Beyond the top level, park in the slot the wheel reaches last
+		slot = ((currentTick >> shift) - 1) & (TIMER_WHEEL_SLOTS - 1);
+	}
+	slots[level][slot].push_back(timer);
+}
+
+/**
+ * FUNCTION NAME: cascade
+ *
+ * DESCRIPTION: Moves the timers of the current slot of level down the wheel
+ */
+void TimerWheel::cascade(int level) {
+	vector<ExpiryTimer> &slot = slots[level][(currentTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+	vector<ExpiryTimer> timers;
+	timers.swap(slot);
+	for ( size_t i = 0; i < timers.size(); i++ ) {
+		place(timers[i]);
+	}
+}
+
+/**
+ * FUNCTION NAME: advance
+ *
+ * DESCRIPTION: Moves the wheel forward to now and appends every timer
+ * 				that fired on the way to expired
+ */
+void TimerWheel::advance(int now, vector<ExpiryTimer> &expired) {
+	while ( currentTick < now ) {
+		currentTick++;
+		// A level turns over when every level below it has
+		for ( int level = 1; level < TIMER_WHEEL_LEVELS; level++ ) {
+			if ( (currentTick & ((1 << (TIMER_WHEEL_BITS * level)) - 1)) != 0 ) {
+				break;
+			}
+			cascade(level);
+		}
+		vector<ExpiryTimer> &due = slots[0][currentTick & (TIMER_WHEEL_SLOTS - 1)];
+		numTimers -= due.size();
+		expired.insert(expired.end(), due.begin(), due.end());
+		due.clear();
+	}
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Returns the number of timers that have not fired
+ */
+unsigned long TimerWheel::size() {
+	return numTimers;
+}
@@ -0,0 +1,61 @@
+/**********************************
+ * FILE NAME: TimerWheel.h
+ *
+ * DESCRIPTION: Header file of the hierarchical timer wheel that expires keys
+ **********************************/
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include "stdincludes.h"
+#include "Key.h"
+
+/*
+ * Macros
+ */
+#define TIMER_WHEEL_LEVELS 4
+// every level has 1 << TIMER_WHEEL_BITS slots
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+/**
+ * STRUCT NAME: ExpiryTimer
+ *
+ * DESCRIPTION: Expiry of the write of key with the given version
+ */
+typedef struct ExpiryTimer {
+	Key key;
+	uint64_t version;
+	int expiresAt;
+} ExpiryTimer;
+
+/**
+ * CLASS NAME: TimerWheel
+ *
+ * DESCRIPTION: Hierarchical timer wheel. Level 0 has one slot per time unit,
+ * 				every slot of level l covers 64 slots of level l - 1. A timer
+ * 				goes into the lowest level its deadline fits in, and is moved
+ * 				one level down each time the wheel reaches its slot, so every
+ * 				tick only touches the slots that are due. Timers further out
+ * 				than the top level wait in its last slot and are placed again
+ * 				once the wheel gets there.
+ *
+ * 				Timers are never cancelled. The owner checks the version of a
+ * 				fired timer against the key, so a newer write outlives the
+ * 				timer of an older one.
+ */
+class TimerWheel {
+public:
+	TimerWheel(int now);
+	void schedule(const Key &key, uint64_t version, int expiresAt);
+	void advance(int now, vector<ExpiryTimer> &expired);
+	unsigned long size();
+private:
+	vector<ExpiryTimer> slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	int currentTick;
+	unsigned long numTimers;
+	void place(ExpiryTimer &timer);
+	void cascade(int level);
+};
+
+#endif /* TIMERWHEEL_H_ */
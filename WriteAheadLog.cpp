@@ -0,0 +1,231 @@
+/**********************************
+ * FILE NAME: WriteAheadLog.cpp
+ *
+ * DESCRIPTION: Definition of the append only log of HashTable mutations
+ **********************************/
+
+#include "WriteAheadLog.h"
+#include "Coding.h"
+#include "Crc32.h"
+#include <sys/stat.h>
+#include <errno.h>
+
+/**
+ * Constructor
+ */
+WriteAheadLog::WriteAheadLog(): fd(-1), pending(0), syncIntervalMs(0), lastSyncMs(0) {}
+
+/**
+ * Destructor
+ */
+WriteAheadLog::~WriteAheadLog() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: nowMs
+ *
+ * DESCRIPTION: Monotonic clock in milliseconds
+ */
+long WriteAheadLog::nowMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Opens or creates the log file at path
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool WriteAheadLog::open(const string &path, int syncIntervalMs) {
+	close();
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+	if ( fd < 0 ) {
+		return false;
+	}
+	this->path = path;
+	this->syncIntervalMs = syncIntervalMs;
+	lastSyncMs = nowMs();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Syncs what is buffered and closes the file
+ */
+void WriteAheadLog::close() {
+	if ( fd >= 0 ) {
+		sync();
+		::close(fd);
+		fd = -1;
+	}
+}
+
+bool WriteAheadLog::isOpen() {
+	return fd >= 0;
+}
+
+/**
+ * FUNCTION NAME: appendRecord
+ *
+ * DESCRIPTION: Frames the payload with its checksum and length and buffers it
+ */
+void WriteAheadLog::appendRecord(const string &payload) {
+	if ( fd < 0 ) {
+		return;
+	}
+	putFixed32(buffer, crc32(payload.data(), payload.size()));
+	putFixed32(buffer, (uint32_t)payload.size());
+	buffer.append(payload);
+	pending++;
+	if ( syncIntervalMs > 0 && nowMs() - lastSyncMs >= syncIntervalMs ) {
+		sync();
+	}
+}
+
+/**
+ * FUNCTION NAME: appendPut
+ *
+ * DESCRIPTION: Logs the record a key is left with after a create, update or delete
+ */
+void WriteAheadLog::appendPut(const Slice &key, const EntryRecord &record) {
+	string payload;
+	payload.push_back((char)WAL_PUT);
+	encodeRecord(payload, key, record);
+	appendRecord(payload);
+}
+
+/**
+ * FUNCTION NAME: appendClear
+ *
+ * DESCRIPTION: Logs that the whole table was cleared
+ */
+void WriteAheadLog::appendClear() {
+	string payload;
+	payload.push_back((char)WAL_CLEAR);
+	appendRecord(payload);
+}
+
+/**
+ * FUNCTION NAME: sync
+ *
+ * DESCRIPTION: Writes every buffered record and makes them durable with one fdatasync
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool WriteAheadLog::sync() {
+	if ( fd < 0 ) {
+		return false;
+	}
+	lastSyncMs = nowMs();
+	if ( buffer.empty() ) {
+		return true;
+	}
+	size_t written = 0;
+	while ( written < buffer.size() ) {
+		ssize_t n = write(fd, buffer.data() + written, buffer.size() - written);
+		if ( n < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			return false;
+		}
+		written += n;
+	}
+	buffer.clear();
+	pending = 0;
+	return fdatasync(fd) == 0;
+}
+
+/**
+ * FUNCTION NAME: truncate
+ *
+ * DESCRIPTION: Drops every record, buffered or on disk. Used once the table
+ * 				has been saved somewhere else, e.g. in a snapshot.
+ */
+bool WriteAheadLog::truncate() {
+	if ( fd < 0 ) {
+		return false;
+	}
+	buffer.clear();
+	pending = 0;
+	return ftruncate(fd, 0) == 0 && fdatasync(fd) == 0;
+}
+
+/**
+ * FUNCTION NAME: replay
+ *
+ * DESCRIPTION: Reads the log from the start and calls fn for every intact record.
+ * 				Replay stops at the first record that is cut short or fails its
+ * 				checksum, which is where a crash interrupted a write, and the file
+ * 				is truncated there so new records follow the last good one.
+ *
+ * RETURNS:
+ * number of records replayed
+ */
+unsigned long WriteAheadLog::replay(WalReplayFn fn, void *env) {
+	struct stat st;
+	unsigned long count = 0;
+
+	if ( fd < 0 || fstat(fd, &st) != 0 ) {
+		return 0;
+	}
+	string data(st.st_size, '\0');
+	size_t got = 0;
+	while ( got < data.size() ) {
+		ssize_t n = pread(fd, &data[got], data.size() - got, got);
+		if ( n <= 0 ) {
+			break;
+		}
+		got += n;
+	}
+	data.resize(got);
+
+	const char *ptr = data.data();
+	const char *end = ptr + data.size();
+	while ( end - ptr >= WAL_HEADER_SIZE ) {
+		uint32_t crc = decodeFixed32(ptr);
+		uint32_t size = decodeFixed32(ptr + 4);
+		const char *payload = ptr + WAL_HEADER_SIZE;
+		if ( (size_t)(end - payload) < size || size == 0 || crc32(payload, size) != crc ) {
+			break;
+		}
+		const char *limit = payload + size;
+		WalOp op = (WalOp)(uint8_t)payload[0];
+		EntryRecord record;
+		Slice key;
+		if ( op == WAL_PUT ) {
+			if ( decodeRecord(payload + 1, limit, key, record) == NULL ) {
+				break;
+			}
+		}
+		else if ( op != WAL_CLEAR ) {
+			break;
+		}
+		fn(env, op, key, record);
+		count++;
+		ptr = limit;
+	}
+
+	if ( ptr != end && ftruncate(fd, ptr - data.data()) == 0 ) {
+		fdatasync(fd);
+	}
+	return count;
+}
+
+/**
+ * FUNCTION NAME: pendingRecords
+ *
+ * DESCRIPTION: Returns the number of records appended since the last sync
+ */
+unsigned long WriteAheadLog::pendingRecords() {
+	return pending;
+}
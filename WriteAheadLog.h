@@ -0,0 +1,66 @@
+/**********************************
+ * FILE NAME: WriteAheadLog.h
+ *
+ * DESCRIPTION: Header file of the append only log of HashTable mutations
+ **********************************/
+
+#ifndef WRITEAHEADLOG_H_
+#define WRITEAHEADLOG_H_
+
+#include "stdincludes.h"
+#include "Entry.h"
+
+/*
+ * Macros
+ */
+// record header: crc32 of the payload, then the payload length
+#define WAL_HEADER_SIZE 8
+
+/**
+ * Record types
+ */
+enum WalOp {
+	WAL_PUT = 1,
+	WAL_CLEAR = 2
+};
+
+// Called for every intact record during replay
+typedef void (*WalReplayFn)(void *env, WalOp op, const Slice &key, const EntryRecord &record);
+
+/**
+ * CLASS NAME: WriteAheadLog
+ *
+ * DESCRIPTION: Append only log of the state a key is left in by each mutation.
+ * 				Records are only buffered by append. sync() writes the whole
+ * 				buffer and issues one fdatasync for it, so the cost of the
+ * 				sync is shared by every record of the tick (group commit).
+ * 				With a sync interval set, append also syncs once that many
+ * 				milliseconds have passed since the last sync.
+ */
+class WriteAheadLog {
+public:
+	WriteAheadLog();
+	virtual ~WriteAheadLog();
+	bool open(const string &path, int syncIntervalMs);
+	void close();
+	bool isOpen();
+	void appendPut(const Slice &key, const EntryRecord &record);
+	void appendClear();
+	bool sync();
+	bool truncate();
+	unsigned long replay(WalReplayFn fn, void *env);
+	unsigned long pendingRecords();
+private:
+	int fd;
+	string path;
+	string buffer;
+	unsigned long pending;
+	int syncIntervalMs;
+	long lastSyncMs;
+	WriteAheadLog(const WriteAheadLog &anotherLog);
+	WriteAheadLog& operator =(const WriteAheadLog &anotherLog);
+	void appendRecord(const string &payload);
+	static long nowMs();
+};
+
+#endif /* WRITEAHEADLOG_H_ */
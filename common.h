@@ -7,8 +7,10 @@
 // Transaction Id
 static int g_transID = 0;
 
-// message types, reply is the message from node to coordinator
-enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY};
+// message types, reply is the message from node to coordinator.
+// INCR, DECR, APPEND and CAS are read-modify-writes each replica applies to its own copy.
+// BATCH carries the messages of one time unit to one node.
+enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY, INCR, DECR, APPEND, CAS, BATCH};
 // enum of replica types
 enum ReplicaType {PRIMARY, SECONDARY, TERTIARY};
 